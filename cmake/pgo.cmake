@@ -0,0 +1,90 @@
+﻿# Profile-guided build, run by the pgo target with cmake -P. Expects SOURCE_DIR, BINARY_DIR, BASELINE (the plain
+# c8train to compare against), GENERATOR, C_COMPILER and LTO.
+#   1. configure BINARY_DIR with C8_PGO=GENERATE and build the instrumented c8train
+#   2. play the training workload, resources/pgo_workload.txt and the built-in game, to record the profile
+#   3. merge the raw profiles for clang
+#   4. reconfigure the same directory with C8_PGO=USE and build everything
+#   5. time the plain and the optimized c8train on the same workload, best of TIMING_RUNS, and report the speedup
+
+set(PROFILE_DIR "${BINARY_DIR}/profile")
+set(TRAINING_ROUNDS 20)
+set(TIMING_ROUNDS 1000)
+set(TIMING_RUNS 3)
+
+function(run)
+	execute_process(COMMAND ${ARGN} WORKING_DIRECTORY "${SOURCE_DIR}" RESULT_VARIABLE result)
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "Failed (${result}): ${ARGN}")
+	endif()
+endfunction()
+
+function(find_program_in directory name output)
+	foreach(candidate "${directory}/${name}" "${directory}/${name}.exe" "${directory}/Release/${name}.exe")
+		if(EXISTS "${candidate}")
+			set(${output} "${candidate}" PARENT_SCOPE)
+			return()
+		endif()
+	endforeach()
+	message(FATAL_ERROR "No ${name} in ${directory}")
+endfunction()
+
+# Returns the best of TIMING_RUNS in hundredths of a ns per instruction, as printed by c8train with two decimals,
+# since math() only does integers
+function(time_workload program output)
+	set(best 0)
+	foreach(run RANGE 1 ${TIMING_RUNS})
+		execute_process(COMMAND "${program}" --rounds ${TIMING_ROUNDS} WORKING_DIRECTORY "${SOURCE_DIR}"
+			OUTPUT_VARIABLE text RESULT_VARIABLE result)
+		if(NOT result EQUAL 0 OR NOT text MATCHES "0*([0-9]+)\\.([0-9][0-9]) ns per instruction")
+			message(FATAL_ERROR "Could not time ${program}:\n${text}")
+		endif()
+		set(time "${CMAKE_MATCH_1}${CMAKE_MATCH_2}")
+		if(best EQUAL 0 OR time LESS best)
+			set(best ${time})
+		endif()
+	endforeach()
+	set(${output} ${best} PARENT_SCOPE)
+endfunction()
+
+# Hundredths as a decimal string
+function(format_hundredths value output)
+	math(EXPR whole "${value} / 100")
+	math(EXPR fraction "${value} % 100")
+	if(fraction LESS 10)
+		set(fraction "0${fraction}")
+	endif()
+	set(${output} "${whole}.${fraction}" PARENT_SCOPE)
+endfunction()
+
+set(CONFIGURE "${CMAKE_COMMAND}" -S "${SOURCE_DIR}" -B "${BINARY_DIR}" -G "${GENERATOR}" "-DCMAKE_C_COMPILER=${C_COMPILER}"
+	-DCMAKE_BUILD_TYPE=Release "-DC8_LTO=${LTO}" "-DC8_PGO_DIR=${PROFILE_DIR}")
+
+message(STATUS "PGO: instrumented build")
+file(REMOVE_RECURSE "${PROFILE_DIR}")
+run(${CONFIGURE} -DC8_PGO=GENERATE)
+run("${CMAKE_COMMAND}" --build "${BINARY_DIR}" --config Release --target c8train)
+
+message(STATUS "PGO: training")
+find_program_in("${BINARY_DIR}" c8train INSTRUMENTED)
+set(ENV{LLVM_PROFILE_FILE} "${PROFILE_DIR}/c8train-%p.profraw")
+run("${INSTRUMENTED}" --rounds ${TRAINING_ROUNDS})
+file(GLOB RAW_PROFILES "${PROFILE_DIR}/*.profraw")
+if(RAW_PROFILES)
+	get_filename_component(COMPILER_DIR "${C_COMPILER}" DIRECTORY)
+	find_program(LLVM_PROFDATA NAMES llvm-profdata HINTS "${COMPILER_DIR}" REQUIRED)
+	run("${LLVM_PROFDATA}" merge "-output=${PROFILE_DIR}/c8.profdata" ${RAW_PROFILES})
+endif()
+
+message(STATUS "PGO: optimized build")
+run(${CONFIGURE} -DC8_PGO=USE)
+run("${CMAKE_COMMAND}" --build "${BINARY_DIR}" --config Release)
+
+find_program_in("${BINARY_DIR}" c8train OPTIMIZED)
+time_workload("${BASELINE}" PLAIN)
+time_workload("${OPTIMIZED}" OPTIMIZED)
+math(EXPR SPEEDUP "${PLAIN} * 100 / ${OPTIMIZED}")
+format_hundredths(${PLAIN} PLAIN)
+format_hundredths(${OPTIMIZED} OPTIMIZED)
+format_hundredths(${SPEEDUP} SPEEDUP)
+message(STATUS "PGO: plain ${PLAIN} ns per instruction, PGO ${OPTIMIZED} ns per instruction")
+message(STATUS "PGO: speedup ${SPEEDUP}x over the plain build, optimized binaries in ${BINARY_DIR}")
\ No newline at end of file
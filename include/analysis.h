@@ -0,0 +1,14 @@
+﻿#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct ANALYSIS ANALYSIS;
+typedef struct BASIC_BLOCK BASIC_BLOCK;
+
+ANALYSIS* analyze_program(const uint8_t* RAM, uint16_t program_start, uint16_t program_size);
+ANALYSIS* copy_analysis(const ANALYSIS* analysis);
+void delete_analysis(ANALYSIS* analysis);
+const BASIC_BLOCK* find_block(const ANALYSIS* analysis, uint16_t address);
+void export_listing(const ANALYSIS* analysis, const uint8_t* RAM, FILE* file);
+void export_cfg(const ANALYSIS* analysis, FILE* file);
\ No newline at end of file
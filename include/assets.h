@@ -0,0 +1,16 @@
+﻿#pragma once
+#include <allegro5/allegro.h>
+#include <stdint.h>
+
+#define SOUND_ASSET "resources/sound.wav"
+#define FONT_ASSET "resources/UbuntuMono[wght].ttf"
+
+//A file compiled into the executable by c8embed, found by the path it was embedded from
+typedef struct ASSET
+{
+	const char* name;
+	const uint8_t* data;
+	uint32_t size;
+}ASSET;
+
+ALLEGRO_FILE* open_asset(const char* name);
\ No newline at end of file
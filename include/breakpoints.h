@@ -0,0 +1,28 @@
+﻿#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum BREAK_REASON
+{
+	BREAK_NONE,
+	BREAK_PC,
+	BREAK_WATCH,
+	BREAK_CONDITION,
+	NUM_BREAK_REASONS
+}BREAK_REASON;
+
+typedef struct BREAKPOINTS BREAKPOINTS;
+typedef struct MACHINE MACHINE;
+
+BREAKPOINTS* create_breakpoints();
+void delete_breakpoints(BREAKPOINTS* breakpoints);
+void clear_breakpoints(BREAKPOINTS* breakpoints);
+bool breakpoints_armed(BREAKPOINTS* breakpoints);
+void add_breakpoint(BREAKPOINTS* breakpoints, uint16_t address);
+void remove_breakpoint(BREAKPOINTS* breakpoints, uint16_t address);
+bool has_breakpoint(const BREAKPOINTS* breakpoints, uint16_t address);
+void add_watchpoint(BREAKPOINTS* breakpoints, uint16_t address, uint16_t length);
+void remove_watchpoint(BREAKPOINTS* breakpoints, uint16_t address, uint16_t length);
+bool add_condition(BREAKPOINTS* breakpoints, const char* expression);
+BREAK_REASON check_breakpoints(BREAKPOINTS* breakpoints, MACHINE* machine, uint16_t opcode);
+const char* break_reason_to_string(BREAK_REASON reason);
\ No newline at end of file
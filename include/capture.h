@@ -0,0 +1,12 @@
+﻿#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CAPTURE_QUEUE_FRAMES 256 //frames the writer may fall behind by before new ones are dropped, about 4 seconds
+
+typedef struct CAPTURE CAPTURE;
+
+CAPTURE* create_capture(const char* name, uint8_t scale);
+void delete_capture(CAPTURE* capture);
+bool capture_frame(CAPTURE* capture, const uint64_t* pixel_row);
+void get_capture_counts(const CAPTURE* capture, uint64_t* written, uint64_t* dropped);
\ No newline at end of file
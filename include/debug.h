@@ -1,7 +1,8 @@
 ﻿#pragma once
 #include <allegro5/allegro.h>
 #include <allegro5/allegro_font.h>
-#include "machine.h"
+#include "frontend.h"
+#include "breakpoints.h"
 
 typedef enum DEBUG_KEY_INDEX
 {
@@ -26,4 +27,8 @@ typedef struct DEBUG DEBUG;
 DEBUG* create_debug(MACHINE* machine);
 void delete_debug(DEBUG* debug);
 void start_debug_thread(DEBUG* debug);
-void end_debug_thread(DEBUG* debug);
\ No newline at end of file
+void end_debug_thread(DEBUG* debug);
+void update_debug_hooks(DEBUG* debug);
+bool debug_allows_step(DEBUG* debug, uint16_t opcode);
+BREAKPOINTS* get_breakpoints(DEBUG* debug);
+bool load_debug_script(DEBUG* debug, const char* file_name);
\ No newline at end of file
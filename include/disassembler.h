@@ -0,0 +1,4 @@
+﻿#pragma once
+#include <stdint.h>
+
+void opcode_to_string(char* buffer, uint16_t opcode);
\ No newline at end of file
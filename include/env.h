@@ -0,0 +1,50 @@
+﻿#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DEFAULT_ENV_TICKS_PER_FRAME 12 //700 Hz opcode timer over the 60 Hz counter timer
+#define DEFAULT_ENV_FRAME_SKIP 4
+
+typedef enum ENV_OBSERVATION
+{
+	ENV_OBSERVATION_PACKED, //the 32 uint64_t screen rows, leftmost pixel in the top bit
+	ENV_OBSERVATION_UNPACKED //one byte per pixel, row by row, 1 lit and 0 unlit
+}ENV_OBSERVATION;
+
+typedef enum ENV_SCORE_FORMAT
+{
+	ENV_SCORE_NONE, //every reward is zero
+	ENV_SCORE_BYTE,
+	ENV_SCORE_WORD, //big-endian
+	ENV_SCORE_BCD //three decimal digits, as FX33 stores them
+}ENV_SCORE_FORMAT;
+
+typedef struct ENV_OPTIONS
+{
+	const uint8_t* program;
+	uint16_t program_size;
+	uint16_t num_envs;
+	uint8_t num_threads; //threads besides the caller's
+	uint8_t frame_skip; //frames run per step, with the same action held
+	uint16_t ticks_per_frame; //instructions per frame
+	ENV_OBSERVATION observation;
+	ENV_SCORE_FORMAT score_format;
+	uint16_t score_address; //RAM address of the score, whose change over a step is the reward
+}ENV_OPTIONS;
+
+//Results of the last reset or step, one entry per environment, owned by the ENV
+typedef struct ENV_BATCH
+{
+	const uint8_t* observations; //num_envs * observation_size bytes
+	size_t observation_size;
+	const float* rewards;
+	const bool* dones; //the machine halted; the environment restarts on its next step
+}ENV_BATCH;
+
+typedef struct ENV ENV;
+
+ENV* create_env(const ENV_OPTIONS* options);
+void delete_env(ENV* env);
+const ENV_BATCH* reset_env(ENV* env, const uint32_t* seeds);
+const ENV_BATCH* step_env(ENV* env, const uint16_t* actions);
\ No newline at end of file
@@ -0,0 +1,21 @@
+﻿#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DEFAULT_EXPORT_FRAMES 8 //Ring slots, so a consumer has several frames to read one in place
+
+typedef struct EXPORT EXPORT;
+typedef struct EXPORT_FRAME EXPORT_FRAME;
+typedef struct MACHINE MACHINE;
+
+//Machine side
+EXPORT* create_export(const char* name, uint16_t num_frames);
+void delete_export(EXPORT* shared);
+void publish_frame(EXPORT* shared, const MACHINE* machine);
+bool apply_exported_keypad(EXPORT* shared, MACHINE* machine);
+
+//Consumer side
+EXPORT* open_export(const char* name);
+const EXPORT_FRAME* begin_frame_read(const EXPORT* shared, uint32_t* sequence);
+bool end_frame_read(const EXPORT_FRAME* frame, uint32_t sequence);
+void inject_keypad(EXPORT* shared, bool take_over, uint16_t keys);
\ No newline at end of file
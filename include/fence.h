@@ -0,0 +1,12 @@
+﻿#pragma once
+
+//Orders a buffer written by one thread against the index or sequence number that hands it to another. On MSVC
+//_ReadWriteBarrier only stops the compiler from reordering, which ARM64 does not honour, so MemoryBarrier is used.
+#ifdef _MSC_VER
+#include <windows.h>
+#define RELEASE_FENCE() MemoryBarrier()
+#define ACQUIRE_FENCE() MemoryBarrier()
+#else
+#define RELEASE_FENCE() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define ACQUIRE_FENCE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#endif
\ No newline at end of file
@@ -0,0 +1,40 @@
+﻿#pragma once
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_color.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "machine.h"
+#include "export.h"
+#include "keymap.h"
+#include "metrics.h"
+#include "capture.h"
+
+typedef struct DISPLAY_OPTIONS
+{
+	uint8_t scale;
+	ALLEGRO_COLOR color_on;
+	ALLEGRO_COLOR color_off;
+}DISPLAY_OPTIONS;
+
+typedef struct INPUT_KEY
+{
+	uint8_t value;
+	uint8_t keycode;
+}INPUT_KEY;
+
+bool start_allegro();
+bool end_allegro();
+MACHINE* create_machine(DISPLAY_OPTIONS display_options);
+void set_keypad(MACHINE* machine, const INPUT_KEY* keypad);
+KEYMAP* get_keymap(MACHINE* machine);
+void set_export(MACHINE* machine, EXPORT* shared);
+void set_capture(MACHINE* machine, CAPTURE* capture);
+void set_turbo_speed(MACHINE* machine, uint16_t speed);
+void set_playlist(MACHINE* machine, const char** file_names, uint16_t count);
+void preload_playlist(MACHINE* machine);
+bool switch_playlist(MACHINE* machine, uint16_t position);
+void present_frame(MACHINE* machine);
+void run_program(MACHINE* machine);
+DEBUG* get_debug(MACHINE* machine);
+void report_input_latency(MACHINE* machine, FILE* file);
+METRICS* get_metrics(MACHINE* machine);
\ No newline at end of file
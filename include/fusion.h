@@ -0,0 +1,20 @@
+﻿#pragma once
+#include <stdint.h>
+
+#define FUSION_SPAN 6 //bytes covered by the longest fused sequence
+
+typedef enum FUSION_KIND
+{
+	FUSION_NONE,
+	FUSION_SET_PAIR, //6XNN; 6YNN
+	FUSION_POINT_AND_DRAW, //ANNN; DXYN
+	FUSION_TIMER_WAIT, //FX07; 3X00; 1NNN back to the FX07
+	FUSION_COUNTED_LOOP, //7XNN; 3XNN; 1NNN
+	NUM_FUSION_KINDS
+}FUSION_KIND;
+
+typedef struct ANALYSIS ANALYSIS;
+typedef struct MACHINE MACHINE;
+
+uint8_t* build_fusion_table(const ANALYSIS* analysis, const uint8_t* RAM);
+const char* fusion_kind_to_string(FUSION_KIND kind);
\ No newline at end of file
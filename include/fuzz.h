@@ -0,0 +1,51 @@
+﻿#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FUZZ_MAX_FRAMES 600 //10 seconds of input per execution
+#define FUZZ_MAX_PATCHES 4 //ROM bytes changed by one input
+#define DEFAULT_FUZZ_FRAMES 120
+#define DEFAULT_FUZZ_TICKS_PER_FRAME 12
+
+//Everything that varies between executions: the CXNN seed, the keypad held on each frame and optional ROM bytes
+typedef struct FUZZ_INPUT
+{
+	uint32_t seed;
+	uint8_t num_patches;
+	uint16_t patch_address[FUZZ_MAX_PATCHES];
+	uint8_t patch_value[FUZZ_MAX_PATCHES];
+	uint16_t keys[FUZZ_MAX_FRAMES]; //bit k set while key k is held
+}FUZZ_INPUT;
+
+typedef struct FUZZ_OPTIONS
+{
+	uint16_t frames; //per execution, at most FUZZ_MAX_FRAMES
+	uint16_t ticks_per_frame;
+	bool mutate_rom;
+	uint32_t seed; //of the fuzzer's own mutations
+}FUZZ_OPTIONS;
+
+//A fault seen for the first time at its address, with the input that reproduces it
+typedef struct FUZZ_CRASH
+{
+	uint8_t fault; //MACHINE_FAULT
+	uint16_t pc_reg;
+	uint16_t opcode;
+	FUZZ_INPUT input;
+}FUZZ_CRASH;
+
+typedef struct FUZZ_STATS
+{
+	uint64_t executions;
+	uint32_t edges; //distinct (previous PC, PC) pairs seen, up to hash collisions
+	uint16_t corpus_size;
+	uint16_t num_crashes;
+}FUZZ_STATS;
+
+typedef struct FUZZER FUZZER;
+
+FUZZER* create_fuzzer(const uint8_t* program, uint16_t size, const FUZZ_OPTIONS* options);
+void delete_fuzzer(FUZZER* fuzzer);
+const FUZZ_CRASH* fuzz_once(FUZZER* fuzzer);
+uint8_t replay_fuzz_input(FUZZER* fuzzer, const FUZZ_INPUT* input, uint16_t* pc_reg);
+FUZZ_STATS get_fuzz_stats(const FUZZER* fuzzer);
\ No newline at end of file
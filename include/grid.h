@@ -0,0 +1,12 @@
+﻿#pragma once
+#include <stdint.h>
+#include "frontend.h"
+
+#define MAX_GRID_TILES 64
+
+typedef struct GRID GRID;
+
+GRID* create_grid(DISPLAY_OPTIONS display_options, const char** file_names, uint16_t num_files, uint16_t num_tiles, uint32_t seed);
+void delete_grid(GRID* grid);
+KEYMAP* get_grid_keymap(GRID* grid);
+void run_grid(GRID* grid);
\ No newline at end of file
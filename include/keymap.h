@@ -0,0 +1,12 @@
+﻿#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#define UNMAPPED_KEY 0xFF
+
+typedef struct KEYMAP KEYMAP;
+
+void clear_keymap(KEYMAP* keymap);
+void map_key(KEYMAP* keymap, int keycode, uint8_t value);
+uint8_t lookup_key(const KEYMAP* keymap, int keycode);
+bool load_keymap(KEYMAP* keymap, const char* file_name);
\ No newline at end of file
@@ -1,29 +1,25 @@
 ﻿#pragma once
-#include <allegro5/allegro.h>
-#include <allegro5/allegro_color.h>
 #include <stdbool.h>
-
-typedef struct DISPLAY_OPTIONS
-{
-	uint8_t scale;
-	ALLEGRO_COLOR color_on;
-	ALLEGRO_COLOR color_off;
-}DISPLAY_OPTIONS;
-
-typedef struct INPUT_KEY
-{
-	uint8_t value;
-	uint8_t keycode;
-}INPUT_KEY;
+#include <stdint.h>
 
 typedef struct MACHINE MACHINE;
+typedef struct FRONTEND FRONTEND;
+typedef struct DEBUG DEBUG;
+typedef struct TRACE TRACE;
+typedef struct ROM_IMAGE ROM_IMAGE;
+typedef struct DIRTY_SET DIRTY_SET;
 
-bool start_allegro();
-bool end_allegro();
-MACHINE* create_machine(DISPLAY_OPTIONS display_options);
+MACHINE* create_headless_machine();
 void delete_machine(MACHINE* machine);
 void set_font(MACHINE* machine, int8_t* font);
-INPUT_KEY** create_default_keypad();
-void set_keypad(MACHINE* machine, INPUT_KEY** keypad);
 void load_program(MACHINE* machine, const char* file_name);
-void run_program(MACHINE* machine);
\ No newline at end of file
+void load_program_data(MACHINE* machine, const char* name, const uint8_t* data, uint16_t size);
+void switch_program(MACHINE* machine, const ROM_IMAGE* image);
+void reset_machine(MACHINE* machine);
+void seed_machine(MACHINE* machine, uint32_t seed);
+void press_keypad(MACHINE* machine, uint16_t keys);
+void copy_machine(MACHINE* destination, const MACHINE* source);
+void set_trace(MACHINE* machine, TRACE* trace);
+void get_dirty(const MACHINE* machine, DIRTY_SET* dirty);
+void clear_dirty(MACHINE* machine);
+void mark_all_dirty(MACHINE* machine);
\ No newline at end of file
@@ -0,0 +1,39 @@
+﻿#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DEFAULT_METRICS_INTERVAL 1.0 //seconds covered by each snapshot
+
+typedef struct METRICS METRICS;
+
+//Figures for the last complete interval
+typedef struct METRICS_SNAPSHOT
+{
+	double time; //end of the interval, on the clock passed to update_metrics
+	double instructions_per_second;
+	double frame_ms_mean;
+	double frame_ms_p50;
+	double frame_ms_p95;
+	double frame_ms_p99;
+	double frame_ms_max;
+	double display_ms; //spent presenting frames
+	double emulation_ms; //spent stepping the machine
+	double queue_depth_mean; //ticks waiting behind the one being handled
+	uint32_t queue_depth_max;
+	uint32_t dropped_ticks; //timer ticks never handled, or handled together with another
+	uint32_t beeper_toggles;
+	uint32_t frames;
+}METRICS_SNAPSHOT;
+
+METRICS* create_metrics(double interval);
+void delete_metrics(METRICS* metrics);
+bool open_metrics_file(METRICS* metrics, const char* file_name);
+bool open_metrics_socket(METRICS* metrics, const char* path);
+void count_instructions(METRICS* metrics, uint32_t count, double seconds);
+void count_frame(METRICS* metrics, double now, double display_seconds);
+void count_queue_depth(METRICS* metrics, uint32_t depth);
+void count_dropped_ticks(METRICS* metrics, uint32_t count);
+void count_beeper_toggle(METRICS* metrics);
+bool update_metrics(METRICS* metrics, double now);
+const METRICS_SNAPSHOT* get_metrics_snapshot(const METRICS* metrics);
+void format_metrics_json(const METRICS_SNAPSHOT* snapshot, char* text, uint32_t size);
\ No newline at end of file
@@ -1,6 +1,14 @@
 ﻿#pragma once
 #include "struct_machine.h"
+#include "disassembler.h"
 
 uint16_t fetch_opcode(MACHINE* machine);
 void execute_opcode(MACHINE* machine, uint16_t opcode);
-void opcode_to_string(char* buffer, uint16_t opcode);
\ No newline at end of file
+void step_opcode(MACHINE* machine);
+void step_opcode_hooked(MACHINE* machine);
+void step_fused(MACHINE* machine);
+void update_step_function(MACHINE* machine);
+void op_draw_sprite(MACHINE* machine, uint16_t opcode);
+void raise_fault(MACHINE* machine, MACHINE_FAULT fault, uint16_t address);
+const char* fault_to_string(MACHINE_FAULT fault);
+void mirror_ram_writes(MACHINE* machine, uint16_t address, uint8_t length);
\ No newline at end of file
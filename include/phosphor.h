@@ -0,0 +1,20 @@
+﻿#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PHOSPHOR_MAX_WIDTH 128 //Room for SCHIP high resolution
+#define PHOSPHOR_MAX_HEIGHT 64
+#define DEFAULT_PHOSPHOR_DECAY_SHIFT 1 //An unlit pixel loses 1/2 of its intensity per frame
+
+//Per-pixel intensity that follows the screen bitmask, so sprites erased and redrawn by XOR do not flicker
+typedef struct PHOSPHOR
+{
+	uint8_t width; //multiple of 64
+	uint8_t height;
+	uint8_t decay_shift;
+	bool enabled; //when off, intensity is just the bitmask
+	uint8_t intensity[PHOSPHOR_MAX_WIDTH * PHOSPHOR_MAX_HEIGHT]; //row by row, 0 unlit to 255 lit
+}PHOSPHOR;
+
+void reset_phosphor(PHOSPHOR* phosphor, uint8_t width, uint8_t height);
+void update_phosphor(PHOSPHOR* phosphor, const uint64_t* pixel_row);
\ No newline at end of file
@@ -0,0 +1,10 @@
+﻿#pragma once
+#include <stdint.h>
+
+typedef struct POOL POOL;
+typedef void (*POOL_TASK)(void* context, uint16_t index);
+
+POOL* create_pool(uint8_t num_threads);
+void delete_pool(POOL* pool);
+void run_pool(POOL* pool, POOL_TASK task, void* context, uint16_t count);
+uint8_t get_core_count();
\ No newline at end of file
@@ -0,0 +1,21 @@
+﻿#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "struct_machine.h"
+#include "opcodes.h"
+
+typedef struct RECOMPILED_PROGRAM
+{
+	const char* name;
+	const uint8_t* rom;
+	uint16_t size;
+	RECOMPILED_BLOCK run_block; //dispatches on pc_reg, runs the block and returns how many instructions it executed
+}RECOMPILED_PROGRAM;
+
+extern const RECOMPILED_PROGRAM recompiled_program; //defined by the C source generated by c8rc
+
+bool set_recompiled_program(MACHINE* machine, const RECOMPILED_PROGRAM* program);
+void step_recompiled(MACHINE* machine);
+void recompiled_call(MACHINE* machine, uint16_t address, uint16_t target, RECOMPILED_BLOCK target_block, RECOMPILED_BLOCK return_block);
+void recompiled_return(MACHINE* machine, uint16_t address);
\ No newline at end of file
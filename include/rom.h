@@ -0,0 +1,9 @@
+﻿#pragma once
+#include <stdint.h>
+
+typedef struct ROM_IMAGE ROM_IMAGE;
+
+ROM_IMAGE* create_rom_image(const char* file_name);
+ROM_IMAGE* create_rom_image_data(const char* name, const uint8_t* data, uint16_t size);
+void delete_rom_image(ROM_IMAGE* image);
+const char* get_rom_name(const ROM_IMAGE* image);
\ No newline at end of file
@@ -0,0 +1,8 @@
+﻿#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MAX_SPRITE_ROWS 16 //DXYN draws up to 15 rows, 16x16 sprites draw 16
+#define LARGE_SPRITE_SIZE 16
+
+bool draw_sprite_rows(uint64_t* pixel_row, const uint8_t* sprite, uint8_t width, uint8_t height, uint8_t x, uint8_t y, bool wrap);
\ No newline at end of file
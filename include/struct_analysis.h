@@ -0,0 +1,50 @@
+﻿#pragma once
+#include "analysis.h"
+#include "struct_machine.h"
+
+#define NO_BLOCK 0xFFFF
+
+typedef enum ADDRESS_FLAG
+{
+	ADDRESS_CODE = 1 << 0, //first byte of a reachable instruction
+	ADDRESS_BLOCK_START = 1 << 1,
+	ADDRESS_JUMP_TARGET = 1 << 2,
+	ADDRESS_CALL_TARGET = 1 << 3,
+	ADDRESS_WRITTEN = 1 << 4, //target of an FX33/FX55 with a statically known I
+	ADDRESS_SELF_MODIFIED = 1 << 5, //code that is also written
+	ADDRESS_IDLE_LOOP = 1 << 6, //start of a loop that only waits for a timer, a key or nothing at all
+	ADDRESS_OPERAND = 1 << 7 //second byte of a reachable instruction
+}ADDRESS_FLAG;
+
+typedef enum BLOCK_EXIT
+{
+	EXIT_FALLTHROUGH,
+	EXIT_JUMP,
+	EXIT_CALL,
+	EXIT_RETURN,
+	EXIT_SKIP,
+	EXIT_COMPUTED_JUMP,
+	EXIT_WAIT_FOR_KEY
+}BLOCK_EXIT;
+
+typedef struct BASIC_BLOCK
+{
+	uint16_t start;
+	uint16_t end; //address after the last instruction
+	uint16_t successors[2];
+	uint8_t num_successors;
+	BLOCK_EXIT exit;
+}BASIC_BLOCK;
+
+typedef struct ANALYSIS
+{
+	uint8_t flags[RAM_SIZE];
+	uint16_t block_index[RAM_SIZE]; //block starting at each address, or NO_BLOCK
+	BASIC_BLOCK* blocks; //sorted by start address
+	uint16_t num_blocks;
+	uint16_t program_start;
+	uint16_t program_end;
+	uint16_t num_idle_loops;
+	uint16_t num_self_modified;
+	bool has_computed_jumps;
+}ANALYSIS;
\ No newline at end of file
@@ -0,0 +1,48 @@
+﻿#pragma once
+#include "breakpoints.h"
+#include "struct_machine.h"
+
+#define MAX_CONDITIONS 8
+#define MAX_CONDITION_CODE_SIZE 64
+#define CONDITION_STACK_SIZE 16
+#define MAX_CONDITION_TEXT_SIZE 64
+
+typedef enum CONDITION_OP
+{
+	COND_END,
+	COND_PUSH_CONST, //followed by a 16-bit big endian constant
+	COND_PUSH_V, //followed by the register index
+	COND_PUSH_I,
+	COND_PUSH_PC,
+	COND_PUSH_SP,
+	COND_PUSH_DT,
+	COND_PUSH_ST,
+	COND_EQ,
+	COND_NE,
+	COND_LT,
+	COND_LE,
+	COND_GT,
+	COND_GE,
+	COND_ADD,
+	COND_SUB,
+	COND_BIT_AND,
+	COND_AND,
+	COND_OR,
+	COND_NOT
+}CONDITION_OP;
+
+typedef struct CONDITION
+{
+	uint8_t code[MAX_CONDITION_CODE_SIZE]; //compiled postfix bytecode, terminated by COND_END
+	char text[MAX_CONDITION_TEXT_SIZE];
+}CONDITION;
+
+typedef struct BREAKPOINTS
+{
+	uint8_t pc_map[RAM_SIZE / 8]; //one bit per address
+	uint8_t watch_map[RAM_SIZE / 8]; //one bit per watched byte
+	uint16_t num_breakpoints;
+	uint16_t num_watchpoints;
+	CONDITION conditions[MAX_CONDITIONS];
+	uint8_t num_conditions;
+}BREAKPOINTS;
\ No newline at end of file
@@ -0,0 +1,49 @@
+﻿#pragma once
+#include <stdio.h>
+#include "capture.h"
+#include "struct_machine.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#define CAPTURE_FRAME_RATE 60
+#define MAX_CAPTURE_SCALE 16
+
+typedef enum CAPTURE_FORMAT
+{
+	CAPTURE_PNG, //one 1-bit greyscale file per frame
+	CAPTURE_Y4M, //YUV4MPEG2 stream, 4:2:0 with neutral chroma
+	CAPTURE_RAW //8-bit greyscale frames back to back
+}CAPTURE_FORMAT;
+
+typedef struct CAPTURE_SLOT
+{
+	uint64_t pixel_row[NUM_PIXEL_ROWS];
+}CAPTURE_SLOT;
+
+//Single producer, single consumer ring. The emulation thread only copies the screen into a free slot and
+//publishes head; the writer thread scales, encodes and writes, then publishes tail. Neither ever waits for the other.
+typedef struct CAPTURE
+{
+	CAPTURE_SLOT slots[CAPTURE_QUEUE_FRAMES];
+	volatile uint32_t head; //slots ever queued, written by the emulation thread
+	volatile uint32_t tail; //slots ever written out, written by the writer thread
+	volatile bool quit;
+	uint64_t dropped;
+	CAPTURE_FORMAT format;
+	uint8_t scale;
+	uint16_t width;
+	uint16_t height;
+	char* name; //file name, or printf pattern taking the frame number for PNG sequences
+	FILE* file; //stream formats only
+	uint8_t* image; //one scaled frame, a byte per pixel for streams, or PNG scanlines with their filter bytes
+	uint8_t* encoded; //PNG file being built
+	uint32_t encoded_size;
+#ifdef _WIN32
+	HANDLE thread;
+#else
+	pthread_t thread;
+#endif
+}CAPTURE;
\ No newline at end of file
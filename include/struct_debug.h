@@ -2,6 +2,43 @@
 #include "debug.h"
 #include "opcodes.h"
 
+#define DISASSEMBLY_TEXT_SIZE 40 //opcode in hex, then up to the 32 bytes opcode_to_string may write
+#define DISASSEMBLY_LINES 21 //instructions shown, centered on PC
+#define MEMORY_PANE_ROWS 8
+#define MEMORY_PANE_COLUMNS 8 //bytes per row
+#define SCREEN_PANE_ZOOM 4
+#define DEBUG_PANE_TEXT_SIZE 1024
+
+typedef enum DEBUG_PANE_INDEX
+{
+	PANE_REGISTERS,
+	PANE_DISASSEMBLY,
+	PANE_STACK,
+	PANE_MEMORY,
+	PANE_SCREEN,
+	NUM_DEBUG_PANES
+}DEBUG_PANE_INDEX;
+
+//Rendered into its own bitmap, which is only redrawn when the hash of what it shows changes
+typedef struct DEBUG_PANE
+{
+	ALLEGRO_BITMAP* bitmap;
+	uint16_t x;
+	uint16_t y;
+	uint16_t width;
+	uint16_t height;
+	uint64_t hash;
+	bool drawn;
+}DEBUG_PANE;
+
+//Disassembly of the instruction at each address, valid while RAM still holds opcode there
+typedef struct DISASSEMBLY_LINE
+{
+	uint16_t opcode;
+	bool valid;
+	char text[DISASSEMBLY_TEXT_SIZE];
+}DISASSEMBLY_LINE;
+
 typedef struct DEBUG
 {
 	bool on;
@@ -12,4 +49,10 @@ typedef struct DEBUG
 	ALLEGRO_THREAD* thread;
 	ALLEGRO_MUTEX* event_mutex;
 	MACHINE* machine;
+	BREAKPOINTS* breakpoints;
+	BREAK_REASON last_break;
+	uint16_t last_break_address;
+	bool skip_breakpoints_once; //lets execution resume from the instruction that triggered the break
+	DEBUG_PANE panes[NUM_DEBUG_PANES];
+	DISASSEMBLY_LINE* disassembly; //RAM_SIZE lines, allocated with the window
 }DEBUG;
\ No newline at end of file
@@ -0,0 +1,19 @@
+﻿#pragma once
+#include "env.h"
+#include "pool.h"
+#include "struct_machine.h"
+
+//A batch of headless machines stepped together. Everything is allocated up front; reset and step only copy.
+typedef struct ENV
+{
+	ENV_OPTIONS options;
+	MACHINE* initial; //program loaded and nothing run, copied into a machine to restart it
+	MACHINE** machines;
+	const uint16_t* actions; //of the step being run
+	uint8_t* observations;
+	float* rewards;
+	bool* dones;
+	ENV_BATCH batch;
+	uint64_t unpacked_bytes[256]; //eight unpacked pixels for each byte of a screen row
+	POOL* pool;
+}ENV;
\ No newline at end of file
@@ -0,0 +1,51 @@
+﻿#pragma once
+#include "export.h"
+#include "struct_machine.h"
+
+#define EXPORT_MAGIC 0x48533843 //"C8SH"
+#define EXPORT_VERSION 1
+
+//One published frame. sequence is odd while the machine writes the slot; a reader that sees it change or odd
+//during its read got a torn frame and should take the latest slot again.
+typedef struct EXPORT_FRAME
+{
+	volatile uint32_t sequence;
+	uint8_t fault;
+	bool waiting_for_input;
+	uint8_t d_counter;
+	uint8_t s_counter;
+	uint64_t frame; //frame counter, 1 for the first published frame
+	uint64_t pixel_row[NUM_PIXEL_ROWS];
+	uint8_t v_reg[NUM_V_REGS];
+	uint16_t pc_reg;
+	uint16_t i_reg;
+	uint16_t s_reg;
+	uint16_t current_opcode;
+	uint16_t stack[STACK_DEPTH];
+}EXPORT_FRAME;
+
+//Layout of the shared memory region, identical for every process that maps it
+typedef struct EXPORT_REGION
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t num_frames;
+	uint32_t frame_size; //sizeof(EXPORT_FRAME), so consumers can check they agree on the layout
+	volatile uint32_t latest_slot; //newest complete frame, valid once frames[latest_slot].frame is non-zero
+	volatile uint32_t keypad_owner; //non-zero while a consumer drives the keypad instead of the keyboard
+	volatile uint32_t keypad; //bit i set while key i is held, written by the consumer
+	_Alignas(CACHE_LINE_SIZE) EXPORT_FRAME frames[];
+}EXPORT_REGION;
+
+typedef struct EXPORT
+{
+	EXPORT_REGION* region;
+	size_t size;
+	bool owner; //created the region, and removes it on delete
+	uint16_t last_keypad; //keys held at the previous poll, to turn presses into FX0A input
+	uint64_t frames_published;
+	char* name;
+#ifdef _WIN32
+	void* mapping;
+#endif
+}EXPORT;
\ No newline at end of file
@@ -0,0 +1,73 @@
+﻿#pragma once
+#include <allegro5/allegro_audio.h>
+#include "frontend.h"
+#include "struct_machine.h"
+#include "phosphor.h"
+#include "rom.h"
+#include "struct_keymap.h"
+#include "metrics.h"
+#include <allegro5/allegro_font.h>
+
+#define KEYPAD_WIDTH 4
+#define KEYPAD_HEIGHT 4
+#define DEFAULT_COUNTER_TIMER_PERIOD 1 / 60.0
+#define DEFAULT_OPCODE_TIMER_PERIOD 1 / 700.0
+#define DEFAULT_DISPLAY_WIDTH 64
+#define DEFAULT_TURBO_SPEED 8
+#define TURBO_KEY ALLEGRO_KEY_TAB //held to fast-forward, ahead of the keymap
+#define TURBO_UNCAPPED_SHARE 0.75 //of each counter period spent emulating when fast-forwarding uncapped
+#define DEFAULT_DISPLAY_HEIGHT 32
+#define DEFAULT_KEYPAD {{ 1, ALLEGRO_KEY_1 }, { 2, ALLEGRO_KEY_2 }, { 3, ALLEGRO_KEY_3 }, { 12, ALLEGRO_KEY_4 },\
+						{ 4, ALLEGRO_KEY_Q }, { 5, ALLEGRO_KEY_W }, { 6, ALLEGRO_KEY_E }, { 13, ALLEGRO_KEY_R },\
+						{ 7, ALLEGRO_KEY_A }, { 8, ALLEGRO_KEY_S }, { 9, ALLEGRO_KEY_D }, { 14, ALLEGRO_KEY_F },\
+						{ 10, ALLEGRO_KEY_Z }, { 0, ALLEGRO_KEY_X }, { 11, ALLEGRO_KEY_C }, { 15, ALLEGRO_KEY_V }}
+
+//Time from a key press to the first instruction that reads that key, measured at step boundaries
+typedef struct INPUT_LATENCY
+{
+	double key_time; //timestamp of the newest press not yet read
+	uint8_t key_value;
+	bool pending;
+	uint32_t samples;
+	double total;
+	double max;
+}INPUT_LATENCY;
+
+//Cold state of a machine shown in a window, allocated by create_machine
+typedef struct FRONTEND
+{
+	KEYMAP keymap;
+	ALLEGRO_EVENT_QUEUE* input_queue; //keyboard only, drained before every instruction so input never waits behind timers
+	INPUT_LATENCY latency;
+	METRICS* metrics;
+	ALLEGRO_FONT* overlay_font; //NULL until the metrics overlay is first shown
+	bool overlay_enabled;
+	int64_t last_opcode_tick; //count of the last handled timer event, to spot ticks that were never handled
+	int64_t last_counter_tick;
+	ALLEGRO_TIMER* counter_timer;
+	ALLEGRO_TIMER* opcode_timer;
+	uint16_t turbo_speed; //frames emulated per counter tick when fast-forwarding, 0 for as many as time allows
+	bool turbo_held; //TURBO_KEY is down
+	bool turbo_enabled; //latched from the menu
+	double turbo_cycles; //instructions owed to the next fast-forwarded frame, as the timer ratio is fractional
+	ALLEGRO_DISPLAY* display;
+	DISPLAY_OPTIONS display_options;
+	ALLEGRO_BITMAP* screen; //one texel per pixel, drawn scaled
+	uint32_t palette[256]; //intensity to ABGR_8888_LE, from color_off to color_on
+	PHOSPHOR phosphor;
+	ALLEGRO_SAMPLE* beep; //NULL until the first beep, or if audio could not be started
+	bool audio_prepared;
+	ALLEGRO_SAMPLE_ID beep_id;
+	bool beep_playing;
+	bool fault_reported;
+	ALLEGRO_EVENT_QUEUE* event_queue;
+	EXPORT* shared; //published every frame and polled for injected keys, NULL unless exporting
+	CAPTURE* capture; //receives every presented frame, NULL unless capturing
+	char** playlist; //programs cycled through by Next program, the first one being the one loaded at startup
+	ROM_IMAGE** playlist_images; //built on first use, or ahead of time when pre-warming, and kept for instant switches
+	uint16_t playlist_size;
+	uint16_t playlist_position;
+	ALLEGRO_THREAD* prewarm_thread; //builds the image of the next program, joined before the playlist is touched
+	uint16_t prewarm_position;
+	bool prewarm_enabled;
+}FRONTEND;
\ No newline at end of file
@@ -0,0 +1,35 @@
+﻿#pragma once
+#include "fuzz.h"
+#include "struct_machine.h"
+
+#define FUZZ_MAP_SIZE (1 << 16) //edge coverage bitmap, one byte per edge hash
+#define FUZZ_CORPUS_SIZE 1024 //inputs that found new edges, mutated further
+#define FUZZ_MAX_CRASHES 256
+#define FUZZ_MAX_MUTATIONS 4 //stacked on one input
+#define FUZZ_EDGE(previous, pc) ((((previous) >> 1) << 5 ^ (pc)) & (FUZZ_MAP_SIZE - 1))
+
+typedef enum FUZZ_MUTATION
+{
+	FUZZ_FLIP_KEY,
+	FUZZ_HOLD_KEY,
+	FUZZ_RESEED,
+	FUZZ_SPLICE,
+	FUZZ_PATCH_ROM,
+	NUM_FUZZ_MUTATIONS
+}FUZZ_MUTATION;
+
+typedef struct FUZZER
+{
+	FUZZ_OPTIONS options;
+	MACHINE* snapshot; //strict machine with the program loaded, restored before every execution
+	MACHINE* machine;
+	uint16_t program_size;
+	uint32_t random_state;
+	uint8_t coverage[FUZZ_MAP_SIZE];
+	FUZZ_INPUT* corpus;
+	uint16_t corpus_size;
+	FUZZ_CRASH* crashes;
+	uint16_t num_crashes;
+	FUZZ_INPUT candidate;
+	FUZZ_STATS stats;
+}FUZZER;
\ No newline at end of file
@@ -0,0 +1,42 @@
+﻿#pragma once
+#include <allegro5/allegro.h>
+#include "grid.h"
+#include "pool.h"
+#include "struct_keymap.h"
+#include "struct_machine.h"
+
+#define GRID_BORDER 1 //texels around each tile, drawn in the focus color for the tile that receives input
+#define GRID_TILE_WIDTH (NUM_PIXEL_COLS + 2 * GRID_BORDER)
+#define GRID_TILE_HEIGHT (NUM_PIXEL_ROWS + 2 * GRID_BORDER)
+#define GRID_FOCUS_KEY ALLEGRO_KEY_TAB //moves the focus to the next tile, or the previous one with shift
+
+//Several headless machines in one window. A single frame timer drives them all: the pool steps every machine through
+//one frame, then the rows each one changed are composed into a shared texel buffer that is uploaded to the screen
+//bitmap in one lock. Keys go to the focused machine only.
+typedef struct GRID
+{
+	MACHINE* machines[MAX_GRID_TILES];
+	uint16_t num_tiles;
+	uint8_t columns;
+	uint8_t rows;
+	uint16_t focus;
+	bool focus_moved; //borders need redrawing
+	POOL* pool;
+	double instructions_per_frame;
+	double cycles; //fraction of an instruction carried to the next frame, the same for every machine
+	uint16_t frame_instructions; //instructions every machine runs this frame
+	KEYMAP keymap;
+	ALLEGRO_DISPLAY* display;
+	ALLEGRO_TIMER* frame_timer;
+	ALLEGRO_EVENT_QUEUE* event_queue;
+	ALLEGRO_BITMAP* screen; //columns by rows tiles, drawn scaled
+	uint8_t scale;
+	uint32_t* texels; //what screen holds, ABGR_8888_LE, updated a row at a time from the dirty sets
+	uint16_t width; //texels
+	uint16_t height;
+	uint32_t color_on;
+	uint32_t color_off;
+	uint32_t color_border;
+	uint32_t color_focus;
+	bool on;
+}GRID;
\ No newline at end of file
@@ -0,0 +1,10 @@
+﻿#pragma once
+#include <allegro5/allegro.h>
+#include "keymap.h"
+
+//Keypad value of every Allegro keycode, or UNMAPPED_KEY, so an event is translated with a single load. Several
+//keys may share a value.
+typedef struct KEYMAP
+{
+	uint8_t values[ALLEGRO_KEY_MAX];
+}KEYMAP;
\ No newline at end of file
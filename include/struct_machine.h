@@ -1,16 +1,22 @@
 ﻿#pragma once
+#include <stddef.h>
 #include "machine.h"
-#include "debug.h"
-#include "struct_machine.h"
-#include <allegro5/allegro_audio.h>
+#include "trace.h"
+#include "analysis.h"
 
 #define RAM_SIZE 4096 //Available RAM
+#define RAM_GUARD_SIZE 32 //Mirror of the first bytes of RAM kept after its end, covers the longest run read from one address
+#define MASK_ADDRESS(address) ((address) & (RAM_SIZE - 1))
+#define RAM_AT(machine, address) ((uint8_t*)(machine)->RAM + MASK_ADDRESS(address)) //Valid for up to RAM_GUARD_SIZE bytes, wrapping like the address space
+#define COUNT_OUT_OF_BOUNDS(machine, address, length) ((machine)->out_of_bounds += ((address) + (length) > RAM_SIZE))
 #define NUM_V_REGS 16 //Number of variable registers
 #define NUM_PIXEL_ROWS 32 //The display is made of 32 rows of 64 pixels each
 #define NUM_PIXEL_COLS 64
 #define PROGRAM_BASE_ADDRESS 0x200 //Start address compatible with older CHIP-8 programs, where the interpreter would be located at the start of RAM
-#define STACK_BASE_ADDRESS 0x200 //Base address for the stack, which grows downwards
-#define MEM_STEP 2 * BYTE_SIZE //The step used when incrementing registers like the program counter and the stack pointer
+#ifndef STACK_DEPTH
+#define STACK_DEPTH 16 //Return addresses held by the dedicated stack
+#endif
+#define MEM_STEP 2 * BYTE_SIZE //The step used when incrementing the program counter
 #define STEP(reg) reg += MEM_STEP
 #define STEP_BACK(reg) reg -= MEM_STEP
 #define FONT_MEMORY_SIZE 80
@@ -31,12 +37,12 @@
 									 0xE0, 0x90, 0x90, 0x90, 0xE0,\
 									 0xF0, 0x80, 0xF0, 0x80, 0xF0,\
 									 0xF0, 0x80, 0xF0, 0x80, 0x80}
-#define KEYPAD_WIDTH 4
-#define KEYPAD_HEIGHT 4
-#define DEFAULT_COUNTER_TIMER_PERIOD 1 / 60.0
-#define DEFAULT_OPCODE_TIMER_PERIOD 1 / 700.0
-#define DEFAULT_DISPLAY_WIDTH 64
-#define DEFAULT_DISPLAY_HEIGHT 32
+#define KEYPAD_SIZE 16
+#define DIRTY_LINE_SIZE 64 //RAM bytes covered by one bit of DIRTY_SET.lines
+#define ALL_DIRTY_ROWS 0xFFFFFFFFu
+#define CACHE_LINE_SIZE 64
+#define DEFAULT_RANDOM_SEED 0x2545F491 //Headless machines are reproducible unless seeded otherwise
+#define MACHINE_FOOTPRINT_LIMIT (5 * 1024) //Upper bound for sizeof(MACHINE), checked below
 #define BYTE_SIZE sizeof(int8_t)
 #define GET_TYPE(opcode) (opcode & 0xF000) >> 12
 #define GET_X(opcode) (opcode & 0x0F00) >> 8
@@ -45,33 +51,79 @@
 #define GET_NN(opcode) opcode & 0x00FF
 #define GET_N(opcode) opcode & 0x000F
 
+typedef enum MACHINE_FAULT
+{
+	FAULT_NONE,
+	FAULT_STACK_OVERFLOW,
+	FAULT_STACK_UNDERFLOW,
+	FAULT_UNKNOWN_OPCODE, //only raised by strict machines
+	FAULT_FONT_WRITE, //only raised by strict machines
+	FAULT_PC_OUT_OF_RANGE, //raised by the fuzzer when the program counter leaves the program area
+	NUM_MACHINE_FAULTS
+}MACHINE_FAULT;
+
+typedef uint16_t (*RECOMPILED_BLOCK)(MACHINE* machine);
+
+//What was written since the owner last cleared it, so consumers can look at only what changed. Set by every write
+//to RAM, the screen and the stack, and entirely by loading, resetting or copying a machine.
+typedef struct DIRTY_SET
+{
+	uint64_t lines; //bit k: RAM from k * DIRTY_LINE_SIZE, the guard counting as the line it mirrors
+	uint32_t rows; //bit y: pixel_row[y]
+	uint32_t stack; //bit k: stack[k]
+}DIRTY_SET;
+
+typedef struct RETURN_PREDICTION
+{
+	uint16_t address;
+	RECOMPILED_BLOCK block; //native block at address, so returns skip the dispatcher
+}RETURN_PREDICTION;
+
+//The hot core comes first, cache-line aligned, followed by RAM. Everything a frontend needs lives in a separately
+//allocated FRONTEND, so a headless instance costs sizeof(MACHINE), just under 5 KB, plus the analysis and fusion
+//tables of its program.
 typedef struct MACHINE
 {
-	bool on;
-	bool waiting_for_input;
-	bool input_received;
-	bool y_wrap_enabled;
-	int8_t RAM[RAM_SIZE];
+	_Alignas(CACHE_LINE_SIZE) void (*step)(MACHINE* machine); //runs one instruction, swapped by update_step_function
 	uint16_t pc_reg; //program counter
 	uint16_t i_reg; //index
-	uint16_t s_reg; //stack
+	uint16_t s_reg; //stack pointer, number of return addresses on the stack
+	uint16_t current_opcode;
+	uint16_t pending_cycles; //opcode timer ticks already spent by the last recompiled block or fused handler
+	uint8_t v_reg[NUM_V_REGS]; //variables
 	uint8_t d_counter; //delay timer counter
 	uint8_t s_counter; //sound timer counter
-	uint8_t v_reg[NUM_V_REGS]; //variables
+	uint8_t fault; //MACHINE_FAULT that halted the machine
+	bool on;
+	bool waiting_for_input;
+	bool input_received;
+	bool y_wrap_enabled;
+	bool hooks_armed; //selects the instrumented interpreter
+	bool fusion_enabled; //run common opcode sequences as single fused handlers
+	bool large_sprites_enabled; //DXY0 draws a 16x16 sprite, as on SCHIP
+	bool strict_enabled; //unknown opcodes and writes into the font fault instead of being ignored
+	bool key_pressed[KEYPAD_SIZE];
+	RECOMPILED_BLOCK next_block; //successor linked by the last recompiled block, NULL to go through the dispatcher
+	uint8_t* fusion; //FUSION_KIND starting at each address of the loaded program
+	uint32_t out_of_bounds; //accesses that ran past the end of RAM and wrapped around
+	uint32_t random_state; //xorshift32 state behind CXNN, never zero
+	DIRTY_SET dirty;
 	uint64_t pixel_row[NUM_PIXEL_ROWS]; //screen
-	uint16_t current_opcode;
+	uint16_t stack[STACK_DEPTH];
+	_Alignas(CACHE_LINE_SIZE) int8_t RAM[RAM_SIZE + RAM_GUARD_SIZE];
+	const struct RECOMPILED_PROGRAM* recompiled; //native code generated by c8rc, NULL when interpreting
+	RETURN_PREDICTION return_predictions[STACK_DEPTH];
 	char* program_name;
-	INPUT_KEY** keypad;
-	bool key_pressed[KEYPAD_WIDTH * KEYPAD_HEIGHT];
-	ALLEGRO_TIMER* counter_timer;
-	ALLEGRO_TIMER* opcode_timer;
-	ALLEGRO_DISPLAY* display;
-	DISPLAY_OPTIONS display_options;
-	ALLEGRO_BITMAP* pixel_on;
-	ALLEGRO_BITMAP* pixel_off;
-	ALLEGRO_SAMPLE* beep;
-	ALLEGRO_SAMPLE_ID beep_id;
-	bool beep_playing;
-	ALLEGRO_EVENT_QUEUE* event_queue;
+	uint8_t* program_data; //copy of the program, used to reset the machine
+	uint16_t program_size;
+	ANALYSIS* analysis; //static analysis of the loaded program
+	TRACE* trace; //execution trace, NULL unless tracing
 	DEBUG* debug;
-}MACHINE;
\ No newline at end of file
+	bool (*debug_hook)(DEBUG* debug, uint16_t opcode); //consulted before each instruction while hooks_armed
+	FRONTEND* frontend; //display, audio and input, NULL for headless machines
+	void (*delete_frontend)(MACHINE* machine);
+}MACHINE;
+
+_Static_assert(offsetof(MACHINE, pixel_row) < 2 * CACHE_LINE_SIZE, "Registers no longer fit in the first two cache lines");
+_Static_assert(sizeof(MACHINE) <= MACHINE_FOOTPRINT_LIMIT, "MACHINE grew past its documented footprint");
+_Static_assert(RAM_SIZE / DIRTY_LINE_SIZE == 64 && NUM_PIXEL_ROWS == 32 && STACK_DEPTH <= 32, "DIRTY_SET no longer covers the machine");
\ No newline at end of file
@@ -0,0 +1,49 @@
+﻿#pragma once
+#include <stdio.h>
+#include "metrics.h"
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+typedef SOCKET METRICS_SOCKET;
+#define NO_METRICS_SOCKET INVALID_SOCKET
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+typedef int METRICS_SOCKET;
+#define NO_METRICS_SOCKET -1
+#endif
+
+#define MAX_METRICS_FRAMES 1024 //frame times kept per interval for the percentiles, later ones only count in the mean
+#define MAX_METRICS_CLIENTS 8
+#define METRICS_LINE_SIZE 512
+
+typedef enum METRICS_FORMAT
+{
+	METRICS_CSV,
+	METRICS_JSON //one object per line
+}METRICS_FORMAT;
+
+//Counters of the running interval, folded into snapshot by update_metrics. Times are in seconds on the caller's clock.
+typedef struct METRICS
+{
+	double interval;
+	double interval_start; //0 until the first update
+	double last_frame;
+	uint64_t instructions;
+	double emulation_seconds;
+	double display_seconds;
+	double frame_total;
+	float frame_times[MAX_METRICS_FRAMES];
+	uint32_t frames;
+	uint64_t queue_depth_total;
+	uint32_t queue_depth_samples;
+	uint32_t queue_depth_max;
+	uint32_t dropped_ticks;
+	uint32_t beeper_toggles;
+	METRICS_SNAPSHOT snapshot;
+	FILE* file;
+	METRICS_FORMAT format;
+	METRICS_SOCKET listener; //local socket scrapers connect to, each gets every snapshot as a JSON line
+	METRICS_SOCKET clients[MAX_METRICS_CLIENTS];
+	char* socket_path;
+}METRICS;
\ No newline at end of file
@@ -0,0 +1,53 @@
+﻿#pragma once
+#include <stdbool.h>
+#include "pool.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+typedef HANDLE POOL_THREAD;
+#define LOCK_POOL(pool) AcquireSRWLockExclusive(&(pool)->lock)
+#define UNLOCK_POOL(pool) ReleaseSRWLockExclusive(&(pool)->lock)
+#define WAIT_POOL(pool, condition) SleepConditionVariableSRW(&(pool)->condition, &(pool)->lock, INFINITE, 0)
+#define WAKE_POOL(pool, condition) WakeAllConditionVariable(&(pool)->condition)
+#else
+typedef pthread_t POOL_THREAD;
+#define LOCK_POOL(pool) pthread_mutex_lock(&(pool)->lock)
+#define UNLOCK_POOL(pool) pthread_mutex_unlock(&(pool)->lock)
+#define WAIT_POOL(pool, condition) pthread_cond_wait(&(pool)->condition, &(pool)->lock)
+#define WAKE_POOL(pool, condition) pthread_cond_broadcast(&(pool)->condition)
+#endif
+
+typedef struct POOL_WORKER
+{
+	POOL* pool;
+	uint8_t index; //slice of every batch this worker runs, the caller runs slice 0
+	POOL_THREAD thread;
+}POOL_WORKER;
+
+//Persistent workers that split each batch of tasks into contiguous slices, one per thread plus the caller.
+//Nothing is allocated per batch.
+typedef struct POOL
+{
+#ifdef _WIN32
+	SRWLOCK lock;
+	CONDITION_VARIABLE start;
+	CONDITION_VARIABLE done;
+#else
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+#endif
+	POOL_TASK task;
+	void* context;
+	uint16_t count;
+	uint32_t generation; //bumped for each batch
+	uint8_t pending; //workers still running the current batch
+	bool quit;
+	uint8_t num_threads;
+	POOL_WORKER* workers;
+}POOL;
\ No newline at end of file
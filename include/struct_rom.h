@@ -0,0 +1,14 @@
+﻿#pragma once
+#include "rom.h"
+#include "struct_machine.h"
+
+//A program read and analysed ahead of time, so switch_program only copies it into a machine. Images can be
+//built on any thread and switched to any number of times.
+typedef struct ROM_IMAGE
+{
+	char* name;
+	uint8_t* data;
+	uint16_t size;
+	ANALYSIS* analysis;
+	uint8_t* fusion;
+}ROM_IMAGE;
\ No newline at end of file
@@ -0,0 +1,32 @@
+﻿#pragma once
+#include "terminal.h"
+#include "struct_machine.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <termios.h>
+#endif
+
+#define TERMINAL_ROWS (NUM_PIXEL_ROWS / 2) //each character cell shows two pixels, one above the other
+#define TERMINAL_STATUS_ROW (TERMINAL_ROWS + 1)
+#define TERMINAL_BUFFER_SIZE (16 * 1024) //a full redraw with a cursor move per cell fits
+#define TERMINAL_KEYPAD "x123qweasdzc4rfv" //key typed for each keypad value, laid out as DEFAULT_KEYPAD
+
+typedef struct TERMINAL
+{
+	FILE* out;
+	uint64_t shown_rows[NUM_PIXEL_ROWS]; //pixels currently on the terminal
+	bool drawn; //shown_rows is valid, otherwise the next frame redraws everything
+	bool quit;
+	uint8_t key_frames[KEYPAD_SIZE]; //frames each key stays held
+	char buffer[TERMINAL_BUFFER_SIZE]; //one frame of output, written at once
+	uint64_t frame_bytes; //since the last status line
+	double frame_seconds;
+	uint32_t status_frames;
+#ifdef _WIN32
+	DWORD saved_input_mode;
+	DWORD saved_output_mode;
+#else
+	struct termios saved_mode;
+#endif
+}TERMINAL;
\ No newline at end of file
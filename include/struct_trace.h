@@ -0,0 +1,42 @@
+﻿#pragma once
+#include "trace.h"
+#include "struct_machine.h"
+
+#define TRACE_BLOCK_SIZE 4096 //Records never straddle blocks, so the oldest intact block is easy to find after wrapping
+#define MAX_TRACE_RECORD_SIZE 30
+
+//Each record holds its length (1 byte), PC (2), opcode (2), changed V register mask (2) and changed special register mask (1),
+//followed by the new value of every changed V register in index order, then I (2), S (2), DT (1) and ST (1) if they changed.
+//A length of zero marks the end of a block.
+typedef enum TRACE_SPECIAL_REGISTER
+{
+	TRACE_I_CHANGED = 1 << 0,
+	TRACE_S_CHANGED = 1 << 1,
+	TRACE_DT_CHANGED = 1 << 2,
+	TRACE_ST_CHANGED = 1 << 3
+}TRACE_SPECIAL_REGISTER;
+
+typedef struct TRACE_SNAPSHOT
+{
+	uint8_t v_reg[NUM_V_REGS];
+	uint16_t pc_reg;
+	uint16_t i_reg;
+	uint16_t s_reg;
+	uint8_t d_counter;
+	uint8_t s_counter;
+	bool waiting_for_input;
+}TRACE_SNAPSHOT;
+
+typedef struct TRACE
+{
+	uint8_t* buffer;
+	uint32_t size;
+	uint32_t head;
+	bool wrapped;
+	uint64_t num_records;
+	char* file_name;
+	int descriptor; //opened by create_trace so that flushing, even from the crash handler, only needs write, -1 on failure
+}TRACE;
+
+void take_trace_snapshot(MACHINE* machine, TRACE_SNAPSHOT* snapshot);
+void record_trace(TRACE* trace, MACHINE* machine, uint16_t opcode, const TRACE_SNAPSHOT* before);
\ No newline at end of file
@@ -0,0 +1,30 @@
+﻿#pragma once
+#include "workload.h"
+#include "struct_machine.h"
+
+#define MAX_WORKLOAD_SETTINGS 16
+#define MAX_WORKLOAD_LINE 512
+#define DEFAULT_WORKLOAD_TICKS 12 //instructions per frame, the 700 Hz opcode timer over the 60 Hz counter timer
+
+typedef struct WORKLOAD_SETTING
+{
+	uint16_t first; //frame or address
+	uint16_t second; //mask, byte or length
+}WORKLOAD_SETTING;
+
+//A manifest line of c8conform or c8train: a ROM run headless for a number of frames with scripted input
+typedef struct WORKLOAD
+{
+	char rom[MAX_WORKLOAD_LINE];
+	char name[MAX_WORKLOAD_LINE]; //file name of the ROM without directory and extension
+	uint16_t frames;
+	uint16_t ticks;
+	bool y_wrap;
+	bool large_sprites;
+	WORKLOAD_SETTING keys[MAX_WORKLOAD_SETTINGS]; //decimal frame, keypad mask
+	uint8_t num_keys;
+	WORKLOAD_SETTING pokes[MAX_WORKLOAD_SETTINGS]; //address, byte
+	uint8_t num_pokes;
+	WORKLOAD_SETTING ram[MAX_WORKLOAD_SETTINGS]; //address, length
+	uint8_t num_ram;
+}WORKLOAD;
\ No newline at end of file
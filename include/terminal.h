@@ -0,0 +1,17 @@
+﻿#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "machine.h"
+
+#define TERMINAL_KEY_HOLD_FRAMES 8 //Terminals report no key releases, so a key counts as held this long after each press
+#define TERMINAL_QUIT_KEY 27 //Escape, when it does not start an arrow or function key sequence
+#define TERMINAL_INTERRUPT_KEY 3 //Ctrl-C, read as a key since raw mode turns off the signal
+
+typedef struct TERMINAL TERMINAL;
+
+TERMINAL* create_terminal(FILE* out);
+void delete_terminal(TERMINAL* terminal);
+uint32_t render_terminal(TERMINAL* terminal, const uint64_t* pixel_row);
+void read_terminal_keys(TERMINAL* terminal, MACHINE* machine);
+void run_terminal(MACHINE* machine, TERMINAL* terminal, uint32_t max_frames);
\ No newline at end of file
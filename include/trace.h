@@ -0,0 +1,14 @@
+﻿#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DEFAULT_TRACE_SIZE (1 << 20) //Ring buffer size in bytes, about 100k instructions
+#define TRACE_FILE_MAGIC "C8TRACE1"
+
+typedef struct TRACE TRACE;
+typedef struct MACHINE MACHINE;
+
+TRACE* create_trace(uint32_t size, const char* file_name);
+void delete_trace(TRACE* trace);
+bool flush_trace(TRACE* trace);
+void install_trace_crash_handler(TRACE* trace);
\ No newline at end of file
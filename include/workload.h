@@ -0,0 +1,11 @@
+﻿#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "machine.h"
+
+typedef struct WORKLOAD WORKLOAD;
+
+bool parse_workload(char* line, WORKLOAD* workload, char** columns, uint8_t num_columns);
+MACHINE* create_workload_machine(const WORKLOAD* workload, const uint8_t* program, uint16_t size, bool fusion_enabled);
+void play_workload(MACHINE* machine, const WORKLOAD* workload);
+double get_seconds();
\ No newline at end of file
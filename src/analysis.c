@@ -0,0 +1,393 @@
+﻿#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "disassembler.h"
+#include "struct_analysis.h"
+
+typedef struct WORKLIST
+{
+	uint16_t addresses[RAM_SIZE];
+	bool queued[RAM_SIZE];
+	uint16_t count;
+}WORKLIST;
+
+static uint16_t read_word(const uint8_t* RAM, uint16_t address);
+static BLOCK_EXIT classify_opcode(uint16_t opcode);
+static void push_address(WORKLIST* worklist, uint16_t address);
+static void mark_written(ANALYSIS* analysis, uint16_t address, uint8_t length);
+static void mark_reachable(ANALYSIS* analysis, const uint8_t* RAM);
+static void mark_block_starts(ANALYSIS* analysis, const uint8_t* RAM);
+static void build_blocks(ANALYSIS* analysis, const uint8_t* RAM);
+static void mark_idle_loops(ANALYSIS* analysis, const uint8_t* RAM);
+static bool is_code(const ANALYSIS* analysis, uint16_t address);
+
+//Follows jumps, calls and skips from the program start to separate code from data and split the code into basic blocks
+ANALYSIS* analyze_program(const uint8_t* RAM, uint16_t program_start, uint16_t program_size)
+{
+	ANALYSIS* analysis = calloc(1, sizeof(ANALYSIS));
+	assert(analysis);
+	analysis->program_start = program_start;
+	analysis->program_end = program_start + program_size > RAM_SIZE ? RAM_SIZE : program_start + program_size;
+	mark_reachable(analysis, RAM);
+	mark_block_starts(analysis, RAM);
+	build_blocks(analysis, RAM);
+	mark_idle_loops(analysis, RAM);
+	for (uint16_t i = 0; i < RAM_SIZE; i++)
+	{
+		if ((analysis->flags[i] & (ADDRESS_CODE | ADDRESS_OPERAND)) && (analysis->flags[i] & ADDRESS_WRITTEN))
+		{
+			analysis->flags[i] |= ADDRESS_SELF_MODIFIED;
+			analysis->num_self_modified++;
+		}
+	}
+	return analysis;
+}
+
+ANALYSIS* copy_analysis(const ANALYSIS* analysis)
+{
+	ANALYSIS* copy = malloc(sizeof(ANALYSIS));
+	assert(copy);
+	memcpy(copy, analysis, sizeof(ANALYSIS));
+	copy->blocks = malloc(analysis->num_blocks * sizeof(BASIC_BLOCK) + 1);
+	assert(copy->blocks);
+	memcpy(copy->blocks, analysis->blocks, analysis->num_blocks * sizeof(BASIC_BLOCK));
+	return copy;
+}
+
+void delete_analysis(ANALYSIS* analysis)
+{
+	if (!analysis)
+	{
+		return;
+	}
+	free(analysis->blocks);
+	free(analysis);
+}
+
+const BASIC_BLOCK* find_block(const ANALYSIS* analysis, uint16_t address)
+{
+	int32_t low = 0;
+	int32_t high = analysis->num_blocks - 1;
+	while (low <= high)
+	{
+		int32_t middle = (low + high) / 2;
+		const BASIC_BLOCK* block = &analysis->blocks[middle];
+		if (address < block->start)
+		{
+			high = middle - 1;
+		}
+		else if (address >= block->end)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			return block;
+		}
+	}
+	return NULL;
+}
+
+void export_listing(const ANALYSIS* analysis, const uint8_t* RAM, FILE* file)
+{
+	fprintf(file, "; program %03hX-%03hX: %hu blocks, %hu idle loops, %hu self-modified bytes%s\n",
+		analysis->program_start, analysis->program_end - 1, analysis->num_blocks, analysis->num_idle_loops,
+		analysis->num_self_modified, analysis->has_computed_jumps ? ", computed jumps" : "");
+	const BASIC_BLOCK* block = NULL;
+	uint16_t address = analysis->program_start;
+	while (address < analysis->program_end)
+	{
+		uint8_t flags = analysis->flags[address];
+		if (!(flags & ADDRESS_CODE))
+		{
+			fprintf(file, "\t%03hX  db", address);
+			for (uint8_t i = 0; i < 8 && address < analysis->program_end && !is_code(analysis, address); i++, address++)
+			{
+				fprintf(file, " %02hhX", RAM[address]);
+			}
+			fprintf(file, "\n");
+			continue;
+		}
+		if (flags & ADDRESS_BLOCK_START)
+		{
+			block = &analysis->blocks[analysis->block_index[address]];
+			fprintf(file, "\nL_%03hX:%s%s%s%s%s\n", address,
+				address == analysis->program_start ? " ; entry" : "",
+				(flags & ADDRESS_CALL_TARGET) ? " ; subroutine" : "",
+				(flags & ADDRESS_JUMP_TARGET) ? " ; jump target" : "",
+				(flags & ADDRESS_IDLE_LOOP) ? " ; idle loop" : "",
+				(flags & ADDRESS_SELF_MODIFIED) ? " ; self-modified" : "");
+		}
+		char asm_text[32] = "";
+		uint16_t opcode = read_word(RAM, address);
+		opcode_to_string(asm_text, opcode);
+		fprintf(file, "\t%03hX  %04hX  %s\n", address, opcode, asm_text);
+		address += MEM_STEP;
+		if (block && address == block->end && block->num_successors > 0)
+		{
+			fprintf(file, "\t; ->");
+			for (uint8_t i = 0; i < block->num_successors; i++)
+			{
+				fprintf(file, " L_%03hX", block->successors[i]);
+			}
+			fprintf(file, "\n");
+		}
+	}
+}
+
+//Writes the control-flow graph in Graphviz dot format
+void export_cfg(const ANALYSIS* analysis, FILE* file)
+{
+	fprintf(file, "digraph cfg {\n\tnode [shape=box fontname=monospace];\n");
+	for (uint16_t i = 0; i < analysis->num_blocks; i++)
+	{
+		const BASIC_BLOCK* block = &analysis->blocks[i];
+		fprintf(file, "\tL_%03hX [label=\"%03hX-%03hX\"%s];\n", block->start, block->start, block->end - 1,
+			(analysis->flags[block->start] & ADDRESS_IDLE_LOOP) ? " style=dashed" : "");
+		for (uint8_t j = 0; j < block->num_successors; j++)
+		{
+			fprintf(file, "\tL_%03hX -> L_%03hX%s;\n", block->start, block->successors[j],
+				(block->exit == EXIT_CALL && j == 0) ? " [style=bold]" : "");
+		}
+	}
+	fprintf(file, "}\n");
+}
+
+static uint16_t read_word(const uint8_t* RAM, uint16_t address)
+{
+	return (RAM[MASK_ADDRESS(address)] << 8) | RAM[MASK_ADDRESS(address + 1)];
+}
+
+static BLOCK_EXIT classify_opcode(uint16_t opcode)
+{
+	uint8_t nn = GET_NN(opcode);
+	switch (GET_TYPE(opcode))
+	{
+	case 0x0:
+		return nn == 0xEE ? EXIT_RETURN : EXIT_FALLTHROUGH;
+	case 0x1:
+		return EXIT_JUMP;
+	case 0x2:
+		return EXIT_CALL;
+	case 0x3:
+	case 0x4:
+	case 0x5:
+	case 0x9:
+		return EXIT_SKIP;
+	case 0xB:
+		return EXIT_COMPUTED_JUMP;
+	case 0xE:
+		return (nn == 0x9E || nn == 0xA1) ? EXIT_SKIP : EXIT_FALLTHROUGH;
+	case 0xF:
+		return nn == 0x0A ? EXIT_WAIT_FOR_KEY : EXIT_FALLTHROUGH;
+	}
+	return EXIT_FALLTHROUGH;
+}
+
+static void push_address(WORKLIST* worklist, uint16_t address)
+{
+	address = MASK_ADDRESS(address);
+	if (!worklist->queued[address])
+	{
+		worklist->queued[address] = true;
+		worklist->addresses[worklist->count++] = address;
+	}
+}
+
+static void mark_written(ANALYSIS* analysis, uint16_t address, uint8_t length)
+{
+	for (uint8_t i = 0; i < length; i++)
+	{
+		analysis->flags[MASK_ADDRESS(address + i)] |= ADDRESS_WRITTEN;
+	}
+}
+
+//I is tracked within straight-line code so that FX33 and FX55 after ANNN reveal which bytes the program overwrites
+static void mark_reachable(ANALYSIS* analysis, const uint8_t* RAM)
+{
+	WORKLIST* worklist = calloc(1, sizeof(WORKLIST));
+	assert(worklist);
+	push_address(worklist, analysis->program_start);
+	while (worklist->count > 0)
+	{
+		uint16_t address = worklist->addresses[--worklist->count];
+		int32_t known_i = -1;
+		bool block_open = true;
+		while (block_open && address >= analysis->program_start && address + 1 < analysis->program_end && !(analysis->flags[address] & ADDRESS_CODE))
+		{
+			uint16_t opcode = read_word(RAM, address);
+			uint16_t nnn = GET_NNN(opcode);
+			analysis->flags[address] |= ADDRESS_CODE;
+			analysis->flags[address + 1] |= ADDRESS_OPERAND;
+			if (GET_TYPE(opcode) == 0xA)
+			{
+				known_i = nnn;
+			}
+			else if ((opcode & 0xF0FF) == 0xF01E || (opcode & 0xF0FF) == 0xF029)
+			{
+				known_i = -1;
+			}
+			else if ((opcode & 0xF0FF) == 0xF033 && known_i >= 0)
+			{
+				mark_written(analysis, known_i, 3);
+			}
+			else if ((opcode & 0xF0FF) == 0xF055 && known_i >= 0)
+			{
+				mark_written(analysis, known_i, (GET_X(opcode)) + 1);
+			}
+			switch (classify_opcode(opcode))
+			{
+			case EXIT_FALLTHROUGH:
+			case EXIT_WAIT_FOR_KEY:
+				address += MEM_STEP;
+				continue;
+			case EXIT_JUMP:
+				analysis->flags[nnn] |= ADDRESS_JUMP_TARGET;
+				push_address(worklist, nnn);
+				break;
+			case EXIT_CALL:
+				analysis->flags[nnn] |= ADDRESS_CALL_TARGET;
+				push_address(worklist, nnn);
+				push_address(worklist, address + MEM_STEP);
+				break;
+			case EXIT_SKIP:
+				push_address(worklist, address + MEM_STEP);
+				push_address(worklist, address + 2 * MEM_STEP);
+				break;
+			case EXIT_COMPUTED_JUMP:
+				analysis->has_computed_jumps = true;
+				analysis->flags[nnn] |= ADDRESS_JUMP_TARGET;
+				push_address(worklist, nnn);
+				break;
+			case EXIT_RETURN:
+				break;
+			}
+			block_open = false;
+		}
+	}
+	free(worklist);
+}
+
+static void mark_block_starts(ANALYSIS* analysis, const uint8_t* RAM)
+{
+	analysis->flags[analysis->program_start] |= ADDRESS_BLOCK_START;
+	for (uint16_t address = analysis->program_start; address < analysis->program_end; address++)
+	{
+		uint8_t flags = analysis->flags[address];
+		if (!(flags & ADDRESS_CODE))
+		{
+			continue;
+		}
+		if (flags & (ADDRESS_JUMP_TARGET | ADDRESS_CALL_TARGET))
+		{
+			analysis->flags[address] |= ADDRESS_BLOCK_START;
+		}
+		switch (classify_opcode(read_word(RAM, address)))
+		{
+		case EXIT_SKIP:
+			analysis->flags[MASK_ADDRESS(address + 2 * MEM_STEP)] |= ADDRESS_BLOCK_START;
+			//fallthrough - a skip also continues at the next instruction
+		case EXIT_CALL:
+		case EXIT_WAIT_FOR_KEY:
+			analysis->flags[MASK_ADDRESS(address + MEM_STEP)] |= ADDRESS_BLOCK_START;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static void build_blocks(ANALYSIS* analysis, const uint8_t* RAM)
+{
+	memset(analysis->block_index, 0xFF, sizeof(analysis->block_index));
+	for (uint16_t address = analysis->program_start; address < analysis->program_end; address++)
+	{
+		if ((analysis->flags[address] & ADDRESS_BLOCK_START) && is_code(analysis, address))
+		{
+			analysis->num_blocks++;
+		}
+	}
+	analysis->blocks = calloc(analysis->num_blocks + 1, sizeof(BASIC_BLOCK));
+	assert(analysis->blocks);
+	uint16_t index = 0;
+	for (uint16_t start = analysis->program_start; start < analysis->program_end; start++)
+	{
+		if (!(analysis->flags[start] & ADDRESS_BLOCK_START) || !is_code(analysis, start))
+		{
+			continue;
+		}
+		BASIC_BLOCK* block = &analysis->blocks[index];
+		analysis->block_index[start] = index++;
+		block->start = start;
+		uint16_t address = start;
+		while (true)
+		{
+			uint16_t opcode = read_word(RAM, address);
+			uint16_t next = address + MEM_STEP;
+			block->end = next;
+			block->exit = classify_opcode(opcode);
+			switch (block->exit)
+			{
+			case EXIT_JUMP:
+				block->successors[block->num_successors++] = GET_NNN(opcode);
+				break;
+			case EXIT_CALL:
+				block->successors[block->num_successors++] = GET_NNN(opcode);
+				block->successors[block->num_successors++] = next;
+				break;
+			case EXIT_SKIP:
+				block->successors[block->num_successors++] = next;
+				block->successors[block->num_successors++] = next + MEM_STEP;
+				break;
+			case EXIT_WAIT_FOR_KEY:
+				block->successors[block->num_successors++] = next;
+				break;
+			case EXIT_FALLTHROUGH:
+				if (!is_code(analysis, next))
+				{
+					break;
+				}
+				if (analysis->flags[next] & ADDRESS_BLOCK_START)
+				{
+					block->successors[block->num_successors++] = next;
+					break;
+				}
+				address = next;
+				continue;
+			default:
+				break;
+			}
+			break;
+		}
+	}
+}
+
+//Recognizes "1NNN" jumping to itself, "FX07; 3X00; 1NNN" waiting for the delay timer and "EX9E/EXA1; 1NNN" waiting for a key
+static void mark_idle_loops(ANALYSIS* analysis, const uint8_t* RAM)
+{
+	for (uint16_t address = analysis->program_start; address < analysis->program_end; address++)
+	{
+		if (!is_code(analysis, address))
+		{
+			continue;
+		}
+		uint16_t opcode = read_word(RAM, address);
+		uint16_t next = read_word(RAM, address + MEM_STEP);
+		uint16_t after_next = read_word(RAM, address + 2 * MEM_STEP);
+		uint16_t jump_back = 0x1000 | address;
+		uint16_t x = GET_X(opcode);
+		bool idle = opcode == jump_back;
+		idle |= (opcode & 0xF0FF) == 0xF007 && next == (0x3000 | (x << 8)) && after_next == jump_back;
+		idle |= ((opcode & 0xF0FF) == 0xE09E || (opcode & 0xF0FF) == 0xE0A1) && next == jump_back;
+		if (idle)
+		{
+			analysis->flags[address] |= ADDRESS_IDLE_LOOP;
+			analysis->num_idle_loops++;
+		}
+	}
+}
+
+static bool is_code(const ANALYSIS* analysis, uint16_t address)
+{
+	return address < RAM_SIZE && (analysis->flags[address] & ADDRESS_CODE);
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+﻿#include <allegro5/allegro_memfile.h>
+#include <string.h>
+#include "assets.h"
+
+#ifdef C8_EMBEDDED_ASSETS
+extern const ASSET embedded_assets[];
+extern const uint16_t num_embedded_assets;
+#endif
+
+//Looks for the embedded copy when built with C8_EMBEDDED_ASSETS, then next to the executable, then relative to
+//the working directory as before. Returns NULL if none exists.
+ALLEGRO_FILE* open_asset(const char* name)
+{
+#ifdef C8_EMBEDDED_ASSETS
+	for (uint16_t i = 0; i < num_embedded_assets; i++)
+	{
+		if (strcmp(embedded_assets[i].name, name) == 0)
+		{
+			return al_open_memfile((void*)embedded_assets[i].data, embedded_assets[i].size, "rb");
+		}
+	}
+#endif
+	ALLEGRO_FILE* file = NULL;
+	ALLEGRO_PATH* path = al_get_standard_path(ALLEGRO_RESOURCES_PATH);
+	if (path)
+	{
+		ALLEGRO_PATH* asset = al_create_path(name);
+		al_join_paths(path, asset);
+		file = al_fopen(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP), "rb");
+		al_destroy_path(asset);
+		al_destroy_path(path);
+	}
+	return file ? file : al_fopen(name, "rb");
+}
\ No newline at end of file
@@ -0,0 +1,481 @@
+﻿#include <assert.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "struct_breakpoints.h"
+
+#define TEST_BIT(map, address) ((map)[((address) & (RAM_SIZE - 1)) >> 3] & (1 << ((address) & 7)))
+#define SET_BIT(map, address) (map)[((address) & (RAM_SIZE - 1)) >> 3] |= (1 << ((address) & 7))
+#define CLEAR_BIT(map, address) (map)[((address) & (RAM_SIZE - 1)) >> 3] &= ~(1 << ((address) & 7))
+
+typedef struct CONDITION_PARSER
+{
+	const char* text;
+	CONDITION* condition;
+	uint8_t size;
+	uint8_t depth;
+	bool error;
+}CONDITION_PARSER;
+
+static void skip_spaces(CONDITION_PARSER* parser);
+static bool accept(CONDITION_PARSER* parser, const char* token);
+static void emit(CONDITION_PARSER* parser, uint8_t op, int8_t depth_change);
+static void parse_operand(CONDITION_PARSER* parser);
+static void parse_unary(CONDITION_PARSER* parser);
+static void parse_sum(CONDITION_PARSER* parser);
+static void parse_comparison(CONDITION_PARSER* parser);
+static void parse_and(CONDITION_PARSER* parser);
+static void parse_or(CONDITION_PARSER* parser);
+static bool evaluate_condition(const CONDITION* condition, MACHINE* machine);
+static bool writes_watched_memory(BREAKPOINTS* breakpoints, MACHINE* machine, uint16_t opcode);
+
+BREAKPOINTS* create_breakpoints()
+{
+	BREAKPOINTS* breakpoints = calloc(1, sizeof(BREAKPOINTS));
+	assert(breakpoints);
+	return breakpoints;
+}
+
+void delete_breakpoints(BREAKPOINTS* breakpoints)
+{
+	free(breakpoints);
+}
+
+void clear_breakpoints(BREAKPOINTS* breakpoints)
+{
+	memset(breakpoints, 0, sizeof(BREAKPOINTS));
+}
+
+bool breakpoints_armed(BREAKPOINTS* breakpoints)
+{
+	return breakpoints->num_breakpoints > 0 || breakpoints->num_watchpoints > 0 || breakpoints->num_conditions > 0;
+}
+
+void add_breakpoint(BREAKPOINTS* breakpoints, uint16_t address)
+{
+	if (!TEST_BIT(breakpoints->pc_map, address))
+	{
+		SET_BIT(breakpoints->pc_map, address);
+		breakpoints->num_breakpoints++;
+	}
+}
+
+void remove_breakpoint(BREAKPOINTS* breakpoints, uint16_t address)
+{
+	if (TEST_BIT(breakpoints->pc_map, address))
+	{
+		CLEAR_BIT(breakpoints->pc_map, address);
+		breakpoints->num_breakpoints--;
+	}
+}
+
+bool has_breakpoint(const BREAKPOINTS* breakpoints, uint16_t address)
+{
+	return TEST_BIT(breakpoints->pc_map, address) != 0;
+}
+
+void add_watchpoint(BREAKPOINTS* breakpoints, uint16_t address, uint16_t length)
+{
+	for (uint16_t i = 0; i < length; i++)
+	{
+		if (!TEST_BIT(breakpoints->watch_map, address + i))
+		{
+			SET_BIT(breakpoints->watch_map, address + i);
+			breakpoints->num_watchpoints++;
+		}
+	}
+}
+
+void remove_watchpoint(BREAKPOINTS* breakpoints, uint16_t address, uint16_t length)
+{
+	for (uint16_t i = 0; i < length; i++)
+	{
+		if (TEST_BIT(breakpoints->watch_map, address + i))
+		{
+			CLEAR_BIT(breakpoints->watch_map, address + i);
+			breakpoints->num_watchpoints--;
+		}
+	}
+}
+
+//Compiles an expression such as "V3 == 0x10 && I > 0x300" into postfix bytecode
+bool add_condition(BREAKPOINTS* breakpoints, const char* expression)
+{
+	if (breakpoints->num_conditions >= MAX_CONDITIONS)
+	{
+		return false;
+	}
+	CONDITION* condition = &breakpoints->conditions[breakpoints->num_conditions];
+	CONDITION_PARSER parser = { .text = expression, .condition = condition };
+	parse_or(&parser);
+	skip_spaces(&parser);
+	if (*parser.text != '\0')
+	{
+		parser.error = true;
+	}
+	emit(&parser, COND_END, 0);
+	if (parser.error)
+	{
+		memset(condition, 0, sizeof(CONDITION));
+		return false;
+	}
+	strncpy(condition->text, expression, MAX_CONDITION_TEXT_SIZE - 1);
+	breakpoints->num_conditions++;
+	return true;
+}
+
+BREAK_REASON check_breakpoints(BREAKPOINTS* breakpoints, MACHINE* machine, uint16_t opcode)
+{
+	if (TEST_BIT(breakpoints->pc_map, machine->pc_reg))
+	{
+		return BREAK_PC;
+	}
+	if (breakpoints->num_watchpoints > 0 && writes_watched_memory(breakpoints, machine, opcode))
+	{
+		return BREAK_WATCH;
+	}
+	for (uint8_t i = 0; i < breakpoints->num_conditions; i++)
+	{
+		if (evaluate_condition(&breakpoints->conditions[i], machine))
+		{
+			return BREAK_CONDITION;
+		}
+	}
+	return BREAK_NONE;
+}
+
+const char* break_reason_to_string(BREAK_REASON reason)
+{
+	switch (reason)
+	{
+	case BREAK_PC:
+		return "Breakpoint";
+	case BREAK_WATCH:
+		return "Watchpoint";
+	case BREAK_CONDITION:
+		return "Condition";
+	default:
+		return "None";
+	}
+}
+
+static void skip_spaces(CONDITION_PARSER* parser)
+{
+	while (isspace((unsigned char)*parser->text))
+	{
+		parser->text++;
+	}
+}
+
+static bool accept(CONDITION_PARSER* parser, const char* token)
+{
+	skip_spaces(parser);
+	size_t length = strlen(token);
+	if (strncmp(parser->text, token, length) != 0)
+	{
+		return false;
+	}
+	parser->text += length;
+	return true;
+}
+
+static void emit(CONDITION_PARSER* parser, uint8_t op, int8_t depth_change)
+{
+	if (parser->size >= MAX_CONDITION_CODE_SIZE)
+	{
+		parser->error = true;
+		return;
+	}
+	parser->condition->code[parser->size++] = op;
+	parser->depth += depth_change;
+	if (parser->depth > CONDITION_STACK_SIZE)
+	{
+		parser->error = true;
+	}
+}
+
+static void parse_operand(CONDITION_PARSER* parser)
+{
+	skip_spaces(parser);
+	const char* text = parser->text;
+	char c = toupper((unsigned char)text[0]);
+	if (isdigit((unsigned char)c))
+	{
+		char* end;
+		unsigned long value = strtoul(text, &end, 0);
+		parser->text = end;
+		emit(parser, COND_PUSH_CONST, 1);
+		emit(parser, (value >> 8) & 0xFF, 0);
+		emit(parser, value & 0xFF, 0);
+		if (value > 0xFFFF)
+		{
+			parser->error = true;
+		}
+		return;
+	}
+	char next = toupper((unsigned char)text[1]);
+	if (c == 'V' && isxdigit((unsigned char)next))
+	{
+		parser->text += 2;
+		emit(parser, COND_PUSH_V, 1);
+		emit(parser, isdigit((unsigned char)next) ? next - '0' : next - 'A' + 10, 0);
+	}
+	else if (c == 'P' && next == 'C')
+	{
+		parser->text += 2;
+		emit(parser, COND_PUSH_PC, 1);
+	}
+	else if (c == 'S' && next == 'P')
+	{
+		parser->text += 2;
+		emit(parser, COND_PUSH_SP, 1);
+	}
+	else if (c == 'D' && next == 'T')
+	{
+		parser->text += 2;
+		emit(parser, COND_PUSH_DT, 1);
+	}
+	else if (c == 'S' && next == 'T')
+	{
+		parser->text += 2;
+		emit(parser, COND_PUSH_ST, 1);
+	}
+	else if (c == 'I')
+	{
+		parser->text += 1;
+		emit(parser, COND_PUSH_I, 1);
+	}
+	else
+	{
+		parser->error = true;
+		return;
+	}
+	if (isalnum((unsigned char)*parser->text))
+	{
+		parser->error = true;
+	}
+}
+
+static void parse_unary(CONDITION_PARSER* parser)
+{
+	if (parser->error)
+	{
+		return;
+	}
+	if (accept(parser, "!"))
+	{
+		parse_unary(parser);
+		emit(parser, COND_NOT, 0);
+	}
+	else if (accept(parser, "("))
+	{
+		parse_or(parser);
+		if (!accept(parser, ")"))
+		{
+			parser->error = true;
+		}
+	}
+	else
+	{
+		parse_operand(parser);
+	}
+}
+
+static void parse_sum(CONDITION_PARSER* parser)
+{
+	parse_unary(parser);
+	while (!parser->error)
+	{
+		uint8_t op;
+		if (accept(parser, "+"))
+		{
+			op = COND_ADD;
+		}
+		else if (accept(parser, "-"))
+		{
+			op = COND_SUB;
+		}
+		else if (parser->text[0] == '&' && parser->text[1] != '&')
+		{
+			parser->text++;
+			op = COND_BIT_AND;
+		}
+		else
+		{
+			return;
+		}
+		parse_unary(parser);
+		emit(parser, op, -1);
+	}
+}
+
+static void parse_comparison(CONDITION_PARSER* parser)
+{
+	parse_sum(parser);
+	uint8_t op;
+	if (accept(parser, "=="))
+	{
+		op = COND_EQ;
+	}
+	else if (accept(parser, "!="))
+	{
+		op = COND_NE;
+	}
+	else if (accept(parser, "<="))
+	{
+		op = COND_LE;
+	}
+	else if (accept(parser, ">="))
+	{
+		op = COND_GE;
+	}
+	else if (accept(parser, "<"))
+	{
+		op = COND_LT;
+	}
+	else if (accept(parser, ">"))
+	{
+		op = COND_GT;
+	}
+	else
+	{
+		return;
+	}
+	parse_sum(parser);
+	emit(parser, op, -1);
+}
+
+static void parse_and(CONDITION_PARSER* parser)
+{
+	parse_comparison(parser);
+	while (!parser->error && accept(parser, "&&"))
+	{
+		parse_comparison(parser);
+		emit(parser, COND_AND, -1);
+	}
+}
+
+static void parse_or(CONDITION_PARSER* parser)
+{
+	parse_and(parser);
+	while (!parser->error && accept(parser, "||"))
+	{
+		parse_and(parser);
+		emit(parser, COND_OR, -1);
+	}
+}
+
+static bool evaluate_condition(const CONDITION* condition, MACHINE* machine)
+{
+	int32_t stack[CONDITION_STACK_SIZE];
+	uint8_t top = 0;
+	const uint8_t* code = condition->code;
+	while (true)
+	{
+		switch (*code++)
+		{
+		case COND_END:
+			return top > 0 && stack[top - 1] != 0;
+		case COND_PUSH_CONST:
+			stack[top++] = (code[0] << 8) | code[1];
+			code += 2;
+			break;
+		case COND_PUSH_V:
+			stack[top++] = machine->v_reg[*code++];
+			break;
+		case COND_PUSH_I:
+			stack[top++] = machine->i_reg;
+			break;
+		case COND_PUSH_PC:
+			stack[top++] = machine->pc_reg;
+			break;
+		case COND_PUSH_SP:
+			stack[top++] = machine->s_reg;
+			break;
+		case COND_PUSH_DT:
+			stack[top++] = machine->d_counter;
+			break;
+		case COND_PUSH_ST:
+			stack[top++] = machine->s_counter;
+			break;
+		case COND_EQ:
+			top--;
+			stack[top - 1] = stack[top - 1] == stack[top];
+			break;
+		case COND_NE:
+			top--;
+			stack[top - 1] = stack[top - 1] != stack[top];
+			break;
+		case COND_LT:
+			top--;
+			stack[top - 1] = stack[top - 1] < stack[top];
+			break;
+		case COND_LE:
+			top--;
+			stack[top - 1] = stack[top - 1] <= stack[top];
+			break;
+		case COND_GT:
+			top--;
+			stack[top - 1] = stack[top - 1] > stack[top];
+			break;
+		case COND_GE:
+			top--;
+			stack[top - 1] = stack[top - 1] >= stack[top];
+			break;
+		case COND_ADD:
+			top--;
+			stack[top - 1] += stack[top];
+			break;
+		case COND_SUB:
+			top--;
+			stack[top - 1] -= stack[top];
+			break;
+		case COND_BIT_AND:
+			top--;
+			stack[top - 1] &= stack[top];
+			break;
+		case COND_AND:
+			top--;
+			stack[top - 1] = stack[top - 1] && stack[top];
+			break;
+		case COND_OR:
+			top--;
+			stack[top - 1] = stack[top - 1] || stack[top];
+			break;
+		case COND_NOT:
+			stack[top - 1] = !stack[top - 1];
+			break;
+		default:
+			return false;
+		}
+	}
+}
+
+//Only FX33 and FX55 write to RAM, so the written range can be worked out before executing them
+static bool writes_watched_memory(BREAKPOINTS* breakpoints, MACHINE* machine, uint16_t opcode)
+{
+	uint16_t address;
+	uint8_t length;
+	if ((opcode & 0xF0FF) == 0xF033)
+	{
+		address = machine->i_reg;
+		length = 3;
+	}
+	else if ((opcode & 0xF0FF) == 0xF055)
+	{
+		address = machine->i_reg;
+		length = (GET_X(opcode)) + 1;
+	}
+	else
+	{
+		return false;
+	}
+	for (uint8_t i = 0; i < length; i++)
+	{
+		if (TEST_BIT(breakpoints->watch_map, address + i))
+		{
+			return true;
+		}
+	}
+	return false;
+}
\ No newline at end of file
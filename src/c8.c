@@ -1,20 +1,227 @@
 ﻿#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <allegro5/allegro.h>
-#include "machine.h"
+#include "frontend.h"
+#include "debug.h"
+#include "trace.h"
+#include "export.h"
+#include "grid.h"
+#ifdef C8_RECOMPILED
+#include "recompiler.h"
+#endif
 
-int main()
+static double elapsed_ms(const struct timespec* since)
 {
+	struct timespec now;
+	timespec_get(&now, TIME_UTC);
+	return (now.tv_sec - since->tv_sec) * 1000.0 + (now.tv_nsec - since->tv_nsec) / 1000000.0;
+}
+
+int main(int argc, char** argv)
+{
+	struct timespec launch;
+	timespec_get(&launch, TIME_UTC);
+	const char* program = "roms/games/Bowling [Gooitzen van der Wal].ch8";
+	const char** playlist = malloc(argc * sizeof(char*));
+	uint16_t playlist_size = 0;
+	bool preload = false;
+	const char* debug_script = NULL;
+	const char* trace_file = NULL;
+	const char* export_name = NULL;
+	const char* keymap_file = NULL;
+	const char* metrics_file = NULL;
+	const char* metrics_socket = NULL;
+	const char* capture_name = NULL;
+	uint8_t capture_scale = 1;
+	int turbo_speed = -1;
+	uint16_t grid_tiles = 0;
+	bool first_frame_only = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--debug-script") == 0 && i + 1 < argc)
+		{
+			debug_script = argv[++i];
+		}
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+		{
+			trace_file = argv[++i];
+		}
+		else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc)
+		{
+			export_name = argv[++i];
+		}
+		else if (strcmp(argv[i], "--keymap") == 0 && i + 1 < argc)
+		{
+			keymap_file = argv[++i];
+		}
+		else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc)
+		{
+			metrics_file = argv[++i];
+		}
+		else if (strcmp(argv[i], "--metrics-socket") == 0 && i + 1 < argc)
+		{
+			metrics_socket = argv[++i];
+		}
+		else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+		{
+			capture_name = argv[++i];
+		}
+		else if (strcmp(argv[i], "--capture-scale") == 0 && i + 1 < argc)
+		{
+			capture_scale = (uint8_t)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--turbo-speed") == 0 && i + 1 < argc)
+		{
+			i++;
+			turbo_speed = strcmp(argv[i], "max") == 0 ? 0 : atoi(argv[i]);
+		}
+		else if (strcmp(argv[i], "--grid") == 0 && i + 1 < argc)
+		{
+			grid_tiles = (uint16_t)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--first-frame") == 0)
+		{
+			first_frame_only = true;
+		}
+		else if (strcmp(argv[i], "--preload") == 0)
+		{
+			preload = true;
+		}
+		else
+		{
+			playlist[playlist_size++] = argv[i];
+		}
+	}
+	if (playlist_size == 0)
+	{
+		playlist[playlist_size++] = program;
+	}
 	start_allegro();
+	double allegro_ms = elapsed_ms(&launch);
 	DISPLAY_OPTIONS display_options =
 	{
 		.scale = 8,
 		.color_on = al_map_rgb(255, 255, 255),
 		.color_off = al_map_rgb(0, 0, 0)
 	};
+	if (grid_tiles > 0)
+	{
+		//Attract mode: the programs fill the tiles in turn, without the menu, debugger or other options
+		GRID* grid = create_grid(display_options, playlist, playlist_size, grid_tiles, (uint32_t)time(NULL));
+		free(playlist);
+		if (!grid)
+		{
+			fprintf(stderr, "Could not read any of the programs\n");
+			end_allegro();
+			return 1;
+		}
+		if (keymap_file && !load_keymap(get_grid_keymap(grid), keymap_file))
+		{
+			fprintf(stderr, "Could not fully load keymap %s\n", keymap_file);
+		}
+		run_grid(grid);
+		delete_grid(grid);
+		end_allegro();
+		return 0;
+	}
 	MACHINE* m = create_machine(display_options);
-	load_program(m, "roms/games/Bowling [Gooitzen van der Wal].ch8");
+	double machine_ms = elapsed_ms(&launch);
+#ifdef C8_RECOMPILED
+	load_program_data(m, recompiled_program.name, recompiled_program.rom, recompiled_program.size);
+	set_recompiled_program(m, &recompiled_program);
+#else
+	load_program(m, playlist[0]);
+	set_playlist(m, playlist, playlist_size);
+	if (preload)
+	{
+		preload_playlist(m);
+	}
+#endif
+	free(playlist);
+	double load_ms = elapsed_ms(&launch);
+	if (first_frame_only)
+	{
+		//Startup benchmark, timed by c8startup: each figure is cumulative since main
+		present_frame(m);
+		double frame_ms = elapsed_ms(&launch);
+		printf("allegro %.2f ms, machine %.2f ms, program %.2f ms, first frame %.2f ms\n", allegro_ms, machine_ms, load_ms, frame_ms);
+		delete_machine(m);
+		end_allegro();
+		return 0;
+	}
+	if (turbo_speed >= 0)
+	{
+		set_turbo_speed(m, (uint16_t)turbo_speed);
+	}
+	if (keymap_file && !load_keymap(get_keymap(m), keymap_file))
+	{
+		fprintf(stderr, "Could not fully load keymap %s\n", keymap_file);
+	}
+	if (metrics_file && !open_metrics_file(get_metrics(m), metrics_file))
+	{
+		fprintf(stderr, "Could not write metrics to %s\n", metrics_file);
+	}
+	if (metrics_socket && !open_metrics_socket(get_metrics(m), metrics_socket))
+	{
+		fprintf(stderr, "Could not listen for metrics scrapers on %s\n", metrics_socket);
+	}
+	if (debug_script && !load_debug_script(get_debug(m), debug_script))
+	{
+		fprintf(stderr, "Could not fully load debug script %s\n", debug_script);
+	}
+	TRACE* trace = NULL;
+	if (trace_file)
+	{
+		trace = create_trace(DEFAULT_TRACE_SIZE, trace_file);
+		install_trace_crash_handler(trace);
+		set_trace(m, trace);
+	}
+	EXPORT* shared = NULL;
+	if (export_name)
+	{
+		shared = create_export(export_name, DEFAULT_EXPORT_FRAMES);
+		if (!shared)
+		{
+			fprintf(stderr, "Could not create shared memory export %s\n", export_name);
+		}
+		set_export(m, shared);
+	}
+	CAPTURE* capture = NULL;
+	if (capture_name)
+	{
+		capture = create_capture(capture_name, capture_scale);
+		if (!capture)
+		{
+			fprintf(stderr, "Could not create capture %s\n", capture_name);
+		}
+		set_capture(m, capture);
+	}
 	run_program(m);
+	report_input_latency(m, stdout);
+	if (trace)
+	{
+		flush_trace(trace);
+		set_trace(m, NULL);
+		delete_trace(trace);
+	}
 	delete_machine(m);
+	if (shared)
+	{
+		delete_export(shared);
+	}
+	if (capture)
+	{
+		uint64_t written;
+		uint64_t dropped;
+		get_capture_counts(capture, &written, &dropped);
+		if (dropped > 0)
+		{
+			fprintf(stderr, "Capture dropped %llu frames the writer could not keep up with\n", (unsigned long long)dropped);
+		}
+		delete_capture(capture);
+	}
 	end_allegro();
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,357 @@
+﻿#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "struct_capture.h"
+#include "fence.h"
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+
+#define MAX_STORED_BLOCK 65535 //deflate blocks are stored uncompressed, 1-bit rows are already small
+#define PNG_OVERHEAD 64 //signature, IHDR, IDAT and IEND framing, zlib header and checksum
+
+static const uint8_t png_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+static uint32_t crc_table[256];
+
+#ifdef _WIN32
+static DWORD WINAPI run_writer(void* argument);
+#else
+static void* run_writer(void* argument);
+#endif
+static void write_slot(CAPTURE* capture, const CAPTURE_SLOT* slot, uint64_t number);
+static void write_png(CAPTURE* capture, uint64_t number);
+static void put_chunk(CAPTURE* capture, const char* type, const uint8_t* data, uint32_t size);
+static void put_u32(uint8_t* destination, uint32_t value);
+static uint32_t update_crc(uint32_t crc, const uint8_t* data, uint32_t size);
+static void wait_briefly();
+static void free_capture(CAPTURE* capture);
+static bool is_frame_pattern(const char* name);
+
+//Frames are written as a PNG sequence when name ends in .png, with the frame number inserted before the extension
+//unless name already holds a pattern with a single frame number conversion such as "shots/%05llu.png". Names ending in .y4m give a YUV4MPEG2
+//stream and anything else raw 8-bit greyscale frames. Returns NULL if the output cannot be created or the writer
+//thread cannot be started.
+CAPTURE* create_capture(const char* name, uint8_t scale)
+{
+	CAPTURE* capture = calloc(1, sizeof(CAPTURE));
+	assert(capture);
+	capture->scale = scale < 1 ? 1 : scale > MAX_CAPTURE_SCALE ? MAX_CAPTURE_SCALE : scale;
+	capture->width = NUM_PIXEL_COLS * capture->scale;
+	capture->height = NUM_PIXEL_ROWS * capture->scale;
+	size_t length = strlen(name);
+	bool png = length >= 4 && strcmp(name + length - 4, ".png") == 0;
+	bool y4m = length >= 4 && strcmp(name + length - 4, ".y4m") == 0;
+	capture->format = png ? CAPTURE_PNG : y4m ? CAPTURE_Y4M : CAPTURE_RAW;
+	//Room for every % of the stem doubled and the frame number pattern
+	capture->name = malloc(2 * length + 16);
+	assert(capture->name);
+	if (png && !is_frame_pattern(name))
+	{
+		char* pattern = capture->name;
+		for (size_t i = 0; i < length - 4; i++)
+		{
+			if (name[i] == '%')
+			{
+				*pattern++ = '%';
+			}
+			*pattern++ = name[i];
+		}
+		strcpy(pattern, "_%06llu.png");
+	}
+	else
+	{
+		strcpy(capture->name, name);
+	}
+	if (capture->format == CAPTURE_PNG)
+	{
+		uint32_t raw_size = capture->height * (1 + capture->width / 8);
+		capture->image = malloc(raw_size);
+		capture->encoded = malloc(raw_size + 5 * (raw_size / MAX_STORED_BLOCK + 1) + PNG_OVERHEAD);
+		assert(capture->image && capture->encoded);
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t crc = i;
+			for (uint8_t bit = 0; bit < 8; bit++)
+			{
+				crc = crc & 1 ? 0xEDB88320 ^ (crc >> 1) : crc >> 1;
+			}
+			crc_table[i] = crc;
+		}
+	}
+	else
+	{
+		capture->file = fopen(name, "wb");
+		if (!capture->file)
+		{
+			free(capture->name);
+			free(capture);
+			return NULL;
+		}
+		//Room for the chroma planes after the luma plane, which stay neutral grey
+		uint32_t luma_size = capture->width * capture->height;
+		uint32_t chroma_size = capture->format == CAPTURE_Y4M ? luma_size / 2 : 0;
+		capture->image = malloc(luma_size + chroma_size);
+		assert(capture->image);
+		memset(capture->image + luma_size, 128, chroma_size);
+		if (capture->format == CAPTURE_Y4M)
+		{
+			fprintf(capture->file, "YUV4MPEG2 W%hu H%hu F%d:1 Ip A1:1 C420jpeg\n", capture->width, capture->height, CAPTURE_FRAME_RATE);
+		}
+	}
+#ifdef _WIN32
+	capture->thread = CreateThread(NULL, 0, run_writer, capture, 0, NULL);
+	bool started = capture->thread != NULL;
+#else
+	bool started = pthread_create(&capture->thread, NULL, run_writer, capture) == 0;
+#endif
+	if (!started)
+	{
+		free_capture(capture);
+		return NULL;
+	}
+	return capture;
+}
+
+//Writes out every frame still queued before returning
+void delete_capture(CAPTURE* capture)
+{
+	RELEASE_FENCE();
+	capture->quit = true;
+#ifdef _WIN32
+	WaitForSingleObject(capture->thread, INFINITE);
+	CloseHandle(capture->thread);
+#else
+	pthread_join(capture->thread, NULL);
+#endif
+	free_capture(capture);
+}
+
+//Everything but the writer thread, which is gone or was never started
+static void free_capture(CAPTURE* capture)
+{
+	if (capture->file)
+	{
+		fclose(capture->file);
+	}
+	free(capture->image);
+	free(capture->encoded);
+	free(capture->name);
+	free(capture);
+}
+
+//Called by the emulation thread for each presented frame. Only copies the screen; returns false, dropping the
+//frame, when the writer is a whole queue behind.
+bool capture_frame(CAPTURE* capture, const uint64_t* pixel_row)
+{
+	uint32_t head = capture->head;
+	if (head - capture->tail >= CAPTURE_QUEUE_FRAMES)
+	{
+		capture->dropped++;
+		return false;
+	}
+	memcpy(capture->slots[head % CAPTURE_QUEUE_FRAMES].pixel_row, pixel_row, sizeof(CAPTURE_SLOT));
+	RELEASE_FENCE();
+	capture->head = head + 1;
+	return true;
+}
+
+//Frames written so far, and frames dropped because the queue was full. Safe to call from the emulation thread.
+void get_capture_counts(const CAPTURE* capture, uint64_t* written, uint64_t* dropped)
+{
+	*written = capture->tail;
+	*dropped = capture->dropped;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI run_writer(void* argument)
+#else
+static void* run_writer(void* argument)
+#endif
+{
+	CAPTURE* capture = argument;
+	uint64_t number = 0;
+	while (true)
+	{
+		bool quit = capture->quit;
+		ACQUIRE_FENCE();
+		uint32_t tail = capture->tail;
+		if (tail == capture->head)
+		{
+			if (quit)
+			{
+				break;
+			}
+			wait_briefly();
+			continue;
+		}
+		ACQUIRE_FENCE();
+		write_slot(capture, &capture->slots[tail % CAPTURE_QUEUE_FRAMES], number++);
+		RELEASE_FENCE();
+		capture->tail = tail + 1;
+	}
+	if (capture->file)
+	{
+		fflush(capture->file);
+	}
+	return 0;
+}
+
+static void write_slot(CAPTURE* capture, const CAPTURE_SLOT* slot, uint64_t number)
+{
+	uint8_t scale = capture->scale;
+	if (capture->format == CAPTURE_PNG)
+	{
+		//1-bit scanlines, most significant bit first, each after a filter byte of 0
+		uint16_t stride = 1 + capture->width / 8;
+		for (uint16_t y = 0; y < capture->height; y++)
+		{
+			uint8_t* line = capture->image + y * stride;
+			uint64_t row = slot->pixel_row[y / scale];
+			line[0] = 0;
+			memset(line + 1, 0, stride - 1);
+			for (uint16_t x = 0; x < capture->width; x++)
+			{
+				line[1 + x / 8] |= ((row >> (NUM_PIXEL_COLS - 1 - x / scale)) & 1) << (7 - x % 8);
+			}
+		}
+		write_png(capture, number);
+		return;
+	}
+	for (uint16_t y = 0; y < capture->height; y++)
+	{
+		uint8_t* line = capture->image + y * capture->width;
+		uint64_t row = slot->pixel_row[y / scale];
+		for (uint16_t x = 0; x < capture->width; x++)
+		{
+			line[x] = (row >> (NUM_PIXEL_COLS - 1 - x / scale)) & 1 ? 235 : 16;
+		}
+	}
+	uint32_t luma_size = capture->width * capture->height;
+	if (capture->format == CAPTURE_Y4M)
+	{
+		fputs("FRAME\n", capture->file);
+		fwrite(capture->image, 1, luma_size + luma_size / 2, capture->file);
+	}
+	else
+	{
+		fwrite(capture->image, 1, luma_size, capture->file);
+	}
+}
+
+static void write_png(CAPTURE* capture, uint64_t number)
+{
+	uint32_t raw_size = capture->height * (1 + capture->width / 8);
+	memcpy(capture->encoded, png_signature, sizeof(png_signature));
+	capture->encoded_size = sizeof(png_signature);
+	uint8_t header[13] = { 0 };
+	put_u32(header, capture->width);
+	put_u32(header + 4, capture->height);
+	header[8] = 1; //bit depth
+	header[9] = 0; //greyscale
+	put_chunk(capture, "IHDR", header, sizeof(header));
+
+	//The zlib stream is built in place after the IDAT length and type, which put_chunk expects to find there
+	uint8_t* stream = capture->encoded + capture->encoded_size + 8;
+	uint32_t size = 0;
+	stream[size++] = 0x78;
+	stream[size++] = 0x01;
+	uint32_t a = 1;
+	uint32_t b = 0;
+	for (uint32_t offset = 0; offset < raw_size; offset += MAX_STORED_BLOCK)
+	{
+		uint32_t block = raw_size - offset < MAX_STORED_BLOCK ? raw_size - offset : MAX_STORED_BLOCK;
+		stream[size++] = offset + block == raw_size;
+		stream[size++] = block & 0xFF;
+		stream[size++] = block >> 8;
+		stream[size++] = ~block & 0xFF;
+		stream[size++] = (~block >> 8) & 0xFF;
+		memcpy(stream + size, capture->image + offset, block);
+		size += block;
+		for (uint32_t i = 0; i < block; i++)
+		{
+			a = (a + capture->image[offset + i]) % 65521;
+			b = (b + a) % 65521;
+		}
+	}
+	put_u32(stream + size, (b << 16) | a);
+	size += 4;
+	put_chunk(capture, "IDAT", NULL, size);
+	put_chunk(capture, "IEND", NULL, 0);
+
+	char file_name[1024];
+	snprintf(file_name, sizeof(file_name), capture->name, (unsigned long long)number);
+	FILE* file = fopen(file_name, "wb");
+	if (file)
+	{
+		fwrite(capture->encoded, 1, capture->encoded_size, file);
+		fclose(file);
+	}
+}
+
+//Appends a chunk. With data NULL its contents are already in place after the length and type.
+static void put_chunk(CAPTURE* capture, const char* type, const uint8_t* data, uint32_t size)
+{
+	uint8_t* chunk = capture->encoded + capture->encoded_size;
+	put_u32(chunk, size);
+	memcpy(chunk + 4, type, 4);
+	if (data)
+	{
+		memcpy(chunk + 8, data, size);
+	}
+	put_u32(chunk + 8 + size, update_crc(0xFFFFFFFF, chunk + 4, size + 4) ^ 0xFFFFFFFF);
+	capture->encoded_size += 12 + size;
+}
+
+static void put_u32(uint8_t* destination, uint32_t value)
+{
+	destination[0] = value >> 24;
+	destination[1] = (value >> 16) & 0xFF;
+	destination[2] = (value >> 8) & 0xFF;
+	destination[3] = value & 0xFF;
+}
+
+static uint32_t update_crc(uint32_t crc, const uint8_t* data, uint32_t size)
+{
+	for (uint32_t i = 0; i < size; i++)
+	{
+		crc = crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+//The writer polls instead of being signalled, so queueing a frame never touches a lock
+static void wait_briefly()
+{
+#ifdef _WIN32
+	Sleep(1);
+#else
+	struct timespec delay = { 0, 1000000 };
+	nanosleep(&delay, NULL);
+#endif
+}
+
+//The name becomes the format of every frame's file name, so it must hold exactly one conversion, an unsigned long
+//long with optional flags and width, besides any %%
+static bool is_frame_pattern(const char* name)
+{
+	uint8_t conversions = 0;
+	for (const char* p = strchr(name, '%'); p; p = strchr(p, '%'))
+	{
+		p++;
+		if (*p == '%')
+		{
+			p++;
+			continue;
+		}
+		p += strspn(p, "0-");
+		p += strspn(p, "0123456789");
+		if (strncmp(p, "llu", 3) != 0)
+		{
+			return false;
+		}
+		p += 3;
+		conversions++;
+	}
+	return conversions == 1;
+}
\ No newline at end of file
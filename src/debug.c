@@ -1,17 +1,38 @@
 ﻿#include <allegro5/allegro_font.h>
 #include <allegro5/allegro_ttf.h>
 #include <stdio.h>
-#include <varargs.h>
+#include <string.h>
+#include <stdarg.h>
 #include "debug.h"
 #include "struct_debug.h"
 #include "struct_machine.h"
+#include "struct_breakpoints.h"
+#include "struct_analysis.h"
+#include "opcodes.h"
+#include "disassembler.h"
+#include "assets.h"
 
 #define BOOL_STR(cond) cond ? "True" : "False" 
+#define PANE_MARGIN 8
+#define FNV_OFFSET_BASIS 0xCBF29CE484222325
+#define FNV_PRIME 0x100000001B3
 
 static void* handle_events(ALLEGRO_THREAD* thread, void* debug);
 static void handle_timer_events(DEBUG* debug, ALLEGRO_EVENT event);
 static void handle_keyboard_events(DEBUG* debug, ALLEGRO_EVENT event);
-static void draw_debug_text(DEBUG* debug);
+static void draw_debug_panes(DEBUG* debug);
+static void create_pane_bitmaps(DEBUG* debug);
+static void destroy_pane_bitmaps(DEBUG* debug);
+static void place_pane(DEBUG_PANE* pane, uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+static bool update_text_pane(DEBUG* debug, DEBUG_PANE* pane, const char* text);
+static bool update_screen_pane(DEBUG* debug, DEBUG_PANE* pane);
+static void format_registers(DEBUG* debug, char* text, size_t size);
+static void format_disassembly(DEBUG* debug, char* text, size_t size);
+static void format_stack(DEBUG* debug, char* text, size_t size);
+static void format_memory(DEBUG* debug, char* text, size_t size);
+static const char* disassemble_at(DEBUG* debug, uint16_t address);
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t size);
+static void prepare_debug_window(DEBUG* debug);
 
 
 static DEBUG_SETTINGS create_default_debug_settings()
@@ -19,7 +40,7 @@ static DEBUG_SETTINGS create_default_debug_settings()
 	DEBUG_SETTINGS debug_settings;
 	debug_settings.font_size = 12;
 	debug_settings.text_color = al_map_rgb(255, 255, 255);
-	debug_settings.text_font = al_load_ttf_font("resources/UbuntuMono[wght].ttf", 18, 0);
+	debug_settings.text_font = NULL;
 	debug_settings.keys[DEBUG_STEP_BY_STEP] = ALLEGRO_KEY_K;
 	debug_settings.keys[DEBUG_NEXT_STEP] = ALLEGRO_KEY_L;
 	debug_settings.options[DEBUG_STEP_BY_STEP] = false;
@@ -35,31 +56,90 @@ DEBUG* create_debug(MACHINE* machine)
 	debug->on = false;
 	debug->settings = create_default_debug_settings();
 	debug->machine = machine;
+	machine->debug_hook = debug_allows_step;
+	debug->breakpoints = create_breakpoints();
+	debug->last_break = BREAK_NONE;
+	debug->event_mutex = al_create_mutex();
+	return debug;
+}
+
+//Font, timer and queue are only needed once the window is first opened, which most runs never do
+static void prepare_debug_window(DEBUG* debug)
+{
+	al_init_font_addon();
+	al_init_ttf_addon();
+	ALLEGRO_FILE* file = open_asset(FONT_ASSET);
+	if (file)
+	{
+		debug->settings.text_font = al_load_ttf_font_f(file, FONT_ASSET, 18, 0);
+	}
+	if (!debug->settings.text_font)
+	{
+		debug->settings.text_font = al_create_builtin_font();
+	}
+	assert(debug->settings.text_font);
 	debug->refresh_timer = al_create_timer(1 / 30.0);
 	assert(debug->refresh_timer);
-	al_start_timer(debug->refresh_timer);
 	debug->event_queue = al_create_event_queue();
 	assert(debug->event_queue);
-	debug->event_mutex = al_create_mutex();
 	al_register_event_source(debug->event_queue, al_get_keyboard_event_source());
 	al_register_event_source(debug->event_queue, al_get_timer_event_source(debug->refresh_timer));
-	return debug;
+	debug->disassembly = calloc(RAM_SIZE, sizeof(DISASSEMBLY_LINE));
+	assert(debug->disassembly);
+
+	//Registers, disassembly and stack side by side, with memory and the zoomed screen below
+	uint16_t line = al_get_font_line_height(debug->settings.text_font) + 2;
+	uint16_t column = al_get_text_width(debug->settings.text_font, "0");
+	DEBUG_PANE* panes = debug->panes;
+	place_pane(&panes[PANE_REGISTERS], 0, 0, 28 * column, 20 * line);
+	place_pane(&panes[PANE_DISASSEMBLY], panes[PANE_REGISTERS].x + panes[PANE_REGISTERS].width, 0, 26 * column, (DISASSEMBLY_LINES + 1) * line);
+	place_pane(&panes[PANE_STACK], panes[PANE_DISASSEMBLY].x + panes[PANE_DISASSEMBLY].width, 0, 14 * column, (STACK_DEPTH + 1) * line);
+	uint16_t top_height = panes[PANE_DISASSEMBLY].height > panes[PANE_REGISTERS].height ? panes[PANE_DISASSEMBLY].height : panes[PANE_REGISTERS].height;
+	place_pane(&panes[PANE_MEMORY], 0, top_height, (5 + 3 * MEMORY_PANE_COLUMNS) * column, (MEMORY_PANE_ROWS + 1) * line);
+	place_pane(&panes[PANE_SCREEN], panes[PANE_MEMORY].width, top_height, NUM_PIXEL_COLS * SCREEN_PANE_ZOOM, NUM_PIXEL_ROWS * SCREEN_PANE_ZOOM);
+	uint16_t bottom_height = panes[PANE_MEMORY].height > panes[PANE_SCREEN].height ? panes[PANE_MEMORY].height : panes[PANE_SCREEN].height;
+	uint16_t top_width = panes[PANE_STACK].x + panes[PANE_STACK].width;
+	uint16_t bottom_width = panes[PANE_SCREEN].x + panes[PANE_SCREEN].width;
+	debug->settings.display_width = (top_width > bottom_width ? top_width : bottom_width) + PANE_MARGIN;
+	debug->settings.display_height = top_height + bottom_height + PANE_MARGIN;
+}
+
+static void place_pane(DEBUG_PANE* pane, uint16_t x, uint16_t y, uint16_t width, uint16_t height)
+{
+	pane->x = x + PANE_MARGIN;
+	pane->y = y + PANE_MARGIN;
+	pane->width = width;
+	pane->height = height;
 }
 
 void delete_debug(DEBUG* debug)
 {
+	al_lock_mutex(debug->event_mutex);
+	end_debug_thread(debug);
+	al_unlock_mutex(debug->event_mutex);
 	al_destroy_mutex(debug->event_mutex);
-	al_destroy_event_queue(debug->event_queue);
-	al_destroy_display(debug->display);
+	if (debug->event_queue)
+	{
+		al_destroy_event_queue(debug->event_queue);
+		al_destroy_timer(debug->refresh_timer);
+		al_destroy_font(debug->settings.text_font);
+		free(debug->disassembly);
+	}
+	if (debug->display)
+	{
+		al_destroy_display(debug->display);
+	}
+	delete_breakpoints(debug->breakpoints);
+	free(debug);
 }
 
-static void* handle_events(void* debug)
+static void* handle_events(ALLEGRO_THREAD* thread, void* debug)
 {
 	DEBUG* dbg = debug;
-	dbg->on = true;
 	dbg->display = al_create_display(dbg->settings.display_width, dbg->settings.display_height);
 	assert(dbg->display);
 	al_set_window_title(dbg->display, "C8 DEBUG");
+	create_pane_bitmaps(dbg);
 	ALLEGRO_EVENT event;
 	while (dbg->on)
 	{
@@ -69,7 +149,11 @@ static void* handle_events(void* debug)
 		handle_keyboard_events(debug, event);
 		al_unlock_mutex(dbg->event_mutex);
 	}
+	al_stop_timer(dbg->refresh_timer);
+	destroy_pane_bitmaps(dbg);
 	al_destroy_display(dbg->display);
+	dbg->display = NULL;
+	return NULL;
 }
 
 static void handle_timer_events(DEBUG* debug, ALLEGRO_EVENT event)
@@ -80,7 +164,7 @@ static void handle_timer_events(DEBUG* debug, ALLEGRO_EVENT event)
 	}
 	if (event.timer.source == debug->refresh_timer)
 	{
-		draw_debug_text(debug);
+		draw_debug_panes(debug);
 	}
 }
 
@@ -101,31 +185,232 @@ static void handle_keyboard_events(DEBUG* debug, ALLEGRO_EVENT event)
 
 void start_debug_thread(DEBUG* debug)
 {
-	al_run_detached_thread(handle_events, debug);
+	if (debug->on)
+	{
+		return;
+	}
+	if (!debug->event_queue)
+	{
+		prepare_debug_window(debug);
+	}
+	al_flush_event_queue(debug->event_queue);
+	al_start_timer(debug->refresh_timer);
+	debug->on = true;
+	update_debug_hooks(debug);
+	debug->thread = al_create_thread(handle_events, debug);
+	assert(debug->thread);
+	al_start_thread(debug->thread);
 }
 
+//Called with event_mutex held, like everything the frontend does between events. The window thread needs the mutex
+//to finish the event it woke up for, so it is released while waiting for the thread, which notices on the next
+//refresh tick that it was stopped.
 void end_debug_thread(DEBUG* debug)
 {
 	debug->on = false;
+	update_debug_hooks(debug);
+	if (!debug->thread)
+	{
+		return;
+	}
+	al_unlock_mutex(debug->event_mutex);
+	al_join_thread(debug->thread, NULL);
+	al_lock_mutex(debug->event_mutex);
+	al_destroy_thread(debug->thread);
+	debug->thread = NULL;
+}
+
+void update_debug_hooks(DEBUG* debug)
+{
+	debug->machine->hooks_armed = debug->on || breakpoints_armed(debug->breakpoints);
+	update_step_function(debug->machine);
 }
 
-static void draw_debug_text(DEBUG* debug)
+bool debug_allows_step(DEBUG* debug, uint16_t opcode)
 {
 	MACHINE* machine = debug->machine;
-	char asm_text[32] = "";
-	opcode_to_string(asm_text, machine->current_opcode);
+	bool* options = debug->settings.options;
+	if (debug->on && options[DEBUG_STEP_BY_STEP])
+	{
+		if (!options[DEBUG_NEXT_STEP])
+		{
+			return false;
+		}
+		options[DEBUG_NEXT_STEP] = false;
+	}
+	else if (!debug->skip_breakpoints_once && !machine->waiting_for_input)
+	{
+		BREAK_REASON reason = check_breakpoints(debug->breakpoints, machine, opcode);
+		if (reason != BREAK_NONE)
+		{
+			debug->last_break = reason;
+			debug->last_break_address = machine->pc_reg;
+			debug->skip_breakpoints_once = true;
+			options[DEBUG_STEP_BY_STEP] = true;
+			options[DEBUG_NEXT_STEP] = false;
+			start_debug_thread(debug);
+			return false;
+		}
+	}
+	debug->skip_breakpoints_once = false;
+	return true;
+}
+
+BREAKPOINTS* get_breakpoints(DEBUG* debug)
+{
+	return debug->breakpoints;
+}
+
+//Each line is one of "break <address>", "watch <address> [length]" or "cond <expression>", with hexadecimal numbers
+bool load_debug_script(DEBUG* debug, const char* file_name)
+{
+	FILE* file = fopen(file_name, "r");
+	if (!file)
+	{
+		return false;
+	}
+	bool success = true;
+	char line[128];
+	while (fgets(line, sizeof(line), file))
+	{
+		unsigned int address;
+		unsigned int length = 1;
+		line[strcspn(line, "\r\n")] = '\0';
+		if (sscanf(line, "break %x", &address) == 1)
+		{
+			add_breakpoint(debug->breakpoints, address);
+		}
+		else if (sscanf(line, "watch %x %x", &address, &length) >= 1)
+		{
+			add_watchpoint(debug->breakpoints, address, length);
+		}
+		else if (strncmp(line, "cond ", 5) == 0)
+		{
+			success &= add_condition(debug->breakpoints, line + 5);
+		}
+		else if (line[0] != '\0' && line[0] != '#')
+		{
+			success = false;
+		}
+	}
+	fclose(file);
+	update_debug_hooks(debug);
+	return success;
+}
+
+//Panes are re-rendered only when what they show changed, and the window is only redrawn and flipped if one was.
+//A paused machine costs formatting a few lines of text per refresh.
+static void draw_debug_panes(DEBUG* debug)
+{
+	char text[DEBUG_PANE_TEXT_SIZE];
+	bool changed = false;
+	format_registers(debug, text, sizeof(text));
+	changed |= update_text_pane(debug, &debug->panes[PANE_REGISTERS], text);
+	format_disassembly(debug, text, sizeof(text));
+	changed |= update_text_pane(debug, &debug->panes[PANE_DISASSEMBLY], text);
+	format_stack(debug, text, sizeof(text));
+	changed |= update_text_pane(debug, &debug->panes[PANE_STACK], text);
+	format_memory(debug, text, sizeof(text));
+	changed |= update_text_pane(debug, &debug->panes[PANE_MEMORY], text);
+	changed |= update_screen_pane(debug, &debug->panes[PANE_SCREEN]);
+	if (!changed)
+	{
+		return;
+	}
 	al_set_target_backbuffer(debug->display);
 	al_clear_to_color(al_map_rgb(0, 0, 0));
-	al_draw_multiline_textf(debug->settings.text_font,
-		debug->settings.text_color,
-		0,
-		0, 
-		al_get_display_width(debug->display),
-		al_get_font_line_height(debug->settings.text_font) + 10,
-		0,
-		"DEBUG WINDOW\n"
+	for (uint8_t i = 0; i < NUM_DEBUG_PANES; i++)
+	{
+		DEBUG_PANE* pane = &debug->panes[i];
+		if (pane->bitmap)
+		{
+			al_draw_bitmap(pane->bitmap, pane->x, pane->y, 0);
+		}
+	}
+	al_flip_display();
+}
+
+//Created by the debug thread once its display exists, so they are video bitmaps of that display
+static void create_pane_bitmaps(DEBUG* debug)
+{
+	for (uint8_t i = 0; i < NUM_DEBUG_PANES; i++)
+	{
+		DEBUG_PANE* pane = &debug->panes[i];
+		pane->bitmap = al_create_bitmap(pane->width, pane->height);
+		pane->drawn = false;
+	}
+}
+
+static void destroy_pane_bitmaps(DEBUG* debug)
+{
+	for (uint8_t i = 0; i < NUM_DEBUG_PANES; i++)
+	{
+		al_destroy_bitmap(debug->panes[i].bitmap);
+		debug->panes[i].bitmap = NULL;
+	}
+}
+
+static bool update_text_pane(DEBUG* debug, DEBUG_PANE* pane, const char* text)
+{
+	uint64_t hash = hash_bytes(FNV_OFFSET_BASIS, text, strlen(text));
+	if (!pane->bitmap || (pane->drawn && hash == pane->hash))
+	{
+		return false;
+	}
+	pane->hash = hash;
+	pane->drawn = true;
+	al_set_target_bitmap(pane->bitmap);
+	al_clear_to_color(al_map_rgb(0, 0, 0));
+	al_draw_multiline_text(debug->settings.text_font, debug->settings.text_color, 0, 0, pane->width,
+		al_get_font_line_height(debug->settings.text_font) + 2, 0, text);
+	return true;
+}
+
+static bool update_screen_pane(DEBUG* debug, DEBUG_PANE* pane)
+{
+	const uint64_t* pixel_row = debug->machine->pixel_row;
+	uint64_t hash = hash_bytes(FNV_OFFSET_BASIS, pixel_row, NUM_PIXEL_ROWS * sizeof(uint64_t));
+	if (!pane->bitmap || (pane->drawn && hash == pane->hash))
+	{
+		return false;
+	}
+	ALLEGRO_LOCKED_REGION* region = al_lock_bitmap(pane->bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_WRITEONLY);
+	if (!region)
+	{
+		return false;
+	}
+	pane->hash = hash;
+	pane->drawn = true;
+	for (uint16_t y = 0; y < pane->height; y++)
+	{
+		uint32_t* texel = (uint32_t*)((uint8_t*)region->data + y * region->pitch);
+		uint64_t row = pixel_row[y / SCREEN_PANE_ZOOM];
+		for (uint16_t x = 0; x < pane->width; x++)
+		{
+			//Grid lines between pixels, so single pixels can be counted
+			bool grid = x % SCREEN_PANE_ZOOM == 0 || y % SCREEN_PANE_ZOOM == 0;
+			bool lit = (row >> (NUM_PIXEL_COLS - 1 - x / SCREEN_PANE_ZOOM)) & 1;
+			texel[x] = lit ? 0xFFFFFFFF : grid ? 0xFF202020 : 0xFF000000;
+		}
+	}
+	al_unlock_bitmap(pane->bitmap);
+	return true;
+}
+
+static void format_registers(DEBUG* debug, char* text, size_t size)
+{
+	MACHINE* machine = debug->machine;
+	char block_text[32] = "None";
+	const BASIC_BLOCK* block = machine->analysis ? find_block(machine->analysis, machine->pc_reg) : NULL;
+	if (block)
+	{
+		snprintf(block_text, sizeof(block_text), "%03hX-%03hX%s", block->start, block->end - 1,
+			(machine->analysis->flags[block->start] & ADDRESS_IDLE_LOOP) ? " (idle)" : "");
+	}
+	snprintf(text, size,
 		"STEP BY STEP: %s\n"
 		"OPCODE: %s\n"
+		"BLOCK: %s\n"
 		"PC: %04hX I: %04hX S: %04hX\n"
 		"DT: %02hhX ST: %02hhX\n"
 		"V0: %02hhX V1: %02hhX V2: %02hhX V3: %02hhX\n"
@@ -133,16 +418,96 @@ static void draw_debug_text(DEBUG* debug)
 		"V8: %02hhX V9: %02hhX VA: %02hhX VB: %02hhX\n"
 		"VC: %02hhX VD: %02hhX VE: %02hhX VF: %02hhX\n"
 		"Waiting for input: %s\n"
-		"Input received: %s",
+		"Input received: %s\n"
+		"Last break: %s (%03hX)\n"
+		"Fault: %s\n"
+		"OOB: %u\n"
+		"BP: %hu WP: %hu COND: %hhu",
 		BOOL_STR(debug->settings.options[DEBUG_STEP_BY_STEP]),
-		asm_text,
+		disassemble_at(debug, machine->pc_reg),
+		block_text,
 		machine->pc_reg, machine->i_reg, machine->s_reg,
 		machine->d_counter, machine->s_counter,
 		machine->v_reg[0], machine->v_reg[1], machine->v_reg[2], machine->v_reg[3],
 		machine->v_reg[4], machine->v_reg[5], machine->v_reg[6], machine->v_reg[7],
 		machine->v_reg[8], machine->v_reg[9], machine->v_reg[10], machine->v_reg[11],
 		machine->v_reg[12], machine->v_reg[13], machine->v_reg[14], machine->v_reg[15],
-		BOOL_STR(debug->machine->waiting_for_input),
-		BOOL_STR(debug->machine->input_received));
-	al_flip_display();
+		BOOL_STR(machine->waiting_for_input),
+		BOOL_STR(machine->input_received),
+		break_reason_to_string(debug->last_break), debug->last_break_address,
+		fault_to_string(machine->fault),
+		machine->out_of_bounds,
+		debug->breakpoints->num_breakpoints, debug->breakpoints->num_watchpoints, debug->breakpoints->num_conditions);
+}
+
+//Instructions around PC, marked > for PC and * for breakpoints. Addresses step by 2 from PC, so code that is not
+//aligned with it shows as data.
+static void format_disassembly(DEBUG* debug, char* text, size_t size)
+{
+	uint16_t pc = debug->machine->pc_reg;
+	int32_t first = (int32_t)pc - (DISASSEMBLY_LINES / 2) * MEM_STEP;
+	size_t length = snprintf(text, size, "DISASSEMBLY\n");
+	for (uint8_t i = 0; i < DISASSEMBLY_LINES && length < size; i++)
+	{
+		uint16_t address = MASK_ADDRESS(first + i * MEM_STEP);
+		length += snprintf(text + length, size - length, "%c%c%03hX %s\n", address == pc ? '>' : ' ',
+			has_breakpoint(debug->breakpoints, address) ? '*' : ' ', address, disassemble_at(debug, address));
+	}
+}
+
+//Return addresses, innermost first
+static void format_stack(DEBUG* debug, char* text, size_t size)
+{
+	MACHINE* machine = debug->machine;
+	size_t length = snprintf(text, size, "STACK\n");
+	for (int32_t i = (int32_t)machine->s_reg - 1; i >= 0 && i < STACK_DEPTH && length < size; i--)
+	{
+		length += snprintf(text + length, size - length, "%2d: %03hX\n", i, machine->stack[i]);
+	}
+}
+
+static void format_memory(DEBUG* debug, char* text, size_t size)
+{
+	MACHINE* machine = debug->machine;
+	size_t length = snprintf(text, size, "MEMORY AT I\n");
+	for (uint8_t row = 0; row < MEMORY_PANE_ROWS && length < size; row++)
+	{
+		uint16_t address = MASK_ADDRESS(machine->i_reg + row * MEMORY_PANE_COLUMNS);
+		length += snprintf(text + length, size - length, "%03hX:", address);
+		for (uint8_t column = 0; column < MEMORY_PANE_COLUMNS && length < size; column++)
+		{
+			length += snprintf(text + length, size - length, " %02hhX", *RAM_AT(machine, address + column));
+		}
+		if (length < size)
+		{
+			length += snprintf(text + length, size - length, "\n");
+		}
+	}
+}
+
+//Cached per address. An entry is checked against RAM on every use, so writes to code, including self-modifying
+//code, are picked up without the core having to report them.
+static const char* disassemble_at(DEBUG* debug, uint16_t address)
+{
+	uint8_t* memory = RAM_AT(debug->machine, address);
+	uint16_t opcode = (memory[0] << 8) | memory[1];
+	DISASSEMBLY_LINE* line = &debug->disassembly[MASK_ADDRESS(address)];
+	if (!line->valid || line->opcode != opcode)
+	{
+		snprintf(line->text, sizeof(line->text), "%04hX ", opcode);
+		opcode_to_string(line->text + 5, opcode);
+		line->opcode = opcode;
+		line->valid = true;
+	}
+	return line->text;
+}
+
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t size)
+{
+	const uint8_t* bytes = data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash = (hash ^ bytes[i]) * FNV_PRIME;
+	}
+	return hash;
 }
\ No newline at end of file
@@ -0,0 +1,141 @@
+﻿#include <stdio.h>
+#include "disassembler.h"
+#include "struct_machine.h"
+
+void opcode_to_string(char* buffer, uint16_t opcode)
+{
+	const uint8_t buffer_length = 32;
+	uint8_t type = GET_TYPE(opcode);
+	uint8_t x = GET_X(opcode);
+	uint8_t y = GET_Y(opcode);
+	uint16_t nnn = GET_NNN(opcode);
+	uint8_t nn = GET_NN(opcode);
+	uint8_t n = GET_N(opcode);
+	switch (type)
+	{
+	case 0x0:
+		if (nn == 0xE0)
+		{
+			snprintf(buffer, buffer_length, "CLR");
+			return;
+		}
+		else if (nn == 0xEE)
+		{
+			snprintf(buffer, buffer_length, "RET");
+			return;
+		}
+		break;
+	case 0x1:
+		snprintf(buffer, buffer_length, "JMP %03hX", nnn);
+		return;
+	case 0x2:
+		snprintf(buffer, buffer_length, "CALL %03hX", nnn);
+		return;
+	case 0x3:
+		snprintf(buffer, buffer_length, "NEQ V%hhX, %02hhX", x, nn);
+		return;
+	case 0x4:
+		snprintf(buffer, buffer_length, "EQ V%hhX, %02hhX", x, nn);
+		return;
+	case 0x5:
+		snprintf(buffer, buffer_length, "NEQ V%hhX, V%hhX", x, y);
+		return;
+	case 0x6:
+		snprintf(buffer, buffer_length, "MOV V%hhX, %02hhX", x, nn);
+		return;
+	case 0x7:
+		snprintf(buffer, buffer_length, "ADD V%hhX, %02hhX", x, nn);
+		return;
+	case 0x8:
+		switch (n)
+		{
+		case 0x0:
+			snprintf(buffer, buffer_length, "MOV V%hhX, V%hhX", x, y);
+			return;
+		case 0x1:
+			snprintf(buffer, buffer_length, "OR V%hhX, V%hhX", x, y);
+			return;
+		case 0x2:
+			snprintf(buffer, buffer_length, "AND V%hhX, V%hhX", x, y);
+			return;
+		case 0x3:
+			snprintf(buffer, buffer_length, "XOR V%hhX, V%hhX", x, y);
+			return;
+		case 0x4:
+			snprintf(buffer, buffer_length, "ADD V%hhX, V%hhX", x, y);
+			return;
+		case 0x5:
+			snprintf(buffer, buffer_length, "SUB V%hhX, V%hhX", x, y);
+			return;
+		case 0x6:
+			snprintf(buffer, buffer_length, "SHR V%hhX, V%hhX", x, y);
+			return;
+		case 0x7:
+			snprintf(buffer, buffer_length, "DIFF V%hhX, V%hhX", x, y);
+			return;
+		case 0xE:
+			snprintf(buffer, buffer_length, "SHL V%hhX, V%hhX", x, y);
+			return;
+		}
+		break;
+	case 0x9:
+		snprintf(buffer, buffer_length, "EQ V%hhX, V%hhX", x, y);
+		return;
+	case 0xA:
+		snprintf(buffer, buffer_length, "MOV I, %03hX", nnn);
+		return;
+	case 0xB:
+		snprintf(buffer, buffer_length, "JMP0 %03hX", nnn);
+		return;
+	case 0xC:
+		snprintf(buffer, buffer_length, "RND V%hhX %02hhX", x, nn);
+		return;
+	case 0xD:
+		snprintf(buffer, buffer_length, "DRAW V%hhX, V%hhX, %hhX", x, y, n);
+		return;
+	case 0xE:
+		if (nn == 0x9E)
+		{
+			snprintf(buffer, buffer_length, "NKEY V%hhX", x);
+			return;
+		}
+		else if (nn == 0xA1)
+		{
+			snprintf(buffer, buffer_length, "KEY V%hhX", x);
+			return;
+		}
+		break;
+	case 0xF:
+		switch (nn)
+		{
+		case 0x07:
+			snprintf(buffer, buffer_length, "MOV V%hhX, DT", x);
+			return;
+		case 0x0A:
+			snprintf(buffer, buffer_length, "WAIT V%hhX", x);
+			return;
+		case 0x15:
+			snprintf(buffer, buffer_length, "MOV DT, V%hhX", x);
+			return;
+		case 0x18:
+			snprintf(buffer, buffer_length, "MOV ST, V%hhX", x);
+			return;
+		case 0x1E:
+			snprintf(buffer, buffer_length, "ADD I, V%hhX", x);
+			return;
+		case 0x29:
+			snprintf(buffer, buffer_length, "MOV I, CHAR[V%hhX]", x);
+			return;
+		case 0x33:
+			snprintf(buffer, buffer_length, "BCD V%hhX", x);
+			return;
+		case 0x55:
+			snprintf(buffer, buffer_length, "STO %hhX", x);
+			return;
+		case 0x65:
+			snprintf(buffer, buffer_length, "LD %hhX", x);
+			return;
+		}
+	}
+	snprintf(buffer, buffer_length, "??? (%04hX)", opcode);
+}
\ No newline at end of file
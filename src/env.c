@@ -0,0 +1,157 @@
+﻿#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "struct_env.h"
+#include "machine.h"
+
+static void restart_env(ENV* env, uint16_t index, uint32_t seed);
+static void step_one_env(void* context, uint16_t index);
+static uint16_t read_score(const ENV* env, const MACHINE* machine);
+static void observe(ENV* env, uint16_t index);
+
+ENV* create_env(const ENV_OPTIONS* options)
+{
+	assert(options->num_envs > 0);
+	ENV* env = calloc(1, sizeof(ENV));
+	assert(env);
+	env->options = *options;
+	if (env->options.frame_skip == 0)
+	{
+		env->options.frame_skip = DEFAULT_ENV_FRAME_SKIP;
+	}
+	if (env->options.ticks_per_frame == 0)
+	{
+		env->options.ticks_per_frame = DEFAULT_ENV_TICKS_PER_FRAME;
+	}
+	uint16_t num_envs = options->num_envs;
+	env->initial = create_headless_machine();
+	load_program_data(env->initial, "env", options->program, options->program_size);
+	env->machines = calloc(num_envs, sizeof(MACHINE*));
+	assert(env->machines);
+	for (uint16_t i = 0; i < num_envs; i++)
+	{
+		env->machines[i] = create_headless_machine();
+		load_program_data(env->machines[i], "env", options->program, options->program_size);
+	}
+	env->batch.observation_size = options->observation == ENV_OBSERVATION_PACKED ? sizeof(uint64_t) * NUM_PIXEL_ROWS : NUM_PIXEL_ROWS * NUM_PIXEL_COLS;
+	env->observations = calloc(num_envs, env->batch.observation_size);
+	env->rewards = calloc(num_envs, sizeof(float));
+	env->dones = calloc(num_envs, sizeof(bool));
+	assert(env->observations && env->rewards && env->dones);
+	env->batch.observations = env->observations;
+	env->batch.rewards = env->rewards;
+	env->batch.dones = env->dones;
+	for (uint16_t i = 0; i < 256; i++)
+	{
+		uint8_t pixels[8];
+		for (uint8_t bit = 0; bit < 8; bit++)
+		{
+			pixels[bit] = (i >> (7 - bit)) & 1;
+		}
+		memcpy(&env->unpacked_bytes[i], pixels, sizeof(pixels));
+	}
+	env->pool = create_pool(options->num_threads);
+	return env;
+}
+
+void delete_env(ENV* env)
+{
+	delete_pool(env->pool);
+	for (uint16_t i = 0; i < env->options.num_envs; i++)
+	{
+		delete_machine(env->machines[i]);
+	}
+	delete_machine(env->initial);
+	free(env->machines);
+	free(env->observations);
+	free(env->rewards);
+	free(env->dones);
+	free(env);
+}
+
+//Restarts every environment, seeding the random number generator of environment i with seeds[i], or i + 1 if
+//seeds is NULL
+const ENV_BATCH* reset_env(ENV* env, const uint32_t* seeds)
+{
+	for (uint16_t i = 0; i < env->options.num_envs; i++)
+	{
+		restart_env(env, i, seeds ? seeds[i] : i + 1u);
+		env->rewards[i] = 0;
+		env->dones[i] = false;
+		observe(env, i);
+	}
+	return &env->batch;
+}
+
+//Holds actions[i], a keypad mask with bit k set for key k, on environment i for frame_skip frames
+const ENV_BATCH* step_env(ENV* env, const uint16_t* actions)
+{
+	env->actions = actions;
+	run_pool(env->pool, step_one_env, env, env->options.num_envs);
+	return &env->batch;
+}
+
+static void restart_env(ENV* env, uint16_t index, uint32_t seed)
+{
+	copy_machine(env->machines[index], env->initial);
+	seed_machine(env->machines[index], seed);
+}
+
+static void step_one_env(void* context, uint16_t index)
+{
+	ENV* env = context;
+	MACHINE* machine = env->machines[index];
+	if (env->dones[index])
+	{
+		restart_env(env, index, machine->random_state);
+	}
+	press_keypad(machine, env->actions[index]);
+	uint16_t score = read_score(env, machine);
+	for (uint8_t frame = 0; frame < env->options.frame_skip && machine->fault == FAULT_NONE; frame++)
+	{
+		for (uint16_t tick = 0; tick < env->options.ticks_per_frame; tick++)
+		{
+			machine->step(machine);
+		}
+		machine->d_counter -= machine->d_counter > 0;
+		machine->s_counter -= machine->s_counter > 0;
+	}
+	env->rewards[index] = (float)((int32_t)read_score(env, machine) - score);
+	env->dones[index] = machine->fault != FAULT_NONE;
+	observe(env, index);
+}
+
+static uint16_t read_score(const ENV* env, const MACHINE* machine)
+{
+	const uint8_t* score = RAM_AT(machine, env->options.score_address);
+	switch (env->options.score_format)
+	{
+	case ENV_SCORE_BYTE:
+		return score[0];
+	case ENV_SCORE_WORD:
+		return (score[0] << 8) | score[1];
+	case ENV_SCORE_BCD:
+		return score[0] * 100 + score[1] * 10 + score[2];
+	default:
+		return 0;
+	}
+}
+
+static void observe(ENV* env, uint16_t index)
+{
+	const MACHINE* machine = env->machines[index];
+	uint8_t* observation = env->observations + index * env->batch.observation_size;
+	if (env->options.observation == ENV_OBSERVATION_PACKED)
+	{
+		memcpy(observation, machine->pixel_row, sizeof(machine->pixel_row));
+		return;
+	}
+	for (uint8_t y = 0; y < NUM_PIXEL_ROWS; y++)
+	{
+		uint64_t row = machine->pixel_row[y];
+		for (int8_t shift = NUM_PIXEL_COLS - 8; shift >= 0; shift -= 8, observation += 8)
+		{
+			memcpy(observation, &env->unpacked_bytes[(row >> shift) & 0xFF], 8);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,189 @@
+﻿#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "struct_export.h"
+#include "fence.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static EXPORT* map_export(const char* name, size_t size, bool create);
+
+//Creates the named region, e.g. "/c8", that publish_frame fills. Returns NULL when it cannot be created.
+EXPORT* create_export(const char* name, uint16_t num_frames)
+{
+	assert(num_frames > 0);
+	EXPORT* shared = map_export(name, sizeof(EXPORT_REGION) + num_frames * sizeof(EXPORT_FRAME), true);
+	if (!shared)
+	{
+		return NULL;
+	}
+	memset(shared->region, 0, shared->size);
+	shared->region->version = EXPORT_VERSION;
+	shared->region->num_frames = num_frames;
+	shared->region->frame_size = sizeof(EXPORT_FRAME);
+	RELEASE_FENCE();
+	shared->region->magic = EXPORT_MAGIC;
+	return shared;
+}
+
+//Maps a region created by another process. Returns NULL when it does not exist or has another layout.
+EXPORT* open_export(const char* name)
+{
+	EXPORT* shared = map_export(name, sizeof(EXPORT_REGION), false);
+	if (!shared)
+	{
+		return NULL;
+	}
+	EXPORT_REGION header = *shared->region;
+	ACQUIRE_FENCE();
+	bool valid = header.magic == EXPORT_MAGIC && header.version == EXPORT_VERSION && header.frame_size == sizeof(EXPORT_FRAME);
+	delete_export(shared);
+	return valid ? map_export(name, sizeof(EXPORT_REGION) + header.num_frames * sizeof(EXPORT_FRAME), false) : NULL;
+}
+
+void delete_export(EXPORT* shared)
+{
+#ifdef _WIN32
+	UnmapViewOfFile(shared->region);
+	CloseHandle(shared->mapping);
+#else
+	munmap(shared->region, shared->size);
+	if (shared->owner)
+	{
+		shm_unlink(shared->name);
+	}
+#endif
+	free(shared->name);
+	free(shared);
+}
+
+//Called once per frame. Copies the screen and registers into the oldest slot, which consumers then read in place.
+void publish_frame(EXPORT* shared, const MACHINE* machine)
+{
+	EXPORT_REGION* region = shared->region;
+	uint32_t slot_index = (uint32_t)(++shared->frames_published % region->num_frames);
+	EXPORT_FRAME* slot = &region->frames[slot_index];
+	uint32_t sequence = slot->sequence;
+	slot->sequence = sequence + 1;
+	RELEASE_FENCE();
+	slot->frame = shared->frames_published;
+	memcpy(slot->pixel_row, machine->pixel_row, sizeof(slot->pixel_row));
+	memcpy(slot->v_reg, machine->v_reg, sizeof(slot->v_reg));
+	memcpy(slot->stack, machine->stack, sizeof(slot->stack));
+	slot->pc_reg = machine->pc_reg;
+	slot->i_reg = machine->i_reg;
+	slot->s_reg = machine->s_reg;
+	slot->current_opcode = machine->current_opcode;
+	slot->d_counter = machine->d_counter;
+	slot->s_counter = machine->s_counter;
+	slot->fault = machine->fault;
+	slot->waiting_for_input = machine->waiting_for_input;
+	RELEASE_FENCE();
+	slot->sequence = sequence + 2;
+	RELEASE_FENCE();
+	region->latest_slot = slot_index;
+}
+
+//Copies the keypad a consumer injected into the machine. Returns false while no consumer has taken over the
+//keypad, in which case the keyboard stays in charge.
+bool apply_exported_keypad(EXPORT* shared, MACHINE* machine)
+{
+	EXPORT_REGION* region = shared->region;
+	if (!region->keypad_owner)
+	{
+		shared->last_keypad = 0;
+		return false;
+	}
+	uint16_t keypad = (uint16_t)region->keypad;
+	if (keypad == shared->last_keypad)
+	{
+		return true;
+	}
+	for (uint8_t i = 0; i < KEYPAD_SIZE; i++)
+	{
+		machine->key_pressed[i] = (keypad >> i) & 1;
+	}
+	if (machine->waiting_for_input && (keypad & ~shared->last_keypad))
+	{
+		machine->input_received = true;
+	}
+	shared->last_keypad = keypad;
+	return true;
+}
+
+//Returns the newest frame without copying it. Its contents are only valid if end_frame_read then succeeds.
+const EXPORT_FRAME* begin_frame_read(const EXPORT* shared, uint32_t* sequence)
+{
+	const EXPORT_FRAME* frame = &shared->region->frames[shared->region->latest_slot % shared->region->num_frames];
+	*sequence = frame->sequence;
+	ACQUIRE_FENCE();
+	return frame;
+}
+
+bool end_frame_read(const EXPORT_FRAME* frame, uint32_t sequence)
+{
+	ACQUIRE_FENCE();
+	return sequence % 2 == 0 && frame->sequence == sequence && frame->frame != 0;
+}
+
+//With take_over set the machine ignores its keyboard and holds exactly the keys set in keys, bit i for key i
+void inject_keypad(EXPORT* shared, bool take_over, uint16_t keys)
+{
+	shared->region->keypad = keys;
+	RELEASE_FENCE();
+	shared->region->keypad_owner = take_over;
+}
+
+static EXPORT* map_export(const char* name, size_t size, bool create)
+{
+	EXPORT* shared = calloc(1, sizeof(EXPORT));
+	assert(shared);
+	shared->name = malloc(strlen(name) + 1);
+	assert(shared->name);
+	strcpy(shared->name, name);
+	shared->size = size;
+	shared->owner = create;
+#ifdef _WIN32
+	if (create)
+	{
+		shared->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)size, name);
+	}
+	else
+	{
+		shared->mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+	}
+	shared->region = shared->mapping ? MapViewOfFile(shared->mapping, FILE_MAP_ALL_ACCESS, 0, 0, size) : NULL;
+	if (!shared->region && shared->mapping)
+	{
+		CloseHandle(shared->mapping);
+	}
+#else
+	int file = shm_open(name, create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0600);
+	if (file >= 0 && (!create || ftruncate(file, size) == 0))
+	{
+		void* region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+		shared->region = region == MAP_FAILED ? NULL : region;
+	}
+	if (file >= 0)
+	{
+		close(file);
+	}
+	if (!shared->region && create)
+	{
+		shm_unlink(name);
+	}
+#endif
+	if (!shared->region)
+	{
+		free(shared->name);
+		free(shared);
+		return NULL;
+	}
+	return shared;
+}
\ No newline at end of file
@@ -0,0 +1,769 @@
+﻿#include <allegro5/allegro.h>
+#include <allegro5/allegro_audio.h>
+#include <allegro5/allegro_acodec.h>
+#include <allegro5/allegro_native_dialog.h>
+#include <allegro5/allegro_font.h>
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "frontend.h"
+#include "struct_frontend.h"
+#include "struct_debug.h"
+#include "opcodes.h"
+#include "assets.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <time.h>
+
+static void prepare_display(FRONTEND* frontend, DISPLAY_OPTIONS display_options);
+static void prepare_window_options(FRONTEND* frontend);
+static void prepare_bitmaps(FRONTEND* frontend, DISPLAY_OPTIONS display_options);
+static void prepare_timers(FRONTEND* frontend);
+static bool prepare_audio(FRONTEND* frontend);
+static void prepare_event_queue(FRONTEND* frontend);
+static void delete_frontend(MACHINE* machine);
+static void update_display(MACHINE* machine);
+static void update_counters(MACHINE* machine);
+static void stop_beep(FRONTEND* frontend);
+static void run_turbo_frames(MACHINE* machine);
+static void report_fault(MACHINE* machine);
+static void handle_timer_events(MACHINE* machine, ALLEGRO_EVENT event);
+static void apply_input_events(MACHINE* machine);
+static void measure_input_latency(MACHINE* machine);
+static void count_timer_tick(FRONTEND* frontend, ALLEGRO_EVENT event, int64_t* last_tick);
+static void draw_metrics_overlay(FRONTEND* frontend);
+static void handle_display_events(MACHINE* machine, ALLEGRO_EVENT event);
+static void toggle_debug(MACHINE* machine, ALLEGRO_EVENT event);
+static void open_program(MACHINE* machine);
+static uint16_t add_to_playlist(FRONTEND* frontend, const char* file_name);
+static void clear_playlist(FRONTEND* frontend);
+static void* prewarm_image(ALLEGRO_THREAD* thread, void* frontend);
+static void start_prewarm(FRONTEND* frontend);
+static void finish_prewarm(FRONTEND* frontend);
+
+static enum
+{
+	MENU_OPTIONS_ID = 1,
+	MENU_RESET_ID,
+	MENU_DEBUG_ID,
+	MENU_NEXT_PROGRAM_ID,
+	MENU_OPEN_PROGRAM_ID,
+	MENU_PREWARM_ID,
+	MENU_WRAP_Y_AXIS_ID,
+	MENU_LARGE_SPRITES_ID,
+	MENU_PHOSPHOR_ID,
+	MENU_TURBO_ID,
+	MENU_METRICS_OVERLAY_ID,
+	MENU_DUMP_TRACE_ID
+};
+
+//Only what the first frame needs. Audio, fonts and native dialogs are initialized by whatever uses them first.
+bool start_allegro()
+{
+	al_init();
+	al_install_keyboard();
+	return true;
+}
+
+bool end_allegro()
+{
+	/*al_uninstall_keyboard();
+	al_uninstall_audio();
+	al_shutdown_font_addon();
+	al_shutdown_ttf_addon();
+	al_shutdown_native_dialog_addon();*/
+	return true;
+}
+
+static void prepare_display(FRONTEND* frontend, DISPLAY_OPTIONS display_options)
+{
+	frontend->display_options = display_options;
+	frontend->display = al_create_display(DEFAULT_DISPLAY_WIDTH * display_options.scale, DEFAULT_DISPLAY_HEIGHT * display_options.scale);
+	assert(frontend->display);
+	al_set_window_title(frontend->display, "C8 - CHIP8 Emulator");
+}
+
+//Built after the first frame is shown, since the native dialog addon is slow to start on some platforms
+static void prepare_window_options(FRONTEND* frontend)
+{
+	al_init_native_dialog_addon();
+	ALLEGRO_MENU_INFO menu_info[] =
+	{
+		ALLEGRO_START_OF_MENU("Options", MENU_OPTIONS_ID),
+		{ "Reset", MENU_RESET_ID, 0, NULL},
+		{ "Next program", MENU_NEXT_PROGRAM_ID, 0, NULL },
+		{ "Open program...", MENU_OPEN_PROGRAM_ID, 0, NULL },
+		{ "Pre-warm next program", MENU_PREWARM_ID, ALLEGRO_MENU_ITEM_CHECKBOX | ALLEGRO_MENU_ITEM_CHECKED, NULL },
+		{ "Debug window", MENU_DEBUG_ID, ALLEGRO_MENU_ITEM_CHECKBOX, NULL },
+		{ "Wrap Y axis", MENU_WRAP_Y_AXIS_ID, ALLEGRO_MENU_ITEM_CHECKBOX, NULL },
+		{ "16x16 sprites (DXY0)", MENU_LARGE_SPRITES_ID, ALLEGRO_MENU_ITEM_CHECKBOX, NULL },
+		{ "Phosphor persistence", MENU_PHOSPHOR_ID, ALLEGRO_MENU_ITEM_CHECKBOX | ALLEGRO_MENU_ITEM_CHECKED, NULL },
+		{ "Fast-forward (hold Tab)", MENU_TURBO_ID, ALLEGRO_MENU_ITEM_CHECKBOX, NULL },
+		{ "Metrics overlay", MENU_METRICS_OVERLAY_ID, ALLEGRO_MENU_ITEM_CHECKBOX, NULL },
+		{ "Dump trace", MENU_DUMP_TRACE_ID, 0, NULL },
+		ALLEGRO_END_OF_MENU,
+		ALLEGRO_END_OF_MENU
+	};
+	ALLEGRO_MENU* display_menu = al_build_menu(menu_info);
+	al_set_display_menu(frontend->display, display_menu);
+	al_register_event_source(frontend->event_queue, al_get_default_menu_event_source());
+}
+
+static void prepare_bitmaps(FRONTEND* frontend, DISPLAY_OPTIONS display_options)
+{
+	frontend->screen = al_create_bitmap(NUM_PIXEL_COLS, NUM_PIXEL_ROWS);
+	assert(frontend->screen);
+	uint8_t on[3];
+	uint8_t off[3];
+	al_unmap_rgb(display_options.color_on, &on[0], &on[1], &on[2]);
+	al_unmap_rgb(display_options.color_off, &off[0], &off[1], &off[2]);
+	for (uint16_t i = 0; i < 256; i++)
+	{
+		uint32_t color = 0xFF000000;
+		for (uint8_t c = 0; c < 3; c++)
+		{
+			color |= (uint32_t)((off[c] * (255 - i) + on[c] * i) / 255) << (8 * c);
+		}
+		frontend->palette[i] = color;
+	}
+	reset_phosphor(&frontend->phosphor, NUM_PIXEL_COLS, NUM_PIXEL_ROWS);
+	frontend->phosphor.decay_shift = DEFAULT_PHOSPHOR_DECAY_SHIFT;
+	frontend->phosphor.enabled = true;
+}
+
+static void prepare_timers(FRONTEND* frontend)
+{
+	frontend->counter_timer = al_create_timer(DEFAULT_COUNTER_TIMER_PERIOD);
+	assert(frontend->counter_timer);
+	al_start_timer(frontend->counter_timer);
+	frontend->opcode_timer = al_create_timer(DEFAULT_OPCODE_TIMER_PERIOD);
+	assert(frontend->opcode_timer);
+	al_start_timer(frontend->opcode_timer);
+}
+
+//Called on the first beep. A machine without audio or without the sample plays silently.
+static bool prepare_audio(FRONTEND* frontend)
+{
+	if (frontend->audio_prepared)
+	{
+		return frontend->beep;
+	}
+	frontend->audio_prepared = true;
+	if (!al_install_audio() || !al_init_acodec_addon() || !al_reserve_samples(1))
+	{
+		return false;
+	}
+	ALLEGRO_FILE* file = open_asset(SOUND_ASSET);
+	if (file)
+	{
+		frontend->beep = al_load_sample_f(file, ".wav");
+		al_fclose(file);
+	}
+	return frontend->beep;
+}
+
+static void prepare_event_queue(FRONTEND* frontend)
+{
+	frontend->event_queue = al_create_event_queue();
+	assert(frontend->event_queue);
+	frontend->input_queue = al_create_event_queue();
+	assert(frontend->input_queue);
+	al_register_event_source(frontend->input_queue, al_get_keyboard_event_source());
+	al_register_event_source(frontend->event_queue, al_get_display_event_source(frontend->display));
+	al_register_event_source(frontend->event_queue, al_get_timer_event_source(frontend->counter_timer));
+	al_register_event_source(frontend->event_queue, al_get_timer_event_source(frontend->opcode_timer));
+}
+
+MACHINE* create_machine(DISPLAY_OPTIONS display_options)
+{
+	MACHINE* machine = create_headless_machine();
+	FRONTEND* frontend = calloc(sizeof(FRONTEND), 1);
+	assert(frontend);
+	INPUT_KEY keypad[KEYPAD_WIDTH * KEYPAD_HEIGHT] = DEFAULT_KEYPAD;
+	machine->frontend = frontend;
+	machine->delete_frontend = delete_frontend;
+	set_keypad(machine, keypad);
+	prepare_display(frontend, display_options);
+	prepare_bitmaps(frontend, display_options);
+	prepare_timers(frontend);
+	prepare_event_queue(frontend);
+	machine->debug = create_debug(machine);
+	frontend->prewarm_enabled = true;
+	frontend->turbo_speed = DEFAULT_TURBO_SPEED;
+	frontend->metrics = create_metrics(DEFAULT_METRICS_INTERVAL);
+	seed_machine(machine, (uint32_t)time(NULL));
+	return machine;
+}
+
+static void delete_frontend(MACHINE* machine)
+{
+	FRONTEND* frontend = machine->frontend;
+	clear_playlist(frontend);
+	al_destroy_event_queue(frontend->event_queue);
+	al_destroy_event_queue(frontend->input_queue);
+	al_destroy_bitmap(frontend->screen);
+	al_destroy_timer(frontend->counter_timer);
+	al_destroy_timer(frontend->opcode_timer);
+	if (frontend->beep)
+	{
+		al_stop_samples();
+		al_destroy_sample(frontend->beep);
+	}
+	if (frontend->overlay_font)
+	{
+		al_destroy_font(frontend->overlay_font);
+	}
+	delete_metrics(frontend->metrics);
+	al_destroy_display(frontend->display);
+	delete_debug(machine->debug);
+	free(frontend);
+	machine->frontend = NULL;
+	machine->debug = NULL;
+}
+
+void set_keypad(MACHINE* machine, const INPUT_KEY* keypad)
+{
+	clear_keymap(&machine->frontend->keymap);
+	for (uint8_t i = 0; i < KEYPAD_WIDTH * KEYPAD_HEIGHT; i++)
+	{
+		map_key(&machine->frontend->keymap, keypad[i].keycode, keypad[i].value);
+	}
+}
+
+KEYMAP* get_keymap(MACHINE* machine)
+{
+	return &machine->frontend->keymap;
+}
+
+//The export is owned by the caller, which deletes it after the machine
+void set_export(MACHINE* machine, EXPORT* shared)
+{
+	machine->frontend->shared = shared;
+}
+
+//Also owned by the caller, and deleted after the machine so the writer drains every queued frame
+void set_capture(MACHINE* machine, CAPTURE* capture)
+{
+	machine->frontend->capture = capture;
+}
+
+//Multiple of the normal speed while fast-forwarding, or 0 to run as fast as the host allows
+void set_turbo_speed(MACHINE* machine, uint16_t speed)
+{
+	machine->frontend->turbo_speed = speed;
+}
+
+//Blends the screen into the phosphor buffer and uploads it as a single bitmap
+static void update_display(MACHINE* machine)
+{
+	FRONTEND* frontend = machine->frontend;
+	update_phosphor(&frontend->phosphor, machine->pixel_row);
+	ALLEGRO_LOCKED_REGION* region = al_lock_bitmap(frontend->screen, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_WRITEONLY);
+	if (region)
+	{
+		const uint8_t* intensity = frontend->phosphor.intensity;
+		for (uint8_t y = 0; y < NUM_PIXEL_ROWS; y++)
+		{
+			uint32_t* texel = (uint32_t*)((uint8_t*)region->data + y * region->pitch);
+			for (uint8_t x = 0; x < NUM_PIXEL_COLS; x++)
+			{
+				texel[x] = frontend->palette[*intensity++];
+			}
+		}
+		al_unlock_bitmap(frontend->screen);
+	}
+	uint8_t scale = frontend->display_options.scale;
+	al_set_target_backbuffer(frontend->display);
+	al_draw_scaled_bitmap(frontend->screen, 0, 0, NUM_PIXEL_COLS, NUM_PIXEL_ROWS, 0, 0, NUM_PIXEL_COLS * scale, NUM_PIXEL_ROWS * scale, 0);
+}
+
+static void update_counters(MACHINE* machine)
+{
+	FRONTEND* frontend = machine->frontend;
+	if (machine->d_counter > 0)
+	{
+		machine->d_counter--;
+	}
+	if (machine->s_counter > 0)
+	{
+		if (!frontend->beep_playing && prepare_audio(frontend))
+		{
+			al_play_sample(frontend->beep, 1, 0, 1, ALLEGRO_PLAYMODE_LOOP, &frontend->beep_id);
+			frontend->beep_playing = true;
+			count_beeper_toggle(frontend->metrics);
+		}
+		machine->s_counter--;
+	}
+	else
+	{
+		stop_beep(frontend);
+	}
+}
+
+static void stop_beep(FRONTEND* frontend)
+{
+	if (frontend->beep_playing)
+	{
+		frontend->beep_playing = false;
+		al_stop_sample(&frontend->beep_id);
+		count_beeper_toggle(frontend->metrics);
+	}
+}
+
+//Fast-forward: emulates turbo_speed frames, or as many as fit in part of a counter period when uncapped, each being
+//the instructions of one counter period followed by one counter decrement, so the timers keep their pace relative
+//to the program. Only the last frame is presented, by the caller, and the beeper stays muted.
+static void run_turbo_frames(MACHINE* machine)
+{
+	FRONTEND* frontend = machine->frontend;
+	stop_beep(frontend);
+	double period = al_get_timer_speed(frontend->counter_timer);
+	double instructions_per_frame = period / al_get_timer_speed(frontend->opcode_timer);
+	double start = al_get_time();
+	uint32_t instructions = 0;
+	for (uint32_t frame = 0; frontend->turbo_speed ? frame < frontend->turbo_speed : al_get_time() - start < period * TURBO_UNCAPPED_SHARE; frame++)
+	{
+		for (frontend->turbo_cycles += instructions_per_frame; frontend->turbo_cycles >= 1; frontend->turbo_cycles--)
+		{
+			if (frontend->latency.pending)
+			{
+				measure_input_latency(machine);
+			}
+			machine->step(machine);
+			instructions++;
+		}
+		machine->d_counter -= machine->d_counter > 0;
+		machine->s_counter -= machine->s_counter > 0;
+	}
+	count_instructions(frontend->metrics, instructions, al_get_time() - start);
+}
+
+//Shown once per fault, from the counter timer so the opcode timer keeps its pace
+static void report_fault(MACHINE* machine)
+{
+	FRONTEND* frontend = machine->frontend;
+	if (machine->fault == FAULT_NONE)
+	{
+		frontend->fault_reported = false;
+		return;
+	}
+	if (frontend->fault_reported)
+	{
+		return;
+	}
+	char message[64];
+	snprintf(message, sizeof(message), "%s at %03hX. Use Reset to restart the program.", fault_to_string(machine->fault), machine->pc_reg);
+	frontend->fault_reported = true;
+	al_show_native_message_box(frontend->display, "C8", "The machine halted", message, NULL, ALLEGRO_MESSAGEBOX_WARN);
+}
+
+static void handle_timer_events(MACHINE* machine, ALLEGRO_EVENT event)
+{
+	if(event.type != ALLEGRO_EVENT_TIMER)
+	{
+		return;
+	}
+	FRONTEND* frontend = machine->frontend;
+	bool turbo = frontend->turbo_held || frontend->turbo_enabled;
+	if (event.timer.source == frontend->opcode_timer)
+	{
+		count_timer_tick(frontend, event, &frontend->last_opcode_tick);
+		if (turbo)
+		{
+			return; //the counter timer runs the machine in whole frames
+		}
+		if (frontend->latency.pending)
+		{
+			measure_input_latency(machine);
+		}
+		double start = al_get_time();
+		machine->step(machine);
+		count_instructions(frontend->metrics, 1, al_get_time() - start);
+	}
+	else if (event.timer.source == frontend->counter_timer)
+	{
+		count_timer_tick(frontend, event, &frontend->last_counter_tick);
+		if (turbo)
+		{
+			run_turbo_frames(machine);
+		}
+		else
+		{
+			update_counters(machine);
+		}
+		report_fault(machine);
+		double start = al_get_time();
+		present_frame(machine);
+		double now = al_get_time();
+		count_frame(frontend->metrics, now, now - start);
+		update_metrics(frontend->metrics, now);
+		if (frontend->shared)
+		{
+			publish_frame(frontend->shared, machine);
+		}
+		if (frontend->capture)
+		{
+			capture_frame(frontend->capture, machine->pixel_row);
+		}
+	}
+}
+
+//Depth is how many ticks of the same timer have fired since this one, i.e. are still queued behind it
+static void count_timer_tick(FRONTEND* frontend, ALLEGRO_EVENT event, int64_t* last_tick)
+{
+	int64_t tick = event.timer.count;
+	if (*last_tick > 0 && tick > *last_tick + 1)
+	{
+		count_dropped_ticks(frontend->metrics, (uint32_t)(tick - *last_tick - 1));
+	}
+	*last_tick = tick;
+	count_queue_depth(frontend->metrics, (uint32_t)(al_get_timer_count(event.timer.source) - tick));
+}
+
+//Applies every key event received so far, so the next instruction sees the keypad as it is now
+static void apply_input_events(MACHINE* machine)
+{
+	FRONTEND* frontend = machine->frontend;
+	ALLEGRO_EVENT event;
+	while (al_get_next_event(frontend->input_queue, &event))
+	{
+		if (event.type != ALLEGRO_EVENT_KEY_DOWN && event.type != ALLEGRO_EVENT_KEY_UP)
+		{
+			continue;
+		}
+		if (event.keyboard.keycode == TURBO_KEY)
+		{
+			frontend->turbo_held = event.type == ALLEGRO_EVENT_KEY_DOWN;
+			continue;
+		}
+		uint8_t value = lookup_key(&frontend->keymap, event.keyboard.keycode);
+		if (value == UNMAPPED_KEY)
+		{
+			continue;
+		}
+		bool pressed = event.type == ALLEGRO_EVENT_KEY_DOWN;
+		machine->key_pressed[value] = pressed;
+		if (pressed)
+		{
+			if (machine->waiting_for_input)
+			{
+				machine->input_received = true;
+			}
+			frontend->latency.key_time = event.any.timestamp;
+			frontend->latency.key_value = value;
+			frontend->latency.pending = true;
+		}
+	}
+}
+
+//A press counts as seen when the instruction about to run is an EX9E or EXA1 on its key, or an FX0A waiting for it.
+//Instructions run inside a fused or recompiled step are not looked at.
+static void measure_input_latency(MACHINE* machine)
+{
+	INPUT_LATENCY* latency = &machine->frontend->latency;
+	uint8_t* memory = RAM_AT(machine, machine->pc_reg);
+	uint16_t opcode = (memory[0] << 8) | memory[1];
+	bool skip_on_key = (opcode & 0xF0FF) == 0xE09E || (opcode & 0xF0FF) == 0xE0A1;
+	if ((skip_on_key && machine->v_reg[GET_X(opcode)] == latency->key_value) || machine->input_received)
+	{
+		double elapsed = al_get_time() - latency->key_time;
+		latency->pending = false;
+		latency->samples++;
+		latency->total += elapsed;
+		latency->max = elapsed > latency->max ? elapsed : latency->max;
+	}
+}
+
+void report_input_latency(MACHINE* machine, FILE* file)
+{
+	INPUT_LATENCY* latency = &machine->frontend->latency;
+	if (latency->samples == 0)
+	{
+		fprintf(file, "Input latency: no key press was read by the program\n");
+		return;
+	}
+	fprintf(file, "Input latency over %u presses: mean %.2f ms, max %.2f ms\n", latency->samples, 1000 * latency->total / latency->samples, 1000 * latency->max);
+}
+
+static void handle_display_events(MACHINE* machine, ALLEGRO_EVENT event)
+{
+	ALLEGRO_DISPLAY* display = machine->frontend->display;
+	if (event.display.source != display && event.user.data2 != (intptr_t)display)
+	{
+		return;
+	}
+	switch (event.type)
+	{
+	case ALLEGRO_EVENT_DISPLAY_CLOSE:
+		machine->on = false;
+		break;
+	case ALLEGRO_EVENT_MENU_CLICK:
+		switch (event.user.data1)
+		{
+		case MENU_RESET_ID:
+			reset_machine(machine);
+			break;
+		case MENU_DEBUG_ID:
+			toggle_debug(machine, event);
+			break;
+		case MENU_NEXT_PROGRAM_ID:
+			if (machine->frontend->playlist_size > 1)
+			{
+				switch_playlist(machine, (machine->frontend->playlist_position + 1) % machine->frontend->playlist_size);
+			}
+			break;
+		case MENU_OPEN_PROGRAM_ID:
+			open_program(machine);
+			break;
+		case MENU_PREWARM_ID:
+			machine->frontend->prewarm_enabled = al_get_menu_item_flags(al_get_display_menu(display), MENU_PREWARM_ID) & ALLEGRO_MENU_ITEM_CHECKED;
+			start_prewarm(machine->frontend);
+			break;
+		case MENU_WRAP_Y_AXIS_ID:
+			machine->y_wrap_enabled = al_get_menu_item_flags(al_get_display_menu(display), MENU_WRAP_Y_AXIS_ID) & ALLEGRO_MENU_ITEM_CHECKED;
+			break;
+		case MENU_LARGE_SPRITES_ID:
+			machine->large_sprites_enabled = al_get_menu_item_flags(al_get_display_menu(display), MENU_LARGE_SPRITES_ID) & ALLEGRO_MENU_ITEM_CHECKED;
+			break;
+		case MENU_PHOSPHOR_ID:
+			machine->frontend->phosphor.enabled = al_get_menu_item_flags(al_get_display_menu(display), MENU_PHOSPHOR_ID) & ALLEGRO_MENU_ITEM_CHECKED;
+			break;
+		case MENU_TURBO_ID:
+			machine->frontend->turbo_enabled = al_get_menu_item_flags(al_get_display_menu(display), MENU_TURBO_ID) & ALLEGRO_MENU_ITEM_CHECKED;
+			break;
+		case MENU_METRICS_OVERLAY_ID:
+			machine->frontend->overlay_enabled = al_get_menu_item_flags(al_get_display_menu(display), MENU_METRICS_OVERLAY_ID) & ALLEGRO_MENU_ITEM_CHECKED;
+			break;
+		case MENU_DUMP_TRACE_ID:
+			if (machine->trace)
+			{
+				flush_trace(machine->trace);
+			}
+			break;
+		}
+	}
+}
+
+static void toggle_debug(MACHINE* machine, ALLEGRO_EVENT event)
+{
+	bool checked = al_get_menu_item_flags((ALLEGRO_MENU*)event.user.data3, MENU_DEBUG_ID) & ALLEGRO_MENU_ITEM_CHECKED;
+	if (checked)
+	{
+		start_debug_thread(machine->debug);
+	}
+	else
+	{
+		end_debug_thread(machine->debug);
+	}
+}
+
+//Programs to switch between without recreating the frontend. The first file name should be the program already
+//loaded. With pre-warming on, the image of the next program is built in the background.
+void set_playlist(MACHINE* machine, const char** file_names, uint16_t count)
+{
+	FRONTEND* frontend = machine->frontend;
+	clear_playlist(frontend);
+	for (uint16_t i = 0; i < count; i++)
+	{
+		add_to_playlist(frontend, file_names[i]);
+	}
+	start_prewarm(frontend);
+}
+
+//Builds every image of the playlist now, so that no switch ever reads or analyses a file
+void preload_playlist(MACHINE* machine)
+{
+	FRONTEND* frontend = machine->frontend;
+	finish_prewarm(frontend);
+	for (uint16_t i = 0; i < frontend->playlist_size; i++)
+	{
+		if (!frontend->playlist_images[i])
+		{
+			frontend->playlist_images[i] = create_rom_image(frontend->playlist[i]);
+		}
+	}
+}
+
+//Starts the program at position, keeping the window, timers and audio. Returns false, leaving the current program
+//running, if it cannot be read.
+bool switch_playlist(MACHINE* machine, uint16_t position)
+{
+	FRONTEND* frontend = machine->frontend;
+	if (position >= frontend->playlist_size)
+	{
+		return false;
+	}
+	finish_prewarm(frontend);
+	if (!frontend->playlist_images[position])
+	{
+		frontend->playlist_images[position] = create_rom_image(frontend->playlist[position]);
+		if (!frontend->playlist_images[position])
+		{
+			return false;
+		}
+	}
+	switch_program(machine, frontend->playlist_images[position]);
+	frontend->playlist_position = position;
+	frontend->fault_reported = false;
+	reset_phosphor(&frontend->phosphor, NUM_PIXEL_COLS, NUM_PIXEL_ROWS);
+	start_prewarm(frontend);
+	return true;
+}
+
+static void open_program(MACHINE* machine)
+{
+	FRONTEND* frontend = machine->frontend;
+	ALLEGRO_FILECHOOSER* chooser = al_create_native_file_dialog(NULL, "Open program", "*.ch8;*.*", ALLEGRO_FILECHOOSER_FILE_MUST_EXIST);
+	if (!chooser)
+	{
+		return;
+	}
+	if (al_show_native_file_dialog(frontend->display, chooser) && al_get_native_file_dialog_count(chooser) > 0)
+	{
+		finish_prewarm(frontend);
+		uint16_t position = add_to_playlist(frontend, al_get_native_file_dialog_path(chooser, 0));
+		if (!switch_playlist(machine, position))
+		{
+			al_show_native_message_box(frontend->display, "C8", "Could not open the program", frontend->playlist[position], NULL, ALLEGRO_MESSAGEBOX_WARN);
+		}
+	}
+	al_destroy_native_file_dialog(chooser);
+}
+
+//Must not run while a pre-warm is in progress, since the arrays may move
+static uint16_t add_to_playlist(FRONTEND* frontend, const char* file_name)
+{
+	uint16_t position = frontend->playlist_size++;
+	frontend->playlist = realloc(frontend->playlist, frontend->playlist_size * sizeof(char*));
+	frontend->playlist_images = realloc(frontend->playlist_images, frontend->playlist_size * sizeof(ROM_IMAGE*));
+	assert(frontend->playlist && frontend->playlist_images);
+	frontend->playlist[position] = malloc(strlen(file_name) + 1);
+	assert(frontend->playlist[position]);
+	strcpy(frontend->playlist[position], file_name);
+	frontend->playlist_images[position] = NULL;
+	return position;
+}
+
+static void clear_playlist(FRONTEND* frontend)
+{
+	finish_prewarm(frontend);
+	for (uint16_t i = 0; i < frontend->playlist_size; i++)
+	{
+		free(frontend->playlist[i]);
+		delete_rom_image(frontend->playlist_images[i]);
+	}
+	free(frontend->playlist);
+	free(frontend->playlist_images);
+	frontend->playlist = NULL;
+	frontend->playlist_images = NULL;
+	frontend->playlist_size = 0;
+	frontend->playlist_position = 0;
+}
+
+static void* prewarm_image(ALLEGRO_THREAD* thread, void* frontend)
+{
+	FRONTEND* f = frontend;
+	f->playlist_images[f->prewarm_position] = create_rom_image(f->playlist[f->prewarm_position]);
+	return NULL;
+}
+
+//Reading and analysing the next program happen off the event loop, unless its image is already built
+static void start_prewarm(FRONTEND* frontend)
+{
+	if (!frontend->prewarm_enabled || frontend->prewarm_thread || frontend->playlist_size < 2)
+	{
+		return;
+	}
+	uint16_t next = (frontend->playlist_position + 1) % frontend->playlist_size;
+	if (frontend->playlist_images[next])
+	{
+		return;
+	}
+	frontend->prewarm_position = next;
+	frontend->prewarm_thread = al_create_thread(prewarm_image, frontend);
+	if (frontend->prewarm_thread)
+	{
+		al_start_thread(frontend->prewarm_thread);
+	}
+}
+
+static void finish_prewarm(FRONTEND* frontend)
+{
+	if (frontend->prewarm_thread)
+	{
+		al_join_thread(frontend->prewarm_thread, NULL);
+		al_destroy_thread(frontend->prewarm_thread);
+		frontend->prewarm_thread = NULL;
+	}
+}
+
+DEBUG* get_debug(MACHINE* machine)
+{
+	return machine->debug;
+}
+
+//Draws the screen as it is now without stepping the machine or its counters
+void present_frame(MACHINE* machine)
+{
+	update_display(machine);
+	al_set_target_backbuffer(machine->frontend->display);
+	if (machine->frontend->overlay_enabled)
+	{
+		draw_metrics_overlay(machine->frontend);
+	}
+	al_flip_display();
+}
+
+METRICS* get_metrics(MACHINE* machine)
+{
+	return machine->frontend->metrics;
+}
+
+//Figures of the last complete interval, over the top left of the screen
+static void draw_metrics_overlay(FRONTEND* frontend)
+{
+	if (!frontend->overlay_font)
+	{
+		al_init_font_addon();
+		frontend->overlay_font = al_create_builtin_font();
+		if (!frontend->overlay_font)
+		{
+			frontend->overlay_enabled = false;
+			return;
+		}
+	}
+	const METRICS_SNAPSHOT* snapshot = get_metrics_snapshot(frontend->metrics);
+	ALLEGRO_COLOR color = al_map_rgb(255, 255, 0);
+	float line_height = al_get_font_line_height(frontend->overlay_font) + 2;
+	al_draw_textf(frontend->overlay_font, color, 4, 4, 0, "%.0f IPS, %u frames", snapshot->instructions_per_second, snapshot->frames);
+	al_draw_textf(frontend->overlay_font, color, 4, 4 + line_height, 0, "frame ms %.1f p95 %.1f p99 %.1f max %.1f",
+		snapshot->frame_ms_mean, snapshot->frame_ms_p95, snapshot->frame_ms_p99, snapshot->frame_ms_max);
+	al_draw_textf(frontend->overlay_font, color, 4, 4 + 2 * line_height, 0, "display %.1f ms, emulation %.1f ms",
+		snapshot->display_ms, snapshot->emulation_ms);
+	al_draw_textf(frontend->overlay_font, color, 4, 4 + 3 * line_height, 0, "queue %.1f max %u, dropped %u, beeps %u",
+		snapshot->queue_depth_mean, snapshot->queue_depth_max, snapshot->dropped_ticks, snapshot->beeper_toggles);
+}
+
+void run_program(MACHINE* machine)
+{
+	present_frame(machine);
+	prepare_window_options(machine->frontend);
+	while (machine->on)
+	{
+		ALLEGRO_EVENT event;
+		al_wait_for_event(machine->frontend->event_queue, &event);
+		al_lock_mutex(machine->debug->event_mutex);
+		if (machine->frontend->shared && apply_exported_keypad(machine->frontend->shared, machine))
+		{
+			al_flush_event_queue(machine->frontend->input_queue);
+		}
+		else
+		{
+			apply_input_events(machine);
+		}
+		handle_timer_events(machine, event);
+		handle_display_events(machine, event);
+		al_unlock_mutex(machine->debug->event_mutex);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+﻿#include <assert.h>
+#include <stdlib.h>
+#include "fusion.h"
+#include "opcodes.h"
+#include "struct_analysis.h"
+
+static uint16_t read_word(const uint8_t* RAM, uint16_t address);
+static FUSION_KIND match_fusion(const uint8_t* RAM, uint16_t address);
+
+//Marks every address where one of the fused idioms starts. Self-modified code is left to the plain interpreter,
+//and FX33/FX55 clear the entries they overwrite at run time. Timer waits come from the idle loops the analysis found.
+uint8_t* build_fusion_table(const ANALYSIS* analysis, const uint8_t* RAM)
+{
+	uint8_t* table = calloc(RAM_SIZE, 1);
+	assert(table);
+	for (uint16_t address = analysis->program_start; address + 1 < analysis->program_end; address++)
+	{
+		if (!(analysis->flags[address] & ADDRESS_CODE) || (analysis->flags[address] & ADDRESS_SELF_MODIFIED))
+		{
+			continue;
+		}
+		if (analysis->flags[address] & ADDRESS_IDLE_LOOP)
+		{
+			//Of the idle loops, only the one polling the delay timer, FX07; 3X00; 1NNN, has a fused handler
+			table[address] = (read_word(RAM, address) & 0xF000) == 0xF000 ? FUSION_TIMER_WAIT : FUSION_NONE;
+			continue;
+		}
+		table[address] = match_fusion(RAM, address);
+	}
+	return table;
+}
+
+const char* fusion_kind_to_string(FUSION_KIND kind)
+{
+	switch (kind)
+	{
+	case FUSION_SET_PAIR:
+		return "6XNN; 6YNN";
+	case FUSION_POINT_AND_DRAW:
+		return "ANNN; DXYN";
+	case FUSION_TIMER_WAIT:
+		return "FX07; 3X00; 1NNN";
+	case FUSION_COUNTED_LOOP:
+		return "7XNN; 3XNN; 1NNN";
+	default:
+		return "None";
+	}
+}
+
+static uint16_t read_word(const uint8_t* RAM, uint16_t address)
+{
+	return (RAM[MASK_ADDRESS(address)] << 8) | RAM[MASK_ADDRESS(address + 1)];
+}
+
+static FUSION_KIND match_fusion(const uint8_t* RAM, uint16_t address)
+{
+	uint16_t first = read_word(RAM, address);
+	uint16_t second = read_word(RAM, address + MEM_STEP);
+	uint16_t third = read_word(RAM, address + 2 * MEM_STEP);
+	if ((first & 0xF000) == 0x6000 && (second & 0xF000) == 0x6000)
+	{
+		return FUSION_SET_PAIR;
+	}
+	if ((first & 0xF000) == 0xA000 && (second & 0xF000) == 0xD000)
+	{
+		return FUSION_POINT_AND_DRAW;
+	}
+	if ((first & 0xF000) == 0x7000 && (second & 0xFF00) == (0x3000 | (first & 0x0F00)) && (third & 0xF000) == 0x1000)
+	{
+		return FUSION_COUNTED_LOOP;
+	}
+	return FUSION_NONE;
+}
\ No newline at end of file
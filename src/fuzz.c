@@ -0,0 +1,199 @@
+﻿#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "struct_fuzz.h"
+#include "machine.h"
+#include "opcodes.h"
+
+static uint32_t next_random(FUZZER* fuzzer);
+static void mutate(FUZZER* fuzzer, FUZZ_INPUT* input);
+static uint32_t execute_input(FUZZER* fuzzer, const FUZZ_INPUT* input);
+static bool record_crash(FUZZER* fuzzer, const FUZZ_INPUT* input);
+
+FUZZER* create_fuzzer(const uint8_t* program, uint16_t size, const FUZZ_OPTIONS* options)
+{
+	FUZZER* fuzzer = calloc(1, sizeof(FUZZER));
+	assert(fuzzer);
+	fuzzer->options = *options;
+	if (fuzzer->options.frames == 0 || fuzzer->options.frames > FUZZ_MAX_FRAMES)
+	{
+		fuzzer->options.frames = fuzzer->options.frames ? FUZZ_MAX_FRAMES : DEFAULT_FUZZ_FRAMES;
+	}
+	if (fuzzer->options.ticks_per_frame == 0)
+	{
+		fuzzer->options.ticks_per_frame = DEFAULT_FUZZ_TICKS_PER_FRAME;
+	}
+	fuzzer->random_state = options->seed ? options->seed : DEFAULT_RANDOM_SEED;
+	fuzzer->program_size = size;
+	fuzzer->snapshot = create_headless_machine();
+	fuzzer->snapshot->strict_enabled = true;
+	fuzzer->snapshot->fusion_enabled = false;
+	load_program_data(fuzzer->snapshot, "fuzz", program, size);
+	fuzzer->machine = create_headless_machine();
+	load_program_data(fuzzer->machine, "fuzz", program, size);
+	fuzzer->corpus = calloc(FUZZ_CORPUS_SIZE, sizeof(FUZZ_INPUT));
+	fuzzer->crashes = calloc(FUZZ_MAX_CRASHES, sizeof(FUZZ_CRASH));
+	assert(fuzzer->corpus && fuzzer->crashes);
+	fuzzer->corpus[0].seed = DEFAULT_RANDOM_SEED;
+	fuzzer->corpus_size = 1;
+	return fuzzer;
+}
+
+void delete_fuzzer(FUZZER* fuzzer)
+{
+	delete_machine(fuzzer->snapshot);
+	delete_machine(fuzzer->machine);
+	free(fuzzer->corpus);
+	free(fuzzer->crashes);
+	free(fuzzer);
+}
+
+//Runs one mutated input from the corpus, the first time the program without any input. Returns the crash it found
+//if it is new, NULL otherwise.
+const FUZZ_CRASH* fuzz_once(FUZZER* fuzzer)
+{
+	FUZZ_INPUT* input = &fuzzer->candidate;
+	*input = fuzzer->corpus[next_random(fuzzer) % fuzzer->corpus_size];
+	uint8_t mutations = fuzzer->stats.executions > 0 ? 1 + next_random(fuzzer) % FUZZ_MAX_MUTATIONS : 0;
+	for (uint8_t i = 0; i < mutations; i++)
+	{
+		mutate(fuzzer, input);
+	}
+	if (execute_input(fuzzer, input) > 0 && fuzzer->corpus_size < FUZZ_CORPUS_SIZE)
+	{
+		fuzzer->corpus[fuzzer->corpus_size++] = *input;
+	}
+	return record_crash(fuzzer, input) ? &fuzzer->crashes[fuzzer->num_crashes - 1] : NULL;
+}
+
+//Runs input once and returns the MACHINE_FAULT it ends with, FAULT_NONE if it ran all its frames
+uint8_t replay_fuzz_input(FUZZER* fuzzer, const FUZZ_INPUT* input, uint16_t* pc_reg)
+{
+	execute_input(fuzzer, input);
+	*pc_reg = fuzzer->machine->pc_reg;
+	return fuzzer->machine->fault;
+}
+
+FUZZ_STATS get_fuzz_stats(const FUZZER* fuzzer)
+{
+	FUZZ_STATS stats = fuzzer->stats;
+	stats.corpus_size = fuzzer->corpus_size;
+	stats.num_crashes = fuzzer->num_crashes;
+	return stats;
+}
+
+static uint32_t next_random(FUZZER* fuzzer)
+{
+	uint32_t state = fuzzer->random_state;
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	fuzzer->random_state = state;
+	return state;
+}
+
+static void mutate(FUZZER* fuzzer, FUZZ_INPUT* input)
+{
+	uint16_t frames = fuzzer->options.frames;
+	uint16_t frame = next_random(fuzzer) % frames;
+	uint8_t kind = next_random(fuzzer) % (fuzzer->options.mutate_rom ? NUM_FUZZ_MUTATIONS : FUZZ_PATCH_ROM);
+	switch (kind)
+	{
+	case FUZZ_FLIP_KEY:
+		input->keys[frame] ^= 1 << (next_random(fuzzer) % KEYPAD_SIZE);
+		break;
+	case FUZZ_HOLD_KEY:
+	{
+		uint16_t keys = next_random(fuzzer) % 2 ? 1 << (next_random(fuzzer) % KEYPAD_SIZE) : 0;
+		uint16_t length = 1 + next_random(fuzzer) % 30;
+		for (uint16_t i = frame; i < frames && i < frame + length; i++)
+		{
+			input->keys[i] = keys;
+		}
+		break;
+	}
+	case FUZZ_RESEED:
+		input->seed = next_random(fuzzer);
+		break;
+	case FUZZ_SPLICE:
+	{
+		const FUZZ_INPUT* other = &fuzzer->corpus[next_random(fuzzer) % fuzzer->corpus_size];
+		memcpy(input->keys + frame, other->keys + frame, (frames - frame) * sizeof(uint16_t));
+		break;
+	}
+	case FUZZ_PATCH_ROM:
+	{
+		uint8_t patch = input->num_patches < FUZZ_MAX_PATCHES ? input->num_patches++ : next_random(fuzzer) % FUZZ_MAX_PATCHES;
+		input->patch_address[patch] = PROGRAM_BASE_ADDRESS + next_random(fuzzer) % fuzzer->program_size;
+		input->patch_value[patch] = (uint8_t)next_random(fuzzer);
+		break;
+	}
+	}
+}
+
+//Restores the snapshot instead of reloading the program, then runs the input while marking edges between
+//consecutive program counters. Returns how many edges were new.
+static uint32_t execute_input(FUZZER* fuzzer, const FUZZ_INPUT* input)
+{
+	MACHINE* machine = fuzzer->machine;
+	copy_machine(machine, fuzzer->snapshot);
+	seed_machine(machine, input->seed);
+	for (uint8_t i = 0; i < input->num_patches; i++)
+	{
+		*RAM_AT(machine, input->patch_address[i]) = input->patch_value[i];
+		mirror_ram_writes(machine, input->patch_address[i], 1);
+	}
+	uint8_t* coverage = fuzzer->coverage;
+	uint32_t new_edges = 0;
+	uint16_t previous = machine->pc_reg;
+	for (uint16_t frame = 0; frame < fuzzer->options.frames && machine->fault == FAULT_NONE; frame++)
+	{
+		press_keypad(machine, input->keys[frame]);
+		for (uint16_t tick = 0; tick < fuzzer->options.ticks_per_frame; tick++)
+		{
+			machine->step(machine);
+			uint16_t pc = machine->pc_reg;
+			if (machine->fault != FAULT_NONE)
+			{
+				break;
+			}
+			if (pc < PROGRAM_BASE_ADDRESS || pc + MEM_STEP > RAM_SIZE)
+			{
+				raise_fault(machine, FAULT_PC_OUT_OF_RANGE, pc);
+				break;
+			}
+			uint8_t* edge = &coverage[FUZZ_EDGE(previous, pc)];
+			new_edges += !*edge;
+			*edge = 1;
+			previous = pc;
+		}
+		machine->d_counter -= machine->d_counter > 0;
+		machine->s_counter -= machine->s_counter > 0;
+	}
+	fuzzer->stats.executions++;
+	fuzzer->stats.edges += new_edges;
+	return new_edges;
+}
+
+//Crashes are told apart by fault and address, so each bug is reported once however many inputs reach it
+static bool record_crash(FUZZER* fuzzer, const FUZZ_INPUT* input)
+{
+	MACHINE* machine = fuzzer->machine;
+	if (machine->fault == FAULT_NONE || fuzzer->num_crashes >= FUZZ_MAX_CRASHES)
+	{
+		return false;
+	}
+	for (uint16_t i = 0; i < fuzzer->num_crashes; i++)
+	{
+		if (fuzzer->crashes[i].fault == machine->fault && fuzzer->crashes[i].pc_reg == machine->pc_reg)
+		{
+			return false;
+		}
+	}
+	FUZZ_CRASH* crash = &fuzzer->crashes[fuzzer->num_crashes++];
+	crash->fault = machine->fault;
+	crash->pc_reg = machine->pc_reg;
+	crash->opcode = machine->current_opcode;
+	crash->input = *input;
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,274 @@
+﻿#include <allegro5/allegro.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "struct_grid.h"
+#include "struct_frontend.h"
+#include "machine.h"
+#include "rom.h"
+
+static uint32_t map_color(ALLEGRO_COLOR color);
+static void step_tile(void* context, uint16_t index);
+static void run_grid_frame(GRID* grid);
+static void compose_tiles(GRID* grid);
+static void draw_border(GRID* grid, uint16_t tile, uint32_t color);
+static void present_grid(GRID* grid);
+static void apply_grid_key(GRID* grid, ALLEGRO_EVENT event);
+
+//Tiles take the programs in file_names in turn, each machine seeded with seed plus its index so that tiles running
+//the same program diverge wherever it draws random numbers. Every program is analysed once and shared through a ROM
+//image. Returns NULL if none of the programs could be read.
+GRID* create_grid(DISPLAY_OPTIONS display_options, const char** file_names, uint16_t num_files, uint16_t num_tiles, uint32_t seed)
+{
+	ROM_IMAGE** images = calloc(num_files, sizeof(ROM_IMAGE*));
+	assert(images);
+	uint16_t num_images = 0;
+	for (uint16_t i = 0; i < num_files; i++)
+	{
+		images[num_images] = create_rom_image(file_names[i]);
+		num_images += images[num_images] != NULL;
+	}
+	if (num_images == 0)
+	{
+		free(images);
+		return NULL;
+	}
+	GRID* grid = calloc(1, sizeof(GRID));
+	assert(grid);
+	grid->num_tiles = num_tiles < 1 ? 1 : num_tiles > MAX_GRID_TILES ? MAX_GRID_TILES : num_tiles;
+	for (uint16_t i = 0; i < grid->num_tiles; i++)
+	{
+		grid->machines[i] = create_headless_machine();
+		switch_program(grid->machines[i], images[i % num_images]);
+		seed_machine(grid->machines[i], seed + i);
+	}
+	for (uint16_t i = 0; i < num_images; i++)
+	{
+		delete_rom_image(images[i]);
+	}
+	free(images);
+
+	while (grid->columns * grid->columns < grid->num_tiles)
+	{
+		grid->columns++;
+	}
+	grid->rows = (grid->num_tiles + grid->columns - 1) / grid->columns;
+	grid->width = grid->columns * GRID_TILE_WIDTH;
+	grid->height = grid->rows * GRID_TILE_HEIGHT;
+	//The window stays about twice as wide as a single machine's, whatever the number of tiles
+	grid->scale = 2 * display_options.scale / grid->columns;
+	grid->scale = grid->scale < 1 ? 1 : grid->scale;
+	grid->color_on = map_color(display_options.color_on);
+	grid->color_off = map_color(display_options.color_off);
+	grid->color_border = map_color(al_map_rgb(48, 48, 48));
+	grid->color_focus = map_color(al_map_rgb(255, 255, 0));
+	grid->texels = malloc(grid->width * grid->height * sizeof(uint32_t));
+	assert(grid->texels);
+	for (uint32_t i = 0; i < (uint32_t)grid->width * grid->height; i++)
+	{
+		grid->texels[i] = grid->color_border;
+	}
+	grid->focus_moved = true;
+	grid->pool = create_pool(get_core_count() - 1);
+	grid->instructions_per_frame = (DEFAULT_COUNTER_TIMER_PERIOD) / (DEFAULT_OPCODE_TIMER_PERIOD);
+	INPUT_KEY keypad[KEYPAD_WIDTH * KEYPAD_HEIGHT] = DEFAULT_KEYPAD;
+	clear_keymap(&grid->keymap);
+	for (uint8_t i = 0; i < KEYPAD_WIDTH * KEYPAD_HEIGHT; i++)
+	{
+		map_key(&grid->keymap, keypad[i].keycode, keypad[i].value);
+	}
+
+	grid->display = al_create_display(grid->width * grid->scale, grid->height * grid->scale);
+	assert(grid->display);
+	al_set_window_title(grid->display, "C8 - CHIP8 Emulator (Tab and Shift+Tab move the focus)");
+	grid->screen = al_create_bitmap(grid->width, grid->height);
+	assert(grid->screen);
+	grid->frame_timer = al_create_timer(DEFAULT_COUNTER_TIMER_PERIOD);
+	assert(grid->frame_timer);
+	grid->event_queue = al_create_event_queue();
+	assert(grid->event_queue);
+	al_register_event_source(grid->event_queue, al_get_display_event_source(grid->display));
+	al_register_event_source(grid->event_queue, al_get_keyboard_event_source());
+	al_register_event_source(grid->event_queue, al_get_timer_event_source(grid->frame_timer));
+	return grid;
+}
+
+void delete_grid(GRID* grid)
+{
+	al_destroy_event_queue(grid->event_queue);
+	al_destroy_timer(grid->frame_timer);
+	al_destroy_bitmap(grid->screen);
+	al_destroy_display(grid->display);
+	delete_pool(grid->pool);
+	for (uint16_t i = 0; i < grid->num_tiles; i++)
+	{
+		delete_machine(grid->machines[i]);
+	}
+	free(grid->texels);
+	free(grid);
+}
+
+KEYMAP* get_grid_keymap(GRID* grid)
+{
+	return &grid->keymap;
+}
+
+//ABGR_8888_LE, the format the screen bitmap is locked in
+static uint32_t map_color(ALLEGRO_COLOR color)
+{
+	uint8_t r;
+	uint8_t g;
+	uint8_t b;
+	al_unmap_rgb(color, &r, &g, &b);
+	return 0xFF000000 | (b << 16) | (g << 8) | r;
+}
+
+//One frame of one machine, on a pool thread. Machines share nothing, so tiles need no locking.
+static void step_tile(void* context, uint16_t index)
+{
+	GRID* grid = context;
+	MACHINE* machine = grid->machines[index];
+	for (uint16_t i = 0; i < grid->frame_instructions; i++)
+	{
+		machine->step(machine);
+	}
+	machine->d_counter -= machine->d_counter > 0;
+	machine->s_counter -= machine->s_counter > 0;
+}
+
+static void run_grid_frame(GRID* grid)
+{
+	grid->cycles += grid->instructions_per_frame;
+	grid->frame_instructions = (uint16_t)grid->cycles;
+	grid->cycles -= grid->frame_instructions;
+	run_pool(grid->pool, step_tile, grid, grid->num_tiles);
+}
+
+//Copies the rows each machine changed since the last composition into the texel buffer, and clears its dirty set
+static void compose_tiles(GRID* grid)
+{
+	for (uint16_t i = 0; i < grid->num_tiles; i++)
+	{
+		MACHINE* machine = grid->machines[i];
+		DIRTY_SET dirty;
+		get_dirty(machine, &dirty);
+		clear_dirty(machine);
+		uint32_t* origin = grid->texels + (i / grid->columns * GRID_TILE_HEIGHT + GRID_BORDER) * grid->width + i % grid->columns * GRID_TILE_WIDTH + GRID_BORDER;
+		for (uint8_t y = 0; y < NUM_PIXEL_ROWS; y++)
+		{
+			if (!((dirty.rows >> y) & 1))
+			{
+				continue;
+			}
+			uint32_t* texel = origin + y * grid->width;
+			uint64_t row = machine->pixel_row[y];
+			for (uint8_t x = 0; x < NUM_PIXEL_COLS; x++)
+			{
+				texel[x] = (row >> (NUM_PIXEL_COLS - 1 - x)) & 1 ? grid->color_on : grid->color_off;
+			}
+		}
+	}
+	if (grid->focus_moved)
+	{
+		for (uint16_t i = 0; i < grid->num_tiles; i++)
+		{
+			draw_border(grid, i, i == grid->focus ? grid->color_focus : grid->color_border);
+		}
+		grid->focus_moved = false;
+	}
+}
+
+static void draw_border(GRID* grid, uint16_t tile, uint32_t color)
+{
+	uint32_t* origin = grid->texels + tile / grid->columns * GRID_TILE_HEIGHT * grid->width + tile % grid->columns * GRID_TILE_WIDTH;
+	for (uint16_t y = 0; y < GRID_TILE_HEIGHT; y++)
+	{
+		for (uint16_t x = 0; x < GRID_TILE_WIDTH; x++)
+		{
+			if (x < GRID_BORDER || x >= GRID_TILE_WIDTH - GRID_BORDER || y < GRID_BORDER || y >= GRID_TILE_HEIGHT - GRID_BORDER)
+			{
+				origin[y * grid->width + x] = color;
+			}
+		}
+	}
+}
+
+//A single upload of the whole buffer, however many tiles there are
+static void present_grid(GRID* grid)
+{
+	compose_tiles(grid);
+	ALLEGRO_LOCKED_REGION* region = al_lock_bitmap(grid->screen, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_WRITEONLY);
+	if (region)
+	{
+		for (uint16_t y = 0; y < grid->height; y++)
+		{
+			memcpy((uint8_t*)region->data + y * region->pitch, grid->texels + y * grid->width, grid->width * sizeof(uint32_t));
+		}
+		al_unlock_bitmap(grid->screen);
+	}
+	al_set_target_backbuffer(grid->display);
+	al_draw_scaled_bitmap(grid->screen, 0, 0, grid->width, grid->height, 0, 0, grid->width * grid->scale, grid->height * grid->scale, 0);
+	al_flip_display();
+}
+
+//Keys go to the focused machine. Moving the focus releases whatever was held on the machine it leaves.
+static void apply_grid_key(GRID* grid, ALLEGRO_EVENT event)
+{
+	bool pressed = event.type == ALLEGRO_EVENT_KEY_DOWN;
+	MACHINE* machine = grid->machines[grid->focus];
+	if (event.keyboard.keycode == GRID_FOCUS_KEY)
+	{
+		if (pressed)
+		{
+			memset(machine->key_pressed, false, sizeof(machine->key_pressed));
+			//Key down events carry no modifiers in Allegro, so shift is read from the keyboard state
+			ALLEGRO_KEYBOARD_STATE keyboard;
+			al_get_keyboard_state(&keyboard);
+			bool backwards = al_key_down(&keyboard, ALLEGRO_KEY_LSHIFT) || al_key_down(&keyboard, ALLEGRO_KEY_RSHIFT);
+			grid->focus = (grid->focus + (backwards ? grid->num_tiles - 1 : 1)) % grid->num_tiles;
+			grid->focus_moved = true;
+		}
+		return;
+	}
+	uint8_t value = lookup_key(&grid->keymap, event.keyboard.keycode);
+	if (value == UNMAPPED_KEY)
+	{
+		return;
+	}
+	machine->key_pressed[value] = pressed;
+	if (pressed && machine->waiting_for_input)
+	{
+		machine->input_received = true;
+	}
+}
+
+//Frames that fall behind are all emulated, but only the newest is presented
+void run_grid(GRID* grid)
+{
+	grid->on = true;
+	present_grid(grid);
+	al_start_timer(grid->frame_timer);
+	while (grid->on)
+	{
+		ALLEGRO_EVENT event;
+		al_wait_for_event(grid->event_queue, &event);
+		switch (event.type)
+		{
+		case ALLEGRO_EVENT_TIMER:
+			run_grid_frame(grid);
+			if (al_is_event_queue_empty(grid->event_queue))
+			{
+				present_grid(grid);
+			}
+			break;
+		case ALLEGRO_EVENT_KEY_DOWN:
+		case ALLEGRO_EVENT_KEY_UP:
+			apply_grid_key(grid, event);
+			break;
+		case ALLEGRO_EVENT_DISPLAY_CLOSE:
+			grid->on = false;
+			break;
+		}
+	}
+	al_stop_timer(grid->frame_timer);
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+﻿#include <stdio.h>
+#include <string.h>
+#include "struct_keymap.h"
+#include "struct_machine.h"
+
+void clear_keymap(KEYMAP* keymap)
+{
+	memset(keymap->values, UNMAPPED_KEY, sizeof(keymap->values));
+}
+
+void map_key(KEYMAP* keymap, int keycode, uint8_t value)
+{
+	if (keycode > 0 && keycode < ALLEGRO_KEY_MAX && value < KEYPAD_SIZE)
+	{
+		keymap->values[keycode] = value;
+	}
+}
+
+uint8_t lookup_key(const KEYMAP* keymap, int keycode)
+{
+	return keycode > 0 && keycode < ALLEGRO_KEY_MAX ? keymap->values[keycode] : UNMAPPED_KEY;
+}
+
+//Each line is "<hexadecimal keypad value> <key name>", with names as given by al_keycode_to_name, e.g. "A" or
+//"SPACE". Replaces the whole map, leaving it untouched if the file cannot be read.
+bool load_keymap(KEYMAP* keymap, const char* file_name)
+{
+	FILE* file = fopen(file_name, "r");
+	if (!file)
+	{
+		return false;
+	}
+	clear_keymap(keymap);
+	bool success = true;
+	char line[64];
+	while (fgets(line, sizeof(line), file))
+	{
+		unsigned int value;
+		char name[32];
+		if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0')
+		{
+			continue;
+		}
+		if (sscanf(line, "%x %31s", &value, name) != 2 || value >= KEYPAD_SIZE)
+		{
+			success = false;
+			continue;
+		}
+		int keycode = 1;
+		while (keycode < ALLEGRO_KEY_MAX && strcmp(al_keycode_to_name(keycode), name) != 0)
+		{
+			keycode++;
+		}
+		if (keycode == ALLEGRO_KEY_MAX)
+		{
+			success = false;
+			continue;
+		}
+		map_key(keymap, keycode, value);
+	}
+	fclose(file);
+	return success;
+}
\ No newline at end of file
@@ -1,179 +1,59 @@
-﻿#include <allegro5/allegro.h>
-#include <allegro5/allegro_primitives.h>
-#include <allegro5/allegro_image.h>
-#include <allegro5/allegro_audio.h>
-#include <allegro5/allegro_acodec.h>
-#include <allegro5/allegro_font.h>
-#include <allegro5/allegro_ttf.h>
-#include <allegro5/allegro_native_dialog.h>
-#include <assert.h>
+﻿#include <assert.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include "machine.h"
 #include "struct_machine.h"
-#include "struct_debug.h"
 #include "opcodes.h"
+#include "fusion.h"
+#include "recompiler.h"
+#include "struct_rom.h"
 #include <stdio.h>
 #include <stdbool.h>
-#include <time.h>
 
-static void prepare_display(MACHINE* machine, DISPLAY_OPTIONS display_options);
-static void prepare_window_options(MACHINE* machine);
-static void prepare_bitmaps(MACHINE* machine, DISPLAY_OPTIONS display_options);
-static void prepare_timers(MACHINE* machine);
-static void prepare_audio(MACHINE* machine);
-static void prepare_event_queue(MACHINE* machine);
-static void update_display(MACHINE* machine);
-static void update_counters(MACHINE* machine);
-static void handle_timer_events(MACHINE* machine, ALLEGRO_EVENT event);
-static void handle_keypad_events(MACHINE* machine, ALLEGRO_EVENT event);
-static void handle_display_events(MACHINE* machine, ALLEGRO_EVENT event);
-static void reset(MACHINE* machine);
-static void toggle_debug(MACHINE* machine, ALLEGRO_EVENT event);
-static void clear_registers(MACHINE* machine);
-
-static enum
-{
-	MENU_OPTIONS_ID = 1,
-	MENU_RESET_ID,
-	MENU_DEBUG_ID,
-	MENU_WRAP_Y_AXIS_ID
-};
-
-bool start_allegro()
-{
-	al_init();
-	al_install_keyboard();
-	al_install_audio();
-	al_init_acodec_addon();
-	al_init_primitives_addon();
-	al_init_image_addon();
-	al_init_font_addon();
-	al_init_ttf_addon();
-	al_init_native_dialog_addon();
-	return true;
-}
-
-bool end_allegro()
-{
-	/*al_uninstall_keyboard();
-	al_uninstall_audio();
-	al_shutdown_primitives_addon();
-	al_shutdown_image_addon();
-	al_shutdown_font_addon();
-	al_shutdown_ttf_addon();
-	al_shutdown_native_dialog_addon();*/
-	return true;
-}
-
-static void prepare_display(MACHINE* machine, DISPLAY_OPTIONS display_options)
-{
-	machine->display_options = display_options;
-	machine->display = al_create_display(DEFAULT_DISPLAY_WIDTH * display_options.scale, DEFAULT_DISPLAY_HEIGHT * display_options.scale);
-	assert(machine->display);
-	al_set_window_title(machine->display, "C8 - CHIP8 Emulator");
-}
-
-static void prepare_window_options(MACHINE* machine)
-{
-	ALLEGRO_MENU_INFO menu_info[] =
-	{
-		ALLEGRO_START_OF_MENU("Options", MENU_OPTIONS_ID),
-		{ "Reset", MENU_RESET_ID, 0, NULL},
-		{ "Debug window", MENU_DEBUG_ID, ALLEGRO_MENU_ITEM_CHECKBOX, NULL },
-		{ "Wrap Y axis", MENU_WRAP_Y_AXIS_ID, ALLEGRO_MENU_ITEM_CHECKBOX, NULL },
-		ALLEGRO_END_OF_MENU,
-		ALLEGRO_END_OF_MENU
-	};
-	ALLEGRO_MENU* display_menu = al_build_menu(menu_info);
-	al_set_display_menu(machine->display, display_menu);
-}
+//MACHINE is cache-line aligned, which malloc does not guarantee
+#ifdef _MSC_VER
+#define ALIGNED_ALLOC(alignment, size) _aligned_malloc(size, alignment)
+#define ALIGNED_FREE(pointer) _aligned_free(pointer)
+#else
+#define ALIGNED_ALLOC(alignment, size) aligned_alloc(alignment, size)
+#define ALIGNED_FREE(pointer) free(pointer)
+#endif
 
-static void prepare_bitmaps(MACHINE* machine, DISPLAY_OPTIONS display_options)
-{
-	machine->pixel_on = al_create_bitmap(display_options.scale, display_options.scale);
-	assert(machine->pixel_on);
-	al_set_target_bitmap(machine->pixel_on);
-	al_draw_filled_rectangle(0, 0, display_options.scale, display_options.scale, display_options.color_on);
-	machine->pixel_off = al_create_bitmap(display_options.scale, display_options.scale);
-	assert(machine->pixel_off);
-	al_set_target_bitmap(machine->pixel_off);
-	al_draw_filled_rectangle(0, 0, display_options.scale, display_options.scale, display_options.color_off);
-	al_set_target_backbuffer(machine->display);
-}
-
-static void prepare_timers(MACHINE* machine)
-{
-	machine->counter_timer = al_create_timer(DEFAULT_COUNTER_TIMER_PERIOD);
-	assert(machine->counter_timer);
-	al_start_timer(machine->counter_timer);
-	machine->opcode_timer = al_create_timer(DEFAULT_OPCODE_TIMER_PERIOD);
-	assert(machine->opcode_timer);
-	al_start_timer(machine->opcode_timer);
-}
-
-static void prepare_audio(MACHINE* machine)
-{
-	machine->beep = al_load_sample("resources/sound.wav");
-	assert(machine->beep);
-	al_reserve_samples(1);
-	machine->beep_playing = false;
-}
-
-static void prepare_event_queue(MACHINE* machine)
-{
-	machine->event_queue = al_create_event_queue();
-	assert(machine->event_queue);
-	al_register_event_source(machine->event_queue, al_get_keyboard_event_source());
-	al_register_event_source(machine->event_queue, al_get_display_event_source(machine->display));
-	al_register_event_source(machine->event_queue, al_get_timer_event_source(machine->counter_timer));
-	al_register_event_source(machine->event_queue, al_get_timer_event_source(machine->opcode_timer));
-	al_register_event_source(machine->event_queue, al_get_default_menu_event_source());
-}
+static void clear_registers(MACHINE* machine);
+static void keep_program_copy(MACHINE* machine, const char* name, const uint8_t* data, uint16_t size);
+static void start_loaded_program(MACHINE* machine);
 
-MACHINE* create_machine(DISPLAY_OPTIONS display_options)
+//A machine without display, audio, timers or debugger, stepped directly through machine->step
+MACHINE* create_headless_machine()
 {
-	MACHINE* machine = calloc(sizeof(MACHINE), 1);
+	MACHINE* machine = ALIGNED_ALLOC(_Alignof(MACHINE), sizeof(MACHINE));
 	assert(machine);
+	memset(machine, 0, sizeof(MACHINE));
 	machine->on = true;
 	machine->y_wrap_enabled = false;
+	machine->fusion_enabled = true;
+	seed_machine(machine, DEFAULT_RANDOM_SEED);
 	clear_registers(machine);
-	memset(machine->key_pressed, false, sizeof(bool) * KEYPAD_WIDTH * KEYPAD_HEIGHT);
+	memset(machine->key_pressed, false, sizeof(bool) * KEYPAD_SIZE);
 
 	uint8_t font[FONT_MEMORY_SIZE] = DEFAULT_FONT_MEMORY_CONTENT;
 	set_font(machine, font);
-
-	INPUT_KEY** keypad = create_default_keypad();
-	set_keypad(machine, keypad);
-
-	prepare_display(machine, display_options);
-	prepare_window_options(machine);
-	prepare_bitmaps(machine, display_options);
-	prepare_timers(machine);
-	prepare_audio(machine);
-	prepare_event_queue(machine);
-	machine->debug = create_debug(machine);
-	srand(time(NULL));
+	update_step_function(machine);
 	return machine;
 }
 
 void delete_machine(MACHINE* machine)
 {
-	al_destroy_event_queue(machine->event_queue);
-	al_destroy_bitmap(machine->pixel_on);
-	al_destroy_bitmap(machine->pixel_off);
-	al_destroy_timer(machine->counter_timer);
-	al_destroy_timer(machine->opcode_timer);
-	al_destroy_sample(machine->beep);
-	al_destroy_display(machine->display);
-	for (uint8_t i = 0; i < KEYPAD_HEIGHT; i++)
+	if (machine->frontend)
 	{
-		free(machine->keypad[i]);
+		machine->delete_frontend(machine);
 	}
-	free(machine->keypad);
-	delete_debug(machine->debug);
-	free(machine);
+	delete_analysis(machine->analysis);
+	free(machine->program_data);
+	free(machine->fusion);
+	free(machine->program_name);
+	ALIGNED_FREE(machine);
 }
 
 void set_font(MACHINE* machine, int8_t* font)
@@ -181,174 +61,139 @@ void set_font(MACHINE* machine, int8_t* font)
 	memcpy(machine->RAM + FONT_MEMORY_BASE_ADDRESS, font, FONT_MEMORY_SIZE);
 }
 
-INPUT_KEY** create_default_keypad()
-{
-	INPUT_KEY** keypad = malloc(sizeof(INPUT_KEY*) * KEYPAD_HEIGHT);
-	if (!keypad) return NULL;
-	for (uint8_t i = 0; i < KEYPAD_HEIGHT; i++)
-	{
-		keypad[i] = malloc(sizeof(INPUT_KEY) * KEYPAD_WIDTH);
-		if (!keypad[i]) return NULL;
-	}
-	keypad[0][0] = (INPUT_KEY){ 1, ALLEGRO_KEY_1 };
-	keypad[0][1] = (INPUT_KEY){ 2, ALLEGRO_KEY_2 };
-	keypad[0][2] = (INPUT_KEY){ 3, ALLEGRO_KEY_3 };
-	keypad[0][3] = (INPUT_KEY){ 12, ALLEGRO_KEY_4 };
-	keypad[1][0] = (INPUT_KEY){ 4, ALLEGRO_KEY_Q };
-	keypad[1][1] = (INPUT_KEY){ 5, ALLEGRO_KEY_W };
-	keypad[1][2] = (INPUT_KEY){ 6, ALLEGRO_KEY_E };
-	keypad[1][3] = (INPUT_KEY){ 13, ALLEGRO_KEY_R };
-	keypad[2][0] = (INPUT_KEY){ 7, ALLEGRO_KEY_A };
-	keypad[2][1] = (INPUT_KEY){ 8, ALLEGRO_KEY_S };
-	keypad[2][2] = (INPUT_KEY){ 9, ALLEGRO_KEY_D };
-	keypad[2][3] = (INPUT_KEY){ 14, ALLEGRO_KEY_F };
-	keypad[3][0] = (INPUT_KEY){ 10, ALLEGRO_KEY_Z };
-	keypad[3][1] = (INPUT_KEY){ 0, ALLEGRO_KEY_X };
-	keypad[3][2] = (INPUT_KEY){ 11, ALLEGRO_KEY_C };
-	keypad[3][3] = (INPUT_KEY){ 15, ALLEGRO_KEY_V };
-	return keypad;
-}
-
-void set_keypad(MACHINE* machine, INPUT_KEY** keypad)
-{
-	machine->keypad = keypad;
-}
-
 void load_program(MACHINE* machine, const char* file_name)
 {
 	FILE* file = fopen(file_name, "rb");
+	assert(file);
 	fseek(file, 0, SEEK_END);
-	uint16_t file_size = ftell(file);
+	long file_size = ftell(file);
 	fseek(file, 0, SEEK_SET);
-	fread(machine->RAM + PROGRAM_BASE_ADDRESS, BYTE_SIZE, file_size, file);
+	if (file_size > RAM_SIZE - PROGRAM_BASE_ADDRESS)
+	{
+		file_size = RAM_SIZE - PROGRAM_BASE_ADDRESS;
+	}
+	uint8_t* data = malloc(file_size);
+	assert(data);
+	file_size = fread(data, BYTE_SIZE, file_size, file);
 	fclose(file);
-	uint16_t opcode = *(uint16_t*)(machine->RAM + machine->pc_reg);
-	opcode = ((opcode >> 8) & 0x00FF) | (opcode << 8);
-	machine->current_opcode = opcode;
-	machine->program_name = file_name;
+	load_program_data(machine, file_name, data, file_size);
+	free(data);
 }
 
-static void update_display(MACHINE* machine)
+void load_program_data(MACHINE* machine, const char* name, const uint8_t* data, uint16_t size)
 {
-	al_set_target_backbuffer(machine->display);
-	uint16_t x = 0;
-	for (uint64_t i = (uint64_t)1 << 63; i > 0; i >>= 1)
+	if (size > RAM_SIZE - PROGRAM_BASE_ADDRESS)
 	{
-		uint16_t y = 0;
-		for (uint8_t j = 0; j < NUM_PIXEL_ROWS; j++)
-		{
-			if ((machine->pixel_row[j] & i) != 0)
-			{
-				al_draw_bitmap(machine->pixel_on, x, y, 0);
-			}
-			else
-			{
-				al_draw_bitmap(machine->pixel_off, x, y, 0);
-			}
-			y += machine->display_options.scale;
-		}
-		x += machine->display_options.scale;
+		size = RAM_SIZE - PROGRAM_BASE_ADDRESS;
 	}
+	memcpy(machine->RAM + PROGRAM_BASE_ADDRESS, data, size);
+	keep_program_copy(machine, name, data, size);
+	delete_analysis(machine->analysis);
+	machine->analysis = analyze_program((uint8_t*)machine->RAM, PROGRAM_BASE_ADDRESS, size);
+	free(machine->fusion);
+	machine->fusion = build_fusion_table(machine->analysis, (uint8_t*)machine->RAM);
+	start_loaded_program(machine);
 }
 
-static void update_counters(MACHINE* machine)
+//Replaces the running program with a prepared image and starts it from a cleared RAM, without analysing it again.
+//Only core state changes, so a frontend keeps its window, timers and audio. The image is copied, not kept.
+void switch_program(MACHINE* machine, const ROM_IMAGE* image)
 {
-	if (machine->d_counter > 0)
-	{
-		machine->d_counter--;
-	}
-	if (machine->s_counter > 0)
-	{
-		if (!machine->beep_playing)
-		{
-			al_play_sample(machine->beep, 1, 0, 1, ALLEGRO_PLAYMODE_LOOP, &machine->beep_id);
-			machine->beep_playing = true;
-		}
-		machine->s_counter--;
-	}
-	else if (machine->beep_playing)
+	memset(machine->RAM, 0, sizeof(machine->RAM));
+	uint8_t font[FONT_MEMORY_SIZE] = DEFAULT_FONT_MEMORY_CONTENT;
+	set_font(machine, font);
+	clear_registers(machine);
+	memcpy(machine->RAM + PROGRAM_BASE_ADDRESS, image->data, image->size);
+	keep_program_copy(machine, image->name, image->data, image->size);
+	delete_analysis(machine->analysis);
+	machine->analysis = copy_analysis(image->analysis);
+	if (!machine->fusion)
 	{
-		machine->beep_playing = false;
-		al_stop_sample(&machine->beep_id);
+		machine->fusion = malloc(RAM_SIZE);
+		assert(machine->fusion);
 	}
+	memcpy(machine->fusion, image->fusion, RAM_SIZE);
+	start_loaded_program(machine);
 }
 
-static void handle_timer_events(MACHINE* machine, ALLEGRO_EVENT event)
+static void keep_program_copy(MACHINE* machine, const char* name, const uint8_t* data, uint16_t size)
 {
-	if(event.type != ALLEGRO_EVENT_TIMER)
-	{
-		return;
-	}
-	if (event.timer.source == machine->opcode_timer)
+	if (data != machine->program_data)
 	{
-		uint16_t opcode = fetch_opcode(machine);
-		execute_opcode(machine, opcode);
+		free(machine->program_data);
+		machine->program_data = malloc(size + 1);
+		assert(machine->program_data);
+		memcpy(machine->program_data, data, size);
 	}
-	else if (event.timer.source == machine->counter_timer)
+	if (name != machine->program_name)
 	{
-		update_counters(machine);
-		update_display(machine);
-		al_set_target_backbuffer(machine->display);
-		al_flip_display();
+		free(machine->program_name);
+		machine->program_name = malloc(strlen(name) + 1);
+		assert(machine->program_name);
+		strcpy(machine->program_name, name);
 	}
+	machine->program_size = size;
 }
 
-static void handle_keypad_events(MACHINE* machine, ALLEGRO_EVENT event)
+static void start_loaded_program(MACHINE* machine)
 {
-	if (event.type != ALLEGRO_EVENT_KEY_DOWN && event.type != ALLEGRO_EVENT_KEY_UP)
+	machine->pending_cycles = 0;
+	if (machine->recompiled && !set_recompiled_program(machine, machine->recompiled))
 	{
-		return;
-	}
-	for (uint8_t i = 0; i < KEYPAD_HEIGHT; i++)
-	{
-		for (uint8_t j = 0; j < KEYPAD_WIDTH; j++)
-		{
-			if (event.keyboard.keycode == machine->keypad[i][j].keycode)
-			{
-				machine->key_pressed[machine->keypad[i][j].value] = (event.type == ALLEGRO_EVENT_KEY_DOWN);
-				if (machine->waiting_for_input && event.type == ALLEGRO_EVENT_KEY_DOWN)
-				{
-					machine->input_received = true;
-				}
-				return;
-			}
-		}
+		set_recompiled_program(machine, NULL);
 	}
+	mark_all_dirty(machine);
+	update_step_function(machine);
+	uint8_t* memory = RAM_AT(machine, machine->pc_reg);
+	machine->current_opcode = (memory[0] << 8) | memory[1];
+}
+
+void reset_machine(MACHINE* machine)
+{
+	uint8_t font[FONT_MEMORY_SIZE] = DEFAULT_FONT_MEMORY_CONTENT;
+	set_font(machine, font);
+	clear_registers(machine);
+	load_program_data(machine, machine->program_name, machine->program_data, machine->program_size);
+}
+
+void seed_machine(MACHINE* machine, uint32_t seed)
+{
+	machine->random_state = seed ? seed : DEFAULT_RANDOM_SEED;
 }
 
-static void handle_display_events(MACHINE* machine, ALLEGRO_EVENT event)
+//Holds the keys in a keypad mask, bit k for key k, for headless runs that replay recorded or scripted input. A key
+//that was not held before is the input an FX0A is waiting for.
+void press_keypad(MACHINE* machine, uint16_t keys)
 {
-	if (event.display.source != machine->display && event.user.data2 != (intptr_t)machine->display)
+	bool pressed = false;
+	for (uint8_t i = 0; i < KEYPAD_SIZE; i++)
 	{
-		return;
+		bool down = (keys >> i) & 1;
+		pressed |= down && !machine->key_pressed[i];
+		machine->key_pressed[i] = down;
 	}
-	switch (event.type)
+	if (pressed && machine->waiting_for_input)
 	{
-	case ALLEGRO_EVENT_DISPLAY_CLOSE:
-		machine->on = false;
-		break;
-	case ALLEGRO_EVENT_MENU_CLICK:
-		switch (event.user.data1)
-		{
-		case MENU_RESET_ID:
-			reset(machine);
-			break;
-		case MENU_DEBUG_ID:
-			toggle_debug(machine, event);
-			break;
-		case MENU_WRAP_Y_AXIS_ID:
-			machine->y_wrap_enabled = al_get_menu_item_flags(al_get_display_menu(machine->display), MENU_WRAP_Y_AXIS_ID) & ALLEGRO_MENU_ITEM_CHECKED;
-			break;
-		}
+		machine->input_received = true;
 	}
 }
 
-static void reset(MACHINE* machine)
+//Brings destination to the exact state of source, which must have the same program loaded. Allocates nothing, so
+//it can restart or snapshot a machine as often as needed.
+void copy_machine(MACHINE* destination, const MACHINE* source)
 {
-	uint8_t font[FONT_MEMORY_SIZE] = DEFAULT_FONT_MEMORY_CONTENT;
-	set_font(machine, font);
-	clear_registers(machine);
-	load_program(machine, machine->program_name);
+	uint8_t* fusion = destination->fusion;
+	bool hooks_armed = destination->hooks_armed;
+	memcpy(destination, source, offsetof(MACHINE, recompiled));
+	memcpy(destination->return_predictions, source->return_predictions, sizeof(destination->return_predictions));
+	destination->fusion = fusion;
+	destination->hooks_armed = hooks_armed;
+	if (fusion && source->fusion)
+	{
+		memcpy(fusion, source->fusion, RAM_SIZE);
+	}
+	mark_all_dirty(destination);
+	update_step_function(destination);
 }
 
 static void clear_registers(MACHINE* machine)
@@ -361,7 +206,9 @@ static void clear_registers(MACHINE* machine)
 	{
 		machine->v_reg[i] = 0;
 	}
-	machine->s_reg = STACK_BASE_ADDRESS;
+	machine->s_reg = 0;
+	machine->fault = FAULT_NONE;
+	machine->out_of_bounds = 0;
 	machine->pc_reg = PROGRAM_BASE_ADDRESS;
 	machine->i_reg = 0;
 	machine->d_counter = 0;
@@ -370,29 +217,27 @@ static void clear_registers(MACHINE* machine)
 	machine->input_received = 0;
 }
 
-static void toggle_debug(MACHINE* machine, ALLEGRO_EVENT event)
+void set_trace(MACHINE* machine, TRACE* trace)
 {
-	bool checked = al_get_menu_item_flags((ALLEGRO_MENU*)event.user.data3, MENU_DEBUG_ID) & ALLEGRO_MENU_ITEM_CHECKED;
-	if (checked)
-	{
-		start_debug_thread(machine->debug);
-	}
-	else
-	{
-		end_debug_thread(machine->debug);
-	}
+	machine->trace = trace;
+	update_step_function(machine);
 }
 
-void run_program(MACHINE* machine)
+//Consumers that keep their own copy of the machine, such as save states, rewind or renderers, read the set and clear
+//it once they have caught up. There is a single set per machine, so only one consumer should clear it.
+void get_dirty(const MACHINE* machine, DIRTY_SET* dirty)
 {
-	while (machine->on)
-	{
-		ALLEGRO_EVENT event;
-		al_wait_for_event(machine->event_queue, &event);
-		al_lock_mutex(machine->debug->event_mutex);
-		handle_keypad_events(machine, event);
-		handle_timer_events(machine, event);
-		handle_display_events(machine, event);
-		al_unlock_mutex(machine->debug->event_mutex);
-	}
+	*dirty = machine->dirty;
+}
+
+void clear_dirty(MACHINE* machine)
+{
+	memset(&machine->dirty, 0, sizeof(machine->dirty));
+}
+
+void mark_all_dirty(MACHINE* machine)
+{
+	machine->dirty.lines = ~(uint64_t)0;
+	machine->dirty.rows = ALL_DIRTY_ROWS;
+	machine->dirty.stack = ~(uint32_t)0;
 }
\ No newline at end of file
@@ -0,0 +1,311 @@
+﻿#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "struct_metrics.h"
+#ifdef _WIN32
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+#define close_socket closesocket
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#define close_socket close
+#endif
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static void reset_interval(METRICS* metrics, double now);
+static float percentile(const float* sorted, uint32_t count, uint8_t percent);
+static int compare_floats(const void* a, const void* b);
+static void write_metrics(METRICS* metrics);
+static void accept_metrics_clients(METRICS* metrics);
+static void set_nonblocking(METRICS_SOCKET handle);
+
+METRICS* create_metrics(double interval)
+{
+	METRICS* metrics = calloc(1, sizeof(METRICS));
+	assert(metrics);
+	metrics->interval = interval > 0 ? interval : DEFAULT_METRICS_INTERVAL;
+	metrics->listener = NO_METRICS_SOCKET;
+	for (uint8_t i = 0; i < MAX_METRICS_CLIENTS; i++)
+	{
+		metrics->clients[i] = NO_METRICS_SOCKET;
+	}
+	return metrics;
+}
+
+void delete_metrics(METRICS* metrics)
+{
+	if (metrics->file)
+	{
+		fclose(metrics->file);
+	}
+	for (uint8_t i = 0; i < MAX_METRICS_CLIENTS; i++)
+	{
+		if (metrics->clients[i] != NO_METRICS_SOCKET)
+		{
+			close_socket(metrics->clients[i]);
+		}
+	}
+	if (metrics->listener != NO_METRICS_SOCKET)
+	{
+		close_socket(metrics->listener);
+		remove(metrics->socket_path);
+#ifdef _WIN32
+		WSACleanup();
+#endif
+	}
+	free(metrics->socket_path);
+	free(metrics);
+}
+
+//Appends a line per snapshot, as JSON when the name ends in .json and as CSV with a header otherwise
+bool open_metrics_file(METRICS* metrics, const char* file_name)
+{
+	FILE* file = fopen(file_name, "w");
+	if (!file)
+	{
+		return false;
+	}
+	if (metrics->file)
+	{
+		fclose(metrics->file);
+	}
+	size_t length = strlen(file_name);
+	metrics->file = file;
+	metrics->format = length >= 5 && strcmp(file_name + length - 5, ".json") == 0 ? METRICS_JSON : METRICS_CSV;
+	if (metrics->format == METRICS_CSV)
+	{
+		fprintf(file, "time,ips,frame_ms_mean,frame_ms_p50,frame_ms_p95,frame_ms_p99,frame_ms_max,display_ms,emulation_ms,"
+			"queue_depth_mean,queue_depth_max,dropped_ticks,beeper_toggles,frames\n");
+	}
+	return true;
+}
+
+//Listens on a UNIX domain socket at path, replacing a stale one. Clients are accepted and written to only from
+//update_metrics, without ever blocking; a client that falls behind is dropped.
+bool open_metrics_socket(METRICS* metrics, const char* path)
+{
+	struct sockaddr_un address;
+	if (metrics->listener != NO_METRICS_SOCKET || strlen(path) >= sizeof(address.sun_path))
+	{
+		return false;
+	}
+#ifdef _WIN32
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+	{
+		return false;
+	}
+#endif
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+	remove(path);
+	METRICS_SOCKET listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener == NO_METRICS_SOCKET || bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, MAX_METRICS_CLIENTS) != 0)
+	{
+		if (listener != NO_METRICS_SOCKET)
+		{
+			close_socket(listener);
+		}
+#ifdef _WIN32
+		WSACleanup();
+#endif
+		return false;
+	}
+	set_nonblocking(listener);
+	metrics->listener = listener;
+	metrics->socket_path = malloc(strlen(path) + 1);
+	assert(metrics->socket_path);
+	strcpy(metrics->socket_path, path);
+	return true;
+}
+
+void count_instructions(METRICS* metrics, uint32_t count, double seconds)
+{
+	metrics->instructions += count;
+	metrics->emulation_seconds += seconds;
+}
+
+//now is when the frame was presented, and display_seconds how long presenting it took
+void count_frame(METRICS* metrics, double now, double display_seconds)
+{
+	if (metrics->last_frame > 0)
+	{
+		double frame_time = now - metrics->last_frame;
+		if (metrics->frames < MAX_METRICS_FRAMES)
+		{
+			metrics->frame_times[metrics->frames] = (float)(frame_time * 1000);
+		}
+		metrics->frames++;
+		metrics->frame_total += frame_time;
+	}
+	metrics->last_frame = now;
+	metrics->display_seconds += display_seconds;
+}
+
+void count_queue_depth(METRICS* metrics, uint32_t depth)
+{
+	metrics->queue_depth_total += depth;
+	metrics->queue_depth_samples++;
+	metrics->queue_depth_max = depth > metrics->queue_depth_max ? depth : metrics->queue_depth_max;
+}
+
+void count_dropped_ticks(METRICS* metrics, uint32_t count)
+{
+	metrics->dropped_ticks += count;
+}
+
+void count_beeper_toggle(METRICS* metrics)
+{
+	metrics->beeper_toggles++;
+}
+
+//Closes the interval once it has lasted long enough, publishing its snapshot. Returns whether it did.
+bool update_metrics(METRICS* metrics, double now)
+{
+	if (metrics->interval_start == 0)
+	{
+		reset_interval(metrics, now);
+		return false;
+	}
+	double elapsed = now - metrics->interval_start;
+	if (elapsed < metrics->interval)
+	{
+		return false;
+	}
+	METRICS_SNAPSHOT* snapshot = &metrics->snapshot;
+	uint32_t kept = metrics->frames < MAX_METRICS_FRAMES ? metrics->frames : MAX_METRICS_FRAMES;
+	qsort(metrics->frame_times, kept, sizeof(float), compare_floats);
+	snapshot->time = now;
+	snapshot->instructions_per_second = metrics->instructions / elapsed;
+	snapshot->frame_ms_mean = metrics->frames ? 1000 * metrics->frame_total / metrics->frames : 0;
+	snapshot->frame_ms_p50 = percentile(metrics->frame_times, kept, 50);
+	snapshot->frame_ms_p95 = percentile(metrics->frame_times, kept, 95);
+	snapshot->frame_ms_p99 = percentile(metrics->frame_times, kept, 99);
+	snapshot->frame_ms_max = kept ? metrics->frame_times[kept - 1] : 0;
+	snapshot->display_ms = 1000 * metrics->display_seconds;
+	snapshot->emulation_ms = 1000 * metrics->emulation_seconds;
+	snapshot->queue_depth_mean = metrics->queue_depth_samples ? (double)metrics->queue_depth_total / metrics->queue_depth_samples : 0;
+	snapshot->queue_depth_max = metrics->queue_depth_max;
+	snapshot->dropped_ticks = metrics->dropped_ticks;
+	snapshot->beeper_toggles = metrics->beeper_toggles;
+	snapshot->frames = metrics->frames;
+	write_metrics(metrics);
+	reset_interval(metrics, now);
+	return true;
+}
+
+const METRICS_SNAPSHOT* get_metrics_snapshot(const METRICS* metrics)
+{
+	return &metrics->snapshot;
+}
+
+void format_metrics_json(const METRICS_SNAPSHOT* snapshot, char* text, uint32_t size)
+{
+	snprintf(text, size, "{\"time\":%.3f,\"ips\":%.1f,\"frame_ms_mean\":%.3f,\"frame_ms_p50\":%.3f,\"frame_ms_p95\":%.3f,"
+		"\"frame_ms_p99\":%.3f,\"frame_ms_max\":%.3f,\"display_ms\":%.3f,\"emulation_ms\":%.3f,\"queue_depth_mean\":%.2f,"
+		"\"queue_depth_max\":%u,\"dropped_ticks\":%u,\"beeper_toggles\":%u,\"frames\":%u}\n",
+		snapshot->time, snapshot->instructions_per_second, snapshot->frame_ms_mean, snapshot->frame_ms_p50,
+		snapshot->frame_ms_p95, snapshot->frame_ms_p99, snapshot->frame_ms_max, snapshot->display_ms, snapshot->emulation_ms,
+		snapshot->queue_depth_mean, snapshot->queue_depth_max, snapshot->dropped_ticks, snapshot->beeper_toggles, snapshot->frames);
+}
+
+//The last frame of an interval stays the reference for the first frame time of the next one
+static void reset_interval(METRICS* metrics, double now)
+{
+	metrics->interval_start = now;
+	metrics->instructions = 0;
+	metrics->emulation_seconds = 0;
+	metrics->display_seconds = 0;
+	metrics->frame_total = 0;
+	metrics->frames = 0;
+	metrics->queue_depth_total = 0;
+	metrics->queue_depth_samples = 0;
+	metrics->queue_depth_max = 0;
+	metrics->dropped_ticks = 0;
+	metrics->beeper_toggles = 0;
+}
+
+//Nearest rank
+static float percentile(const float* sorted, uint32_t count, uint8_t percent)
+{
+	if (count == 0)
+	{
+		return 0;
+	}
+	uint32_t rank = (count * percent + 99) / 100;
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static int compare_floats(const void* a, const void* b)
+{
+	float x = *(const float*)a;
+	float y = *(const float*)b;
+	return (x > y) - (x < y);
+}
+
+static void write_metrics(METRICS* metrics)
+{
+	const METRICS_SNAPSHOT* snapshot = &metrics->snapshot;
+	char line[METRICS_LINE_SIZE];
+	format_metrics_json(snapshot, line, sizeof(line));
+	if (metrics->file && metrics->format == METRICS_JSON)
+	{
+		fputs(line, metrics->file);
+		fflush(metrics->file);
+	}
+	else if (metrics->file)
+	{
+		fprintf(metrics->file, "%.3f,%.1f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.2f,%u,%u,%u,%u\n", snapshot->time,
+			snapshot->instructions_per_second, snapshot->frame_ms_mean, snapshot->frame_ms_p50, snapshot->frame_ms_p95,
+			snapshot->frame_ms_p99, snapshot->frame_ms_max, snapshot->display_ms, snapshot->emulation_ms, snapshot->queue_depth_mean,
+			snapshot->queue_depth_max, snapshot->dropped_ticks, snapshot->beeper_toggles, snapshot->frames);
+		fflush(metrics->file);
+	}
+	if (metrics->listener == NO_METRICS_SOCKET)
+	{
+		return;
+	}
+	accept_metrics_clients(metrics);
+	int length = (int)strlen(line);
+	for (uint8_t i = 0; i < MAX_METRICS_CLIENTS; i++)
+	{
+		if (metrics->clients[i] != NO_METRICS_SOCKET && send(metrics->clients[i], line, length, MSG_NOSIGNAL) != length)
+		{
+			close_socket(metrics->clients[i]);
+			metrics->clients[i] = NO_METRICS_SOCKET;
+		}
+	}
+}
+
+static void accept_metrics_clients(METRICS* metrics)
+{
+	for (uint8_t i = 0; i < MAX_METRICS_CLIENTS; i++)
+	{
+		if (metrics->clients[i] != NO_METRICS_SOCKET)
+		{
+			continue;
+		}
+		METRICS_SOCKET client = accept(metrics->listener, NULL, NULL);
+		if (client == NO_METRICS_SOCKET)
+		{
+			return;
+		}
+		set_nonblocking(client);
+		metrics->clients[i] = client;
+	}
+}
+
+static void set_nonblocking(METRICS_SOCKET handle)
+{
+#ifdef _WIN32
+	u_long enabled = 1;
+	ioctlsocket(handle, FIONBIO, &enabled);
+#else
+	fcntl(handle, F_SETFL, fcntl(handle, F_GETFL) | O_NONBLOCK);
+#endif
+}
\ No newline at end of file
@@ -1,10 +1,15 @@
 ﻿#include <stdio.h>
-#include <allegro5/allegro_native_dialog.h>
+#include <stdlib.h>
+#include <string.h>
 #include "struct_machine.h"
-#include "struct_debug.h"
+#include "struct_trace.h"
+#include "recompiler.h"
+#include "fusion.h"
+#include "sprite.h"
 
-static void op_push_to_stack(MACHINE* machine);
+static bool op_push_to_stack(MACHINE* machine);
 static void op_jump(MACHINE* machine, uint16_t opcode);
+static void op_call_subroutine(MACHINE* machine, uint16_t opcode);
 static void op_do_if_not_equal_to_constant(MACHINE* machine, uint16_t opcode);
 static void op_do_if_equal_to_constant(MACHINE* machine, uint16_t opcode);
 static void op_do_if_not_equal_to_variable(MACHINE* machine, uint16_t opcode);
@@ -39,16 +44,34 @@ static void op_shift_left(MACHINE* machine, uint16_t opcode);
 static void op_handle_variable_arithmetic(MACHINE* machine, uint16_t opcode);
 static void op_return_from_subroutine(MACHINE* machine, uint16_t opcode);
 static void op_clear_screen(MACHINE* machine, uint16_t opcode);
+static void op_unknown(MACHINE* machine, uint16_t opcode);
 static void op_handle_base_instructions(MACHINE* machine, uint16_t opcode);
-static void op_draw_sprite(MACHINE* machine, uint16_t opcode);
+void op_draw_sprite(MACHINE* machine, uint16_t opcode);
+static void mark_rows_dirty(MACHINE* machine, uint8_t y, uint8_t height);
+static uint16_t read_opcode(MACHINE* machine);
+static void step_halted(MACHINE* machine);
+static void invalidate_fusion(MACHINE* machine, uint16_t address, uint8_t length);
+static uint8_t execute_fused(MACHINE* machine, uint8_t kind);
 uint16_t fetch_opcode(MACHINE* machine);
 void execute_opcode(MACHINE* machine, uint16_t opcode);
-void opcode_to_string(char* buffer, uint16_t opcode);
+void step_opcode(MACHINE* machine);
+void step_opcode_hooked(MACHINE* machine);
+void step_fused(MACHINE* machine);
+void update_step_function(MACHINE* machine);
+void raise_fault(MACHINE* machine, MACHINE_FAULT fault, uint16_t address);
+const char* fault_to_string(MACHINE_FAULT fault);
+void mirror_ram_writes(MACHINE* machine, uint16_t address, uint8_t length);
 
-static void op_push_to_stack(MACHINE* machine)
+static bool op_push_to_stack(MACHINE* machine)
 {
-	STEP_BACK(machine->s_reg);
-	*(int16_t*)(machine->RAM + machine->s_reg) = machine->pc_reg;
+	if (machine->s_reg >= STACK_DEPTH)
+	{
+		raise_fault(machine, FAULT_STACK_OVERFLOW, machine->pc_reg - MEM_STEP);
+		return false;
+	}
+	machine->dirty.stack |= 1u << machine->s_reg;
+	machine->stack[machine->s_reg++] = machine->pc_reg;
+	return true;
 }
 
 static void op_jump(MACHINE* machine, uint16_t opcode)
@@ -57,6 +80,14 @@ static void op_jump(MACHINE* machine, uint16_t opcode)
 	machine->pc_reg = nnn;
 }
 
+static void op_call_subroutine(MACHINE* machine, uint16_t opcode)
+{
+	if (op_push_to_stack(machine))
+	{
+		op_jump(machine, opcode);
+	}
+}
+
 static void op_do_if_not_equal_to_constant(MACHINE* machine, uint16_t opcode)
 {
 	uint8_t vx = machine->v_reg[GET_X(opcode)];
@@ -119,7 +150,12 @@ static void op_assign_random(MACHINE* machine, uint16_t opcode)
 {
 	uint8_t* vx = &(machine->v_reg[GET_X(opcode)]);
 	uint8_t nn = GET_NN(opcode);
-	*vx = rand() % 256 & nn;
+	uint32_t state = machine->random_state;
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	machine->random_state = state;
+	*vx = (state >> 24) & nn;
 }
 
 static void op_do_if_key_not_pressed(MACHINE* machine, uint16_t opcode)
@@ -151,6 +187,10 @@ static void op_handle_key_presses(MACHINE* machine, uint16_t opcode)
 	{
 		op_do_if_key_pressed(machine, opcode);
 	}
+	else
+	{
+		op_unknown(machine, opcode);
+	}
 }
 
 static void op_assign_from_d_counter(MACHINE* machine, uint16_t opcode)
@@ -170,18 +210,15 @@ static void op_wait_for_key_press(MACHINE* machine, uint16_t opcode)
 	}
 	else if(machine->input_received)
 	{
-		for (uint8_t i = 0; i < KEYPAD_HEIGHT; i++)
+		for (uint8_t i = 0; i < KEYPAD_SIZE; i++)
 		{
-			for (uint8_t j = 0; j < KEYPAD_WIDTH; j++)
+			if (machine->key_pressed[i])
 			{
-				if (machine->key_pressed[machine->keypad[i][j].value])
-				{
-					*vx = machine->keypad[i][j].value;
-					machine->input_received = false;
-					machine->waiting_for_input = false;
-					STEP(machine->pc_reg);
-					return;
-				}
+				*vx = i;
+				machine->input_received = false;
+				machine->waiting_for_input = false;
+				STEP(machine->pc_reg);
+				return;
 			}
 		}
 	}
@@ -214,26 +251,34 @@ static void op_assign_char_address_to_i(MACHINE* machine, uint16_t opcode)
 static void op_store_bcd(MACHINE* machine, uint16_t opcode)
 {
 	uint8_t vx = machine->v_reg[GET_X(opcode)];
-	machine->RAM[machine->i_reg] = vx / 100;
-	machine->RAM[machine->i_reg + 1] = (vx / 10) % 10;
-	machine->RAM[machine->i_reg + 2] = vx % 10;
+	uint8_t* memory = RAM_AT(machine, machine->i_reg);
+	memory[0] = vx / 100;
+	memory[1] = (vx / 10) % 10;
+	memory[2] = vx % 10;
+	mirror_ram_writes(machine, machine->i_reg, 3);
+	invalidate_fusion(machine, machine->i_reg, 3);
 }
 
 static void op_store_registers(MACHINE* machine, uint16_t opcode)
 {
 	uint8_t x = GET_X(opcode);
+	uint8_t* memory = RAM_AT(machine, machine->i_reg);
 	for (uint8_t i = 0; i <= x; i++)
 	{
-		machine->RAM[machine->i_reg + i] = machine->v_reg[i];
+		memory[i] = machine->v_reg[i];
 	}
+	mirror_ram_writes(machine, machine->i_reg, x + 1);
+	invalidate_fusion(machine, machine->i_reg, x + 1);
 }
 
 static void op_load_registers(MACHINE* machine, uint16_t opcode)
 {
 	uint8_t x = GET_X(opcode);
+	uint8_t* memory = RAM_AT(machine, machine->i_reg);
+	COUNT_OUT_OF_BOUNDS(machine, machine->i_reg, x + 1);
 	for (uint8_t i = 0; i <= x; i++)
 	{
-		machine->v_reg[i] = machine->RAM[machine->i_reg + i];
+		machine->v_reg[i] = memory[i];
 	}
 }
 
@@ -270,6 +315,7 @@ static void op_handle_special_registers(MACHINE* machine, uint16_t opcode)
 		op_load_registers(machine, opcode);
 		return;
 	}
+	op_unknown(machine, opcode);
 }
 
 static void op_assign(MACHINE* machine, uint16_t opcode)
@@ -389,12 +435,17 @@ static void op_handle_variable_arithmetic(MACHINE* machine, uint16_t opcode)
 		op_shift_left(machine, opcode);
 		return;
 	}
+	op_unknown(machine, opcode);
 }
 
 static void op_return_from_subroutine(MACHINE* machine, uint16_t opcode)
 {
-	machine->pc_reg = *(uint16_t*)(machine->RAM + machine->s_reg);
-	STEP(machine->s_reg);
+	if (machine->s_reg == 0)
+	{
+		raise_fault(machine, FAULT_STACK_UNDERFLOW, machine->pc_reg - MEM_STEP);
+		return;
+	}
+	machine->pc_reg = machine->stack[--machine->s_reg];
 }
 
 static void op_clear_screen(MACHINE* machine, uint16_t opcode)
@@ -403,6 +454,7 @@ static void op_clear_screen(MACHINE* machine, uint16_t opcode)
 	{
 		machine->pixel_row[i] = 0;
 	}
+	machine->dirty.rows = ALL_DIRTY_ROWS;
 }
 
 static void op_handle_base_instructions(MACHINE* machine, uint16_t opcode)
@@ -416,60 +468,58 @@ static void op_handle_base_instructions(MACHINE* machine, uint16_t opcode)
 	{
 		op_return_from_subroutine(machine, opcode);
 	}
+	else
+	{
+		op_unknown(machine, opcode);
+	}
 }
 
-static void op_draw_sprite(MACHINE* machine, uint16_t opcode)
+//Unknown opcodes, including the 0NNN machine calls, do nothing unless the machine is strict
+static void op_unknown(MACHINE* machine, uint16_t opcode)
+{
+	if (machine->strict_enabled)
+	{
+		raise_fault(machine, FAULT_UNKNOWN_OPCODE, machine->pc_reg - MEM_STEP);
+	}
+}
+
+//Also called directly by recompiled programs
+void op_draw_sprite(MACHINE* machine, uint16_t opcode)
 {
 	uint8_t x = machine->v_reg[GET_X(opcode)] % NUM_PIXEL_COLS;
 	uint8_t y = machine->v_reg[GET_Y(opcode)] % NUM_PIXEL_ROWS;
-	uint8_t* vf = &(machine->v_reg[0xF]);
 	uint8_t n = GET_N(opcode);
-	uint8_t row_count = 0;
-	*vf = 0;
-	while (row_count < n)
-	{
-		uint8_t sprite_row = machine->RAM[machine->i_reg + row_count];
-		uint64_t row_data = (uint64_t)sprite_row << 56;
-		row_data >>= x;
-		if (machine->y_wrap_enabled && x > 56)
-		{
-			uint8_t x_wrap_sprite = sprite_row << (64 - x);
-			row_data |= (uint64_t)x_wrap_sprite << 56;
-		}
-		if (y >= NUM_PIXEL_ROWS)
-		{
-			if (machine->y_wrap_enabled)
-			{
-				y = 0;
-			}
-			else
-			{
-				break;
-			}
-		}
-		if (*vf == 0)
-		{
-			*vf = (machine->pixel_row[y] & row_data) > 0;
-		}
-		machine->pixel_row[y] ^= row_data;
-		y++;
-		row_count++;
+	uint8_t* sprite = RAM_AT(machine, machine->i_reg);
+	if (n == 0 && machine->large_sprites_enabled)
+	{
+		COUNT_OUT_OF_BOUNDS(machine, machine->i_reg, 2 * LARGE_SPRITE_SIZE);
+		mark_rows_dirty(machine, y, LARGE_SPRITE_SIZE);
+		machine->v_reg[0xF] = draw_sprite_rows(machine->pixel_row, sprite, LARGE_SPRITE_SIZE, LARGE_SPRITE_SIZE, x, y, machine->y_wrap_enabled);
+		return;
 	}
+	COUNT_OUT_OF_BOUNDS(machine, machine->i_reg, n);
+	mark_rows_dirty(machine, y, n);
+	machine->v_reg[0xF] = draw_sprite_rows(machine->pixel_row, sprite, 8, n, x, y, machine->y_wrap_enabled);
+}
+
+//Rows past the bottom edge wrap to the top, or are not drawn without wrap
+static void mark_rows_dirty(MACHINE* machine, uint8_t y, uint8_t height)
+{
+	uint64_t rows = (((uint64_t)1 << height) - 1) << y;
+	machine->dirty.rows |= (uint32_t)(machine->y_wrap_enabled ? rows | (rows >> NUM_PIXEL_ROWS) : rows);
+}
+
+static uint16_t read_opcode(MACHINE* machine)
+{
+	uint8_t* memory = RAM_AT(machine, machine->pc_reg);
+	COUNT_OUT_OF_BOUNDS(machine, machine->pc_reg, MEM_STEP);
+	return (memory[0] << 8) | memory[1];
 }
 
 uint16_t fetch_opcode(MACHINE* machine)
 {
-	uint16_t opcode = *(uint16_t*)(machine->RAM + machine->pc_reg);
-	opcode = ((opcode >> 8) & 0x00FF) | (opcode << 8);
+	uint16_t opcode = read_opcode(machine);
 	machine->current_opcode = opcode;
-	if (machine->debug->on && machine->debug->settings.options[DEBUG_STEP_BY_STEP])
-	{
-		if (!machine->debug->settings.options[DEBUG_NEXT_STEP])
-		{
-			return;
-		}
-		machine->debug->settings.options[DEBUG_NEXT_STEP] = false;
-	}
 	if (!machine->waiting_for_input)
 	{
 		STEP(machine->pc_reg);
@@ -485,11 +535,12 @@ void execute_opcode(MACHINE* machine, uint16_t opcode)
 	case 0x0:
 		op_handle_base_instructions(machine, opcode);
 		return;
-	case 0x2:
-		op_push_to_stack(machine);
 	case 0x1:
 		op_jump(machine, opcode);
 		return;
+	case 0x2:
+		op_call_subroutine(machine, opcode);
+		return;
 	case 0x3:
 		op_do_if_not_equal_to_constant(machine, opcode);
 		return;
@@ -532,139 +583,179 @@ void execute_opcode(MACHINE* machine, uint16_t opcode)
 	}
 }
 
-void opcode_to_string(char* buffer, uint16_t opcode)
+void step_opcode(MACHINE* machine)
 {
-	const uint8_t buffer_length = 32;
-	uint8_t type = GET_TYPE(opcode);
-	uint8_t x = GET_X(opcode);
-	uint8_t y = GET_Y(opcode);
-	uint16_t nnn = GET_NNN(opcode);
-	uint8_t nn = GET_NN(opcode);
-	uint8_t n = GET_N(opcode);
-	switch (type)
+	uint16_t opcode = fetch_opcode(machine);
+	execute_opcode(machine, opcode);
+}
+
+//Only installed while the debugger is armed, so normal runs never pay for the checks below
+void step_opcode_hooked(MACHINE* machine)
+{
+	uint16_t opcode = read_opcode(machine);
+	machine->current_opcode = opcode;
+	if (machine->hooks_armed && !machine->debug_hook(machine->debug, opcode))
 	{
-	case 0x0:
-		if (nn == 0xE0)
-		{
-			snprintf(buffer, buffer_length, "CLR");
-			return;
-		}
-		else if (nn == 0xEE)
-		{
-			snprintf(buffer, buffer_length, "RET");
-			return;
-		}
-		break;
-	case 0x1:
-		snprintf(buffer, buffer_length, "JMP %03hX", nnn);
-		return;
-	case 0x2:
-		snprintf(buffer, buffer_length, "CALL %03hX", nnn);
-		return;
-	case 0x3:
-		snprintf(buffer, buffer_length, "NEQ V%hhX, %02hhX", x, nn);
-		return;
-	case 0x4:
-		snprintf(buffer, buffer_length, "EQ V%hhX, %02hhX", x, nn);
-		return;
-	case 0x5:
-		snprintf(buffer, buffer_length, "NEQ V%hhX, V%hhX", x, y);
-		return;
-	case 0x6:
-		snprintf(buffer, buffer_length, "MOV V%hhX, %02hhX", x, nn);
 		return;
-	case 0x7:
-		snprintf(buffer, buffer_length, "ADD V%hhX, %02hhX", x, nn);
-		return;
-	case 0x8:
-		switch (n)
-		{
-		case 0x0:
-			snprintf(buffer, buffer_length, "MOV V%hhX, V%hhX", x, y);
-			return;
-		case 0x1:
-			snprintf(buffer, buffer_length, "OR V%hhX, V%hhX", x, y);
-			return;
-		case 0x2:
-			snprintf(buffer, buffer_length, "AND V%hhX, V%hhX", x, y);
-			return;
-		case 0x3:
-			snprintf(buffer, buffer_length, "XOR V%hhX, V%hhX", x, y);
-			return;
-		case 0x4:
-			snprintf(buffer, buffer_length, "ADD V%hhX, V%hhX", x, y);
-			return;
-		case 0x5:
-			snprintf(buffer, buffer_length, "SUB V%hhX, V%hhX", x, y);
-			return;
-		case 0x6:
-			snprintf(buffer, buffer_length, "SHR V%hhX, V%hhX", x, y);
-			return;
-		case 0x7:
-			snprintf(buffer, buffer_length, "DIFF V%hhX, V%hhX", x, y);
-			return;
-		case 0xE:
-			snprintf(buffer, buffer_length, "SHL V%hhX, V%hhX", x, y);
-			return;
-		}
-	case 0x9:
-		snprintf(buffer, buffer_length, "EQ V%hhX, V%hhX", x, y);
-		return;
-	case 0xA:
-		snprintf(buffer, buffer_length, "MOV I, %03hX", nnn);
-		return;
-	case 0xB:
-		snprintf(buffer, buffer_length, "JMP0 %03hX", nnn);
-		return;
-	case 0xC:
-		snprintf(buffer, buffer_length, "RND V%hhX %02hhX", x, nn);
+	}
+	if (machine->trace)
+	{
+		TRACE_SNAPSHOT before;
+		take_trace_snapshot(machine, &before);
+		step_opcode(machine);
+		record_trace(machine->trace, machine, opcode, &before);
 		return;
-	case 0xD:
-		snprintf(buffer, buffer_length, "DRAW V%hhX, V%hhX, %hhX", x, y, n);
+	}
+	step_opcode(machine);
+}
+
+//Any fused sequence overlapping the written bytes goes back to the plain interpreter
+static void invalidate_fusion(MACHINE* machine, uint16_t address, uint8_t length)
+{
+	if (!machine->fusion)
+	{
 		return;
-	case 0xE:
-		if (nn == 0x9E)
+	}
+	for (uint16_t i = 0; i < length + FUSION_SPAN - 1; i++)
+	{
+		machine->fusion[(address - (FUSION_SPAN - 1) + i) & (RAM_SIZE - 1)] = FUSION_NONE;
+	}
+}
+
+//Returns how many instructions were executed
+static uint8_t execute_fused(MACHINE* machine, uint8_t kind)
+{
+	uint16_t pc = machine->pc_reg;
+	uint16_t first = read_opcode(machine);
+	uint8_t* memory = RAM_AT(machine, pc);
+	uint16_t second = (memory[2] << 8) | memory[3];
+	uint8_t* vx = &(machine->v_reg[GET_X(first)]);
+	switch (kind)
+	{
+	case FUSION_SET_PAIR:
+		*vx = GET_NN(first);
+		machine->v_reg[GET_X(second)] = GET_NN(second);
+		machine->pc_reg = pc + 2 * MEM_STEP;
+		return 2;
+	case FUSION_POINT_AND_DRAW:
+		machine->i_reg = GET_NNN(first);
+		machine->pc_reg = pc + 2 * MEM_STEP;
+		op_draw_sprite(machine, second);
+		return 2;
+	case FUSION_TIMER_WAIT:
+		*vx = machine->d_counter;
+		if (*vx == 0)
 		{
-			snprintf(buffer, buffer_length, "NKEY V%hhX", x);
-			return;
+			machine->pc_reg = pc + 3 * MEM_STEP;
+			return 2;
 		}
-		else if (nn == 0xA1)
+		return 3;
+	case FUSION_COUNTED_LOOP:
+		*vx += GET_NN(first);
+		if (*vx == (GET_NN(second)))
 		{
-			snprintf(buffer, buffer_length, "KEY V%hhX", x);
-			return;
+			machine->pc_reg = pc + 3 * MEM_STEP;
+			return 2;
 		}
-		break;
-	case 0xF:
-		switch (nn)
+		machine->pc_reg = ((memory[4] << 8) | memory[5]) & 0x0FFF;
+		return 3;
+	}
+	return 0;
+}
+
+//A fused handler runs two or three instructions in one opcode timer tick, then the following ticks are skipped
+//so the average instruction rate stays the same
+void step_fused(MACHINE* machine)
+{
+	if (machine->pending_cycles > 0)
+	{
+		machine->pending_cycles--;
+		return;
+	}
+	uint8_t kind = machine->fusion[machine->pc_reg & (RAM_SIZE - 1)];
+	if (kind == FUSION_NONE)
+	{
+		step_opcode(machine);
+		return;
+	}
+	machine->pending_cycles = execute_fused(machine, kind) - 1;
+}
+
+static void step_halted(MACHINE* machine)
+{
+}
+
+void update_step_function(MACHINE* machine)
+{
+	machine->next_block = NULL;
+	if (machine->fault != FAULT_NONE)
+	{
+		machine->step = step_halted;
+	}
+	else if (machine->hooks_armed || machine->trace)
+	{
+		machine->step = step_opcode_hooked;
+	}
+	else
+	{
+		machine->step = machine->recompiled ? step_recompiled : step_opcode;
+		if (!machine->recompiled && machine->fusion_enabled && machine->fusion)
 		{
-		case 0x07:
-			snprintf(buffer, buffer_length, "MOV V%hhX, DT", x);
-			return;
-		case 0x0A:
-			snprintf(buffer, buffer_length, "WAIT V%hhX", x);
-			return;
-		case 0x15:
-			snprintf(buffer, buffer_length, "MOV DT, V%hhX", x);
-			return;
-		case 0x18:
-			snprintf(buffer, buffer_length, "MOV ST, V%hhX", x);
-			return;
-		case 0x1E:
-			snprintf(buffer, buffer_length, "ADD I, V%hhX", x);
-			return;
-		case 0x29:
-			snprintf(buffer, buffer_length, "MOV I, CHAR[V%hhX]", x);
-			return;
-		case 0x33:
-			snprintf(buffer, buffer_length, "BCD V%hhX", x);
-			return;
-		case 0x55:
-			snprintf(buffer, buffer_length, "STO %hhX", x);
-			return;
-		case 0x65:
-			snprintf(buffer, buffer_length, "LD %hhX", x);
-			return;
+			machine->step = step_fused;
 		}
 	}
-	snprintf(buffer, buffer_length, "??? (%04hX)", opcode);
+}
+
+//Halts the machine with the program counter on the faulting instruction until it is reset
+void raise_fault(MACHINE* machine, MACHINE_FAULT fault, uint16_t address)
+{
+	machine->fault = fault;
+	machine->pc_reg = address;
+	update_step_function(machine);
+}
+
+const char* fault_to_string(MACHINE_FAULT fault)
+{
+	switch (fault)
+	{
+	case FAULT_STACK_OVERFLOW:
+		return "Stack overflow";
+	case FAULT_STACK_UNDERFLOW:
+		return "Stack underflow";
+	case FAULT_UNKNOWN_OPCODE:
+		return "Unknown opcode";
+	case FAULT_FONT_WRITE:
+		return "Write into the font";
+	case FAULT_PC_OUT_OF_RANGE:
+		return "PC out of range";
+	default:
+		return "None";
+	}
+}
+
+//Writes through RAM_AT can land in the guard or in the bytes it mirrors, so both copies are brought back in sync,
+//and the lines written are marked dirty. Only called by instructions that write RAM, the much more frequent reads
+//need no checks at all.
+void mirror_ram_writes(MACHINE* machine, uint16_t address, uint8_t length)
+{
+	COUNT_OUT_OF_BOUNDS(machine, address, length);
+	address = MASK_ADDRESS(address);
+	uint8_t first_line = address / DIRTY_LINE_SIZE;
+	uint8_t num_lines = (address % DIRTY_LINE_SIZE + length + DIRTY_LINE_SIZE - 1) / DIRTY_LINE_SIZE;
+	for (uint8_t i = 0; i < num_lines; i++)
+	{
+		machine->dirty.lines |= (uint64_t)1 << ((first_line + i) % (RAM_SIZE / DIRTY_LINE_SIZE));
+	}
+	if (machine->strict_enabled && address < FONT_MEMORY_BASE_ADDRESS + FONT_MEMORY_SIZE && address + length > FONT_MEMORY_BASE_ADDRESS)
+	{
+		raise_fault(machine, FAULT_FONT_WRITE, machine->pc_reg - MEM_STEP);
+	}
+	if (address + length > RAM_SIZE)
+	{
+		memcpy(machine->RAM, machine->RAM + RAM_SIZE, address + length - RAM_SIZE);
+	}
+	if (address < RAM_GUARD_SIZE || address + length > RAM_SIZE)
+	{
+		memcpy(machine->RAM + RAM_SIZE, machine->RAM, RAM_GUARD_SIZE);
+	}
 }
\ No newline at end of file
@@ -0,0 +1,67 @@
+﻿#include <string.h>
+#include "phosphor.h"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PHOSPHOR_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef PHOSPHOR_SSE2
+static __m128i expand_pixels_sse2(uint16_t pixels);
+#endif
+
+void reset_phosphor(PHOSPHOR* phosphor, uint8_t width, uint8_t height)
+{
+	phosphor->width = width;
+	phosphor->height = height;
+	memset(phosphor->intensity, 0, sizeof(phosphor->intensity));
+}
+
+//Once per frame. Lit pixels go to full intensity, unlit ones decay by intensity >> decay_shift plus one so they
+//reach zero. pixel_row holds width / 64 words per row, leftmost pixel in the top bit as in MACHINE.
+void update_phosphor(PHOSPHOR* phosphor, const uint64_t* pixel_row)
+{
+	uint16_t words = phosphor->height * (phosphor->width / 64);
+	uint8_t* intensity = phosphor->intensity;
+#ifdef PHOSPHOR_SSE2
+	__m128i shift = _mm_cvtsi32_si128(phosphor->decay_shift);
+	__m128i shifted_mask = _mm_set1_epi8((char)(0xFF >> phosphor->decay_shift));
+	__m128i one = _mm_set1_epi8(1);
+	__m128i keep = _mm_set1_epi8(phosphor->enabled ? -1 : 0);
+	for (uint16_t i = 0; i < words; i++)
+	{
+		uint64_t row = pixel_row[i];
+		for (int8_t bit = 48; bit >= 0; bit -= 16, intensity += 16)
+		{
+			__m128i lit = expand_pixels_sse2((uint16_t)(row >> bit));
+			__m128i current = _mm_loadu_si128((const __m128i*)intensity);
+			__m128i decay = _mm_and_si128(_mm_srl_epi16(current, shift), shifted_mask);
+			__m128i decayed = _mm_and_si128(_mm_subs_epu8(_mm_sub_epi8(current, decay), one), keep);
+			_mm_storeu_si128((__m128i*)intensity, _mm_max_epu8(decayed, lit));
+		}
+	}
+#else
+	for (uint16_t i = 0; i < words; i++)
+	{
+		uint64_t row = pixel_row[i];
+		for (int8_t bit = 63; bit >= 0; bit--, intensity++)
+		{
+			uint8_t decayed = *intensity - (*intensity >> phosphor->decay_shift);
+			decayed = phosphor->enabled && decayed > 0 ? decayed - 1 : 0;
+			*intensity = (row >> bit) & 1 ? 0xFF : decayed;
+		}
+	}
+#endif
+}
+
+#ifdef PHOSPHOR_SSE2
+//16 pixels, leftmost in the top bit, to one byte each: 0xFF lit, 0 unlit
+static __m128i expand_pixels_sse2(uint16_t pixels)
+{
+	__m128i bytes = _mm_cvtsi32_si128((pixels >> 8) | ((pixels & 0xFF) << 8));
+	bytes = _mm_unpacklo_epi8(bytes, bytes);
+	bytes = _mm_unpacklo_epi16(bytes, bytes);
+	bytes = _mm_unpacklo_epi32(bytes, bytes);
+	__m128i select = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+	return _mm_cmpeq_epi8(_mm_and_si128(bytes, select), select);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,158 @@
+﻿#include <assert.h>
+#include <stdlib.h>
+#include "struct_pool.h"
+
+//Logical cores available to this process, at least 1
+uint8_t get_core_count()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	long count = info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return count < 1 ? 1 : count > UINT8_MAX ? UINT8_MAX : (uint8_t)count;
+}
+
+static void run_slice(POOL* pool, uint8_t slice);
+#ifdef _WIN32
+static DWORD WINAPI run_worker(void* argument);
+#else
+static void* run_worker(void* argument);
+#endif
+
+//num_threads extra threads, 0 runs every batch on the calling thread
+POOL* create_pool(uint8_t num_threads)
+{
+	POOL* pool = calloc(1, sizeof(POOL));
+	assert(pool);
+	pool->num_threads = num_threads;
+	pool->workers = calloc(num_threads + 1, sizeof(POOL_WORKER));
+	assert(pool->workers);
+#ifdef _WIN32
+	InitializeSRWLock(&pool->lock);
+	InitializeConditionVariable(&pool->start);
+	InitializeConditionVariable(&pool->done);
+#else
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+#endif
+	//A worker that cannot be started shrinks the pool to those already running, down to the caller alone, since
+	//batches are split by num_threads and wait for that many workers
+	for (uint8_t i = 1; i <= num_threads; i++)
+	{
+		POOL_WORKER* worker = &pool->workers[i];
+		worker->pool = pool;
+		worker->index = i;
+#ifdef _WIN32
+		worker->thread = CreateThread(NULL, 0, run_worker, worker, 0, NULL);
+		bool started = worker->thread != NULL;
+#else
+		bool started = pthread_create(&worker->thread, NULL, run_worker, worker) == 0;
+#endif
+		if (!started)
+		{
+			LOCK_POOL(pool);
+			pool->num_threads = i - 1;
+			UNLOCK_POOL(pool);
+			break;
+		}
+	}
+	return pool;
+}
+
+void delete_pool(POOL* pool)
+{
+	LOCK_POOL(pool);
+	pool->quit = true;
+	WAKE_POOL(pool, start);
+	UNLOCK_POOL(pool);
+	for (uint8_t i = 1; i <= pool->num_threads; i++)
+	{
+#ifdef _WIN32
+		WaitForSingleObject(pool->workers[i].thread, INFINITE);
+		CloseHandle(pool->workers[i].thread);
+#else
+		pthread_join(pool->workers[i].thread, NULL);
+#endif
+	}
+#ifndef _WIN32
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->lock);
+#endif
+	free(pool->workers);
+	free(pool);
+}
+
+//Calls task(context, i) for every i below count and returns once all calls have finished
+void run_pool(POOL* pool, POOL_TASK task, void* context, uint16_t count)
+{
+	pool->task = task;
+	pool->context = context;
+	pool->count = count;
+	if (pool->num_threads > 0)
+	{
+		LOCK_POOL(pool);
+		pool->pending = pool->num_threads;
+		pool->generation++;
+		WAKE_POOL(pool, start);
+		UNLOCK_POOL(pool);
+	}
+	run_slice(pool, 0);
+	if (pool->num_threads > 0)
+	{
+		LOCK_POOL(pool);
+		while (pool->pending > 0)
+		{
+			WAIT_POOL(pool, done);
+		}
+		UNLOCK_POOL(pool);
+	}
+}
+
+static void run_slice(POOL* pool, uint8_t slice)
+{
+	uint32_t slices = pool->num_threads + 1;
+	uint16_t first = (uint16_t)(pool->count * slice / slices);
+	uint16_t last = (uint16_t)(pool->count * (slice + 1) / slices);
+	for (uint16_t i = first; i < last; i++)
+	{
+		pool->task(pool->context, i);
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI run_worker(void* argument)
+#else
+static void* run_worker(void* argument)
+#endif
+{
+	POOL_WORKER* worker = argument;
+	POOL* pool = worker->pool;
+	uint32_t generation = 0;
+	LOCK_POOL(pool);
+	while (true)
+	{
+		while (!pool->quit && pool->generation == generation)
+		{
+			WAIT_POOL(pool, start);
+		}
+		if (pool->quit)
+		{
+			break;
+		}
+		generation = pool->generation;
+		UNLOCK_POOL(pool);
+		run_slice(pool, worker->index);
+		LOCK_POOL(pool);
+		if (--pool->pending == 0)
+		{
+			WAKE_POOL(pool, done);
+		}
+	}
+	UNLOCK_POOL(pool);
+	return 0;
+}
\ No newline at end of file
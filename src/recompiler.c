@@ -0,0 +1,55 @@
+﻿#include "recompiler.h"
+
+//Only accepts a program compiled from the ROM that is currently loaded
+bool set_recompiled_program(MACHINE* machine, const RECOMPILED_PROGRAM* program)
+{
+	if (program && (program->size != machine->program_size || memcmp(program->rom, machine->RAM + PROGRAM_BASE_ADDRESS, program->size) != 0))
+	{
+		return false;
+	}
+	machine->recompiled = program;
+	machine->pending_cycles = 0;
+	update_step_function(machine);
+	return true;
+}
+
+//A block runs all of its instructions at once, then the following opcode timer ticks are skipped to keep the same average speed
+void step_recompiled(MACHINE* machine)
+{
+	if (machine->pending_cycles > 0)
+	{
+		machine->pending_cycles--;
+		return;
+	}
+	RECOMPILED_BLOCK block = machine->next_block ? machine->next_block : machine->recompiled->run_block;
+	machine->pending_cycles = block(machine) - 1;
+}
+
+//Same stack semantics as the interpreter, plus the native block of the return site for recompiled_return
+void recompiled_call(MACHINE* machine, uint16_t address, uint16_t target, RECOMPILED_BLOCK target_block, RECOMPILED_BLOCK return_block)
+{
+	if (machine->s_reg >= STACK_DEPTH)
+	{
+		raise_fault(machine, FAULT_STACK_OVERFLOW, address);
+		return;
+	}
+	machine->return_predictions[machine->s_reg].address = address + MEM_STEP;
+	machine->return_predictions[machine->s_reg].block = return_block;
+	machine->dirty.stack |= 1u << machine->s_reg;
+	machine->stack[machine->s_reg++] = address + MEM_STEP;
+	machine->pc_reg = target;
+	machine->next_block = target_block;
+}
+
+//The prediction is only used if the interpreter has not pushed a different address at the same depth since
+void recompiled_return(MACHINE* machine, uint16_t address)
+{
+	if (machine->s_reg == 0)
+	{
+		raise_fault(machine, FAULT_STACK_UNDERFLOW, address);
+		return;
+	}
+	machine->pc_reg = machine->stack[--machine->s_reg];
+	RETURN_PREDICTION* prediction = &machine->return_predictions[machine->s_reg];
+	machine->next_block = prediction->address == machine->pc_reg ? prediction->block : NULL;
+}
\ No newline at end of file
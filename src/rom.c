@@ -0,0 +1,67 @@
+﻿#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rom.h"
+#include "struct_rom.h"
+#include "fusion.h"
+
+//Same as load_program but returns NULL when the file cannot be read, since a failed switch leaves the current
+//program running
+ROM_IMAGE* create_rom_image(const char* file_name)
+{
+	FILE* file = fopen(file_name, "rb");
+	if (!file)
+	{
+		return NULL;
+	}
+	uint8_t data[RAM_SIZE - PROGRAM_BASE_ADDRESS];
+	size_t size = fread(data, BYTE_SIZE, sizeof(data), file);
+	fclose(file);
+	return size ? create_rom_image_data(file_name, data, (uint16_t)size) : NULL;
+}
+
+//Analyses the program in a scratch RAM laid out like a freshly reset machine
+ROM_IMAGE* create_rom_image_data(const char* name, const uint8_t* data, uint16_t size)
+{
+	if (size > RAM_SIZE - PROGRAM_BASE_ADDRESS)
+	{
+		size = RAM_SIZE - PROGRAM_BASE_ADDRESS;
+	}
+	ROM_IMAGE* image = calloc(1, sizeof(ROM_IMAGE));
+	assert(image);
+	uint8_t* RAM = calloc(RAM_SIZE + RAM_GUARD_SIZE, 1);
+	assert(RAM);
+	uint8_t font[FONT_MEMORY_SIZE] = DEFAULT_FONT_MEMORY_CONTENT;
+	memcpy(RAM + FONT_MEMORY_BASE_ADDRESS, font, FONT_MEMORY_SIZE);
+	memcpy(RAM + PROGRAM_BASE_ADDRESS, data, size);
+	image->name = malloc(strlen(name) + 1);
+	assert(image->name);
+	strcpy(image->name, name);
+	image->data = malloc(size + 1);
+	assert(image->data);
+	memcpy(image->data, data, size);
+	image->size = size;
+	image->analysis = analyze_program(RAM, PROGRAM_BASE_ADDRESS, size);
+	image->fusion = build_fusion_table(image->analysis, RAM);
+	free(RAM);
+	return image;
+}
+
+void delete_rom_image(ROM_IMAGE* image)
+{
+	if (!image)
+	{
+		return;
+	}
+	delete_analysis(image->analysis);
+	free(image->fusion);
+	free(image->data);
+	free(image->name);
+	free(image);
+}
+
+const char* get_rom_name(const ROM_IMAGE* image)
+{
+	return image->name;
+}
\ No newline at end of file
@@ -0,0 +1,141 @@
+﻿#include <string.h>
+#include "sprite.h"
+#include "struct_machine.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SPRITE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+static __m256i read_sprite_rows_avx2(const uint8_t* sprite, uint8_t width, uint8_t k);
+#elif defined(SPRITE_SSE2)
+static __m128i read_sprite_rows_sse2(const uint8_t* sprite, uint8_t width, uint8_t k);
+#else
+static uint64_t read_sprite_row(const uint8_t* sprite, uint8_t width, uint8_t k);
+#endif
+static uint64_t blit_rows_scalar(uint64_t* pixel_row, const uint64_t* rows, uint8_t count, uint8_t y);
+
+//Rows are shifted into place together and XORed onto the screen a vector at a time. Horizontal wrap is a rotation
+//masked by wrap, since for x <= 64 - width the rotated-in bits are zero anyway. Without wrap the row count is
+//clipped at the bottom edge, and lanes past the count are masked to zero. A vector of rows that crosses the bottom
+//edge goes through the scalar path, which indexes modulo the screen height. sprite must be readable for
+//MAX_SPRITE_ROWS rows, which RAM_AT guarantees. Returns whether any lit pixel was turned off.
+bool draw_sprite_rows(uint64_t* pixel_row, const uint8_t* sprite, uint8_t width, uint8_t height, uint8_t x, uint8_t y, bool wrap)
+{
+	uint64_t wrap_mask = (uint64_t)0 - wrap;
+	uint8_t rotate = (64 - x) & 63;
+	uint8_t visible = NUM_PIXEL_ROWS - y;
+	uint8_t count = wrap || height <= visible ? height : visible;
+	uint64_t hits = 0;
+#if defined(__AVX2__)
+	__m256i hit_vector = _mm256_setzero_si256();
+	__m128i shift_right = _mm_cvtsi32_si128(x);
+	__m128i shift_left = _mm_cvtsi32_si128(rotate);
+	__m256i wrap_vector = _mm256_set1_epi64x(wrap_mask);
+	__m256i rows_left = _mm256_set1_epi64x(count);
+	for (uint8_t k = 0; k < count; k += 4)
+	{
+		__m256i index = _mm256_set_epi64x(k + 3, k + 2, k + 1, k);
+		__m256i rows = read_sprite_rows_avx2(sprite, width, k);
+		rows = _mm256_or_si256(_mm256_srl_epi64(rows, shift_right), _mm256_and_si256(_mm256_sll_epi64(rows, shift_left), wrap_vector));
+		rows = _mm256_and_si256(rows, _mm256_cmpgt_epi64(rows_left, index));
+		if (y + k + 4 <= NUM_PIXEL_ROWS)
+		{
+			__m256i* screen = (__m256i*)(pixel_row + y + k);
+			__m256i pixels = _mm256_loadu_si256(screen);
+			hit_vector = _mm256_or_si256(hit_vector, _mm256_and_si256(pixels, rows));
+			_mm256_storeu_si256(screen, _mm256_xor_si256(pixels, rows));
+		}
+		else
+		{
+			uint64_t lanes[4];
+			_mm256_storeu_si256((__m256i*)lanes, rows);
+			hits |= blit_rows_scalar(pixel_row, lanes, 4, y + k);
+		}
+	}
+	return hits != 0 || !_mm256_testz_si256(hit_vector, hit_vector);
+#elif defined(SPRITE_SSE2)
+	__m128i hit_vector = _mm_setzero_si128();
+	__m128i shift_right = _mm_cvtsi32_si128(x);
+	__m128i shift_left = _mm_cvtsi32_si128(rotate);
+	__m128i wrap_vector = _mm_set1_epi64x(wrap_mask);
+	for (uint8_t k = 0; k < count; k += 2)
+	{
+		__m128i rows = read_sprite_rows_sse2(sprite, width, k);
+		rows = _mm_or_si128(_mm_srl_epi64(rows, shift_right), _mm_and_si128(_mm_sll_epi64(rows, shift_left), wrap_vector));
+		rows = _mm_and_si128(rows, _mm_set_epi64x((uint64_t)0 - (k + 1 < count), -1));
+		if (y + k + 2 <= NUM_PIXEL_ROWS)
+		{
+			__m128i* screen = (__m128i*)(pixel_row + y + k);
+			__m128i pixels = _mm_loadu_si128(screen);
+			hit_vector = _mm_or_si128(hit_vector, _mm_and_si128(pixels, rows));
+			_mm_storeu_si128(screen, _mm_xor_si128(pixels, rows));
+		}
+		else
+		{
+			uint64_t lanes[2];
+			_mm_storeu_si128((__m128i*)lanes, rows);
+			hits |= blit_rows_scalar(pixel_row, lanes, 2, y + k);
+		}
+	}
+	return hits != 0 || _mm_movemask_epi8(_mm_cmpeq_epi8(hit_vector, _mm_setzero_si128())) != 0xFFFF;
+#else
+	for (uint8_t k = 0; k < count; k++)
+	{
+		uint64_t row = read_sprite_row(sprite, width, k);
+		row = (row >> x) | ((row << rotate) & wrap_mask);
+		hits |= blit_rows_scalar(pixel_row, &row, 1, y + k);
+	}
+	return hits != 0;
+#endif
+}
+
+#if defined(__AVX2__)
+//Rows k to k + 3, each left-aligned in its lane
+static __m256i read_sprite_rows_avx2(const uint8_t* sprite, uint8_t width, uint8_t k)
+{
+	if (width == LARGE_SPRITE_SIZE)
+	{
+		__m128i words = _mm_loadl_epi64((const __m128i*)(sprite + 2 * k));
+		words = _mm_shuffle_epi8(words, _mm_set_epi8(15, 14, 13, 12, 11, 10, 9, 8, 6, 7, 4, 5, 2, 3, 0, 1));
+		return _mm256_slli_epi64(_mm256_cvtepu16_epi64(words), 64 - LARGE_SPRITE_SIZE);
+	}
+	int32_t bytes;
+	memcpy(&bytes, sprite + k, sizeof(bytes));
+	return _mm256_slli_epi64(_mm256_cvtepu8_epi64(_mm_cvtsi32_si128(bytes)), 56);
+}
+#elif defined(SPRITE_SSE2)
+//Rows k and k + 1, each left-aligned in its lane. Interleaving with zeros moves each byte up to the top of a lane.
+static __m128i read_sprite_rows_sse2(const uint8_t* sprite, uint8_t width, uint8_t k)
+{
+	__m128i zero = _mm_setzero_si128();
+	if (width == LARGE_SPRITE_SIZE)
+	{
+		__m128i words = _mm_cvtsi32_si128(sprite[2 * k + 1] | (sprite[2 * k] << 8) | (sprite[2 * k + 3] << 16) | (sprite[2 * k + 2] << 24));
+		return _mm_unpacklo_epi32(zero, _mm_unpacklo_epi16(zero, words));
+	}
+	__m128i bytes = _mm_cvtsi32_si128(sprite[k] | (sprite[k + 1] << 8));
+	return _mm_unpacklo_epi32(zero, _mm_unpacklo_epi16(zero, _mm_unpacklo_epi8(zero, bytes)));
+}
+#else
+//Left-aligned in the 64-bit screen row
+static uint64_t read_sprite_row(const uint8_t* sprite, uint8_t width, uint8_t k)
+{
+	uint64_t row = width == LARGE_SPRITE_SIZE ? (sprite[2 * k] << 8) | sprite[2 * k + 1] : sprite[k];
+	return row << (64 - width);
+}
+#endif
+
+static uint64_t blit_rows_scalar(uint64_t* pixel_row, const uint64_t* rows, uint8_t count, uint8_t y)
+{
+	uint64_t hits = 0;
+	for (uint8_t i = 0; i < count; i++)
+	{
+		uint64_t* screen = &pixel_row[(y + i) & (NUM_PIXEL_ROWS - 1)];
+		hits |= *screen & rows[i];
+		*screen ^= rows[i];
+	}
+	return hits;
+}
\ No newline at end of file
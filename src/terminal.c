@@ -0,0 +1,242 @@
+﻿#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "struct_terminal.h"
+#ifdef _WIN32
+#include <conio.h>
+#else
+#include <sys/select.h>
+#include <unistd.h>
+#endif
+
+#define FRAME_SECONDS (1 / 60.0)
+#define TICKS_PER_FRAME 12
+
+static const char* const half_blocks[4] = { " ", "\xE2\x96\x80", "\xE2\x96\x84", "\xE2\x96\x88" }; //none, upper, lower, full
+
+static double get_seconds();
+static void wait_until(double deadline);
+static void report_status(TERMINAL* terminal);
+static int read_character();
+
+//Switches the terminal to raw, unechoed input and hides the cursor until delete_terminal. Ctrl-C is read as a key
+//rather than raising SIGINT, so quitting with it still goes through delete_terminal and restores the terminal.
+TERMINAL* create_terminal(FILE* out)
+{
+	TERMINAL* terminal = calloc(1, sizeof(TERMINAL));
+	assert(terminal);
+	terminal->out = out;
+#ifdef _WIN32
+	HANDLE input = GetStdHandle(STD_INPUT_HANDLE);
+	HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
+	GetConsoleMode(input, &terminal->saved_input_mode);
+	GetConsoleMode(output, &terminal->saved_output_mode);
+	SetConsoleMode(input, terminal->saved_input_mode & ~(ENABLE_LINE_INPUT | ENABLE_ECHO_INPUT | ENABLE_PROCESSED_INPUT));
+	SetConsoleMode(output, terminal->saved_output_mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+	SetConsoleOutputCP(CP_UTF8);
+#else
+	if (tcgetattr(STDIN_FILENO, &terminal->saved_mode) == 0)
+	{
+		struct termios raw = terminal->saved_mode;
+		raw.c_lflag &= ~(ICANON | ECHO | ISIG);
+		raw.c_cc[VMIN] = 0;
+		raw.c_cc[VTIME] = 0;
+		tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+	}
+#endif
+	fputs("\x1B[?25l\x1B[2J", out);
+	return terminal;
+}
+
+void delete_terminal(TERMINAL* terminal)
+{
+	fprintf(terminal->out, "\x1B[%d;1H\x1B[?25h\n", TERMINAL_STATUS_ROW + 1);
+	fflush(terminal->out);
+#ifdef _WIN32
+	SetConsoleMode(GetStdHandle(STD_INPUT_HANDLE), terminal->saved_input_mode);
+	SetConsoleMode(GetStdHandle(STD_OUTPUT_HANDLE), terminal->saved_output_mode);
+#else
+	tcsetattr(STDIN_FILENO, TCSANOW, &terminal->saved_mode);
+#endif
+	free(terminal);
+}
+
+//Writes only the cells whose pixels changed since the last frame, moving the cursor only across unchanged cells.
+//Returns the number of bytes written.
+uint32_t render_terminal(TERMINAL* terminal, const uint64_t* pixel_row)
+{
+	char* p = terminal->buffer;
+	for (uint8_t row = 0; row < TERMINAL_ROWS; row++)
+	{
+		uint64_t top = pixel_row[2 * row];
+		uint64_t bottom = pixel_row[2 * row + 1];
+		uint64_t changed = (top ^ terminal->shown_rows[2 * row]) | (bottom ^ terminal->shown_rows[2 * row + 1]);
+		if (!terminal->drawn)
+		{
+			changed = UINT64_MAX;
+		}
+		int8_t cursor = -1; //column the cursor is on, -1 when it is elsewhere
+		for (int8_t x = 0; changed != 0; x++, changed <<= 1)
+		{
+			if (!(changed >> 63))
+			{
+				continue;
+			}
+			if (x != cursor)
+			{
+				p += sprintf(p, "\x1B[%d;%dH", row + 1, x + 1);
+			}
+			uint8_t shift = NUM_PIXEL_COLS - 1 - x;
+			const char* block = half_blocks[((top >> shift) & 1) | (((bottom >> shift) & 1) << 1)];
+			size_t length = strlen(block);
+			memcpy(p, block, length);
+			p += length;
+			cursor = x + 1;
+		}
+	}
+	memcpy(terminal->shown_rows, pixel_row, sizeof(terminal->shown_rows));
+	terminal->drawn = true;
+	uint32_t bytes = (uint32_t)(p - terminal->buffer);
+	if (bytes > 0)
+	{
+		fwrite(terminal->buffer, 1, bytes, terminal->out);
+		fflush(terminal->out);
+	}
+	return bytes;
+}
+
+//Drains the typed characters. A typed key is held for TERMINAL_KEY_HOLD_FRAMES frames, and key repeat keeps
+//it held for as long as it is down. Escape only quits on its own: arrow and function keys start with it too, as
+//ESC [ up to a final byte or ESC O and one byte, and are dropped whole.
+void read_terminal_keys(TERMINAL* terminal, MACHINE* machine)
+{
+	uint16_t pressed = 0;
+	int character;
+	while ((character = read_character()) >= 0)
+	{
+		if (character == TERMINAL_INTERRUPT_KEY)
+		{
+			terminal->quit = true;
+			continue;
+		}
+		if (character == TERMINAL_QUIT_KEY)
+		{
+			character = read_character();
+			if (character < 0)
+			{
+				terminal->quit = true;
+				break;
+			}
+			if (character == '[')
+			{
+				do
+				{
+					character = read_character();
+				} while (character >= 0 && (character < 0x40 || character > 0x7E));
+				continue;
+			}
+			if (character == 'O')
+			{
+				read_character();
+				continue;
+			}
+		}
+		const char* key = character > 0 ? strchr(TERMINAL_KEYPAD, character | 0x20) : NULL;
+		if (key && *key)
+		{
+			uint8_t value = (uint8_t)(key - TERMINAL_KEYPAD);
+			pressed |= !terminal->key_frames[value] << value;
+			terminal->key_frames[value] = TERMINAL_KEY_HOLD_FRAMES;
+		}
+	}
+	for (uint8_t i = 0; i < KEYPAD_SIZE; i++)
+	{
+		machine->key_pressed[i] = terminal->key_frames[i] > 0;
+		terminal->key_frames[i] -= terminal->key_frames[i] > 0;
+	}
+	if (pressed && machine->waiting_for_input)
+	{
+		machine->input_received = true;
+	}
+}
+
+//Runs at 60 frames per second until Escape is typed, the machine stops or max_frames have run (0 for no limit)
+void run_terminal(MACHINE* machine, TERMINAL* terminal, uint32_t max_frames)
+{
+	double next_frame = get_seconds();
+	for (uint32_t frame = 0; machine->on && !terminal->quit && (max_frames == 0 || frame < max_frames); frame++)
+	{
+		double start = get_seconds();
+		read_terminal_keys(terminal, machine);
+		for (uint8_t tick = 0; tick < TICKS_PER_FRAME; tick++)
+		{
+			machine->step(machine);
+		}
+		machine->d_counter -= machine->d_counter > 0;
+		machine->s_counter -= machine->s_counter > 0;
+		terminal->frame_bytes += render_terminal(terminal, machine->pixel_row);
+		terminal->frame_seconds += get_seconds() - start;
+		if (++terminal->status_frames == 60)
+		{
+			report_status(terminal);
+		}
+		next_frame += FRAME_SECONDS;
+		wait_until(next_frame);
+	}
+}
+
+//Once a second, below the screen
+static void report_status(TERMINAL* terminal)
+{
+	fprintf(terminal->out, "\x1B[%d;1H%6.1f bytes/frame %7.1f us/frame\x1B[K", TERMINAL_STATUS_ROW,
+		(double)terminal->frame_bytes / terminal->status_frames, terminal->frame_seconds * 1e6 / terminal->status_frames);
+	fflush(terminal->out);
+	terminal->frame_bytes = 0;
+	terminal->frame_seconds = 0;
+	terminal->status_frames = 0;
+}
+
+//Returns the next typed character, or -1 when there is none. The Windows console reports special keys as 0 or
+//0xE0 followed by a scan code, which are both dropped.
+static int read_character()
+{
+#ifdef _WIN32
+	if (!_kbhit())
+	{
+		return -1;
+	}
+	int character = _getch();
+	if (character == 0 || character == 0xE0)
+	{
+		_getch();
+		return read_character();
+	}
+	return character;
+#else
+	unsigned char byte;
+	return read(STDIN_FILENO, &byte, 1) == 1 ? byte : -1;
+#endif
+}
+
+static double get_seconds()
+{
+	struct timespec now;
+	timespec_get(&now, TIME_UTC);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void wait_until(double deadline)
+{
+	double remaining = deadline - get_seconds();
+	if (remaining <= 0)
+	{
+		return;
+	}
+#ifdef _WIN32
+	Sleep((DWORD)(remaining * 1000));
+#else
+	struct timeval timeout = { (long)remaining, (long)((remaining - (long)remaining) * 1e6) };
+	select(0, NULL, NULL, NULL, &timeout);
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,206 @@
+﻿#include <assert.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include "struct_trace.h"
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#define OPEN_TRACE_FILE(name) _open(name, _O_WRONLY | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE)
+#define WRITE_TRACE_FILE(descriptor, data, length) _write(descriptor, data, length)
+#define EMPTY_TRACE_FILE(descriptor) (_lseek(descriptor, 0, SEEK_SET) == 0 && _chsize(descriptor, 0) == 0)
+#define CLOSE_TRACE_FILE(descriptor) _close(descriptor)
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#define OPEN_TRACE_FILE(name) open(name, O_WRONLY | O_CREAT, 0644)
+#define WRITE_TRACE_FILE(descriptor, data, length) write(descriptor, data, length)
+#define EMPTY_TRACE_FILE(descriptor) (lseek(descriptor, 0, SEEK_SET) == 0 && ftruncate(descriptor, 0) == 0)
+#define CLOSE_TRACE_FILE(descriptor) close(descriptor)
+#endif
+
+#define PUT_WORD(p, value) (p)[0] = (value) >> 8; (p)[1] = (value) & 0xFF; (p) += 2
+
+static TRACE* crash_trace = NULL;
+
+static void handle_crash(int signal_number);
+
+TRACE* create_trace(uint32_t size, const char* file_name)
+{
+	assert(size % TRACE_BLOCK_SIZE == 0);
+	TRACE* trace = calloc(1, sizeof(TRACE));
+	assert(trace);
+	trace->buffer = calloc(size, 1);
+	assert(trace->buffer);
+	trace->size = size;
+	trace->file_name = malloc(strlen(file_name) + 1);
+	assert(trace->file_name);
+	strcpy(trace->file_name, file_name);
+	trace->descriptor = OPEN_TRACE_FILE(file_name);
+	return trace;
+}
+
+void delete_trace(TRACE* trace)
+{
+	if (crash_trace == trace)
+	{
+		crash_trace = NULL;
+	}
+	if (trace->descriptor >= 0)
+	{
+		CLOSE_TRACE_FILE(trace->descriptor);
+	}
+	free(trace->file_name);
+	free(trace->buffer);
+	free(trace);
+}
+
+void take_trace_snapshot(MACHINE* machine, TRACE_SNAPSHOT* snapshot)
+{
+	memcpy(snapshot->v_reg, machine->v_reg, NUM_V_REGS);
+	snapshot->pc_reg = machine->pc_reg;
+	snapshot->i_reg = machine->i_reg;
+	snapshot->s_reg = machine->s_reg;
+	snapshot->d_counter = machine->d_counter;
+	snapshot->s_counter = machine->s_counter;
+	snapshot->waiting_for_input = machine->waiting_for_input;
+}
+
+//Called after every instruction while tracing, so it only compares and copies bytes into the preallocated ring
+void record_trace(TRACE* trace, MACHINE* machine, uint16_t opcode, const TRACE_SNAPSHOT* before)
+{
+	if (before->waiting_for_input && machine->waiting_for_input)
+	{
+		return;
+	}
+	uint32_t block_offset = trace->head % TRACE_BLOCK_SIZE;
+	if (block_offset + MAX_TRACE_RECORD_SIZE > TRACE_BLOCK_SIZE)
+	{
+		trace->buffer[trace->head] = 0;
+		trace->head += TRACE_BLOCK_SIZE - block_offset;
+		if (trace->head >= trace->size)
+		{
+			trace->head = 0;
+			trace->wrapped = true;
+		}
+	}
+	uint8_t* start = trace->buffer + trace->head;
+	uint8_t* p = start + 1;
+	uint16_t v_mask = 0;
+	uint8_t special_mask = 0;
+	PUT_WORD(p, before->pc_reg);
+	PUT_WORD(p, opcode);
+	uint8_t* masks = p;
+	p += 3;
+	for (uint8_t i = 0; i < NUM_V_REGS; i++)
+	{
+		if (machine->v_reg[i] != before->v_reg[i])
+		{
+			v_mask |= 1 << i;
+			*p++ = machine->v_reg[i];
+		}
+	}
+	if (machine->i_reg != before->i_reg)
+	{
+		special_mask |= TRACE_I_CHANGED;
+		PUT_WORD(p, machine->i_reg);
+	}
+	if (machine->s_reg != before->s_reg)
+	{
+		special_mask |= TRACE_S_CHANGED;
+		PUT_WORD(p, machine->s_reg);
+	}
+	if (machine->d_counter != before->d_counter)
+	{
+		special_mask |= TRACE_DT_CHANGED;
+		*p++ = machine->d_counter;
+	}
+	if (machine->s_counter != before->s_counter)
+	{
+		special_mask |= TRACE_ST_CHANGED;
+		*p++ = machine->s_counter;
+	}
+	PUT_WORD(masks, v_mask);
+	*masks = special_mask;
+	*start = (uint8_t)(p - start);
+	trace->head += *start;
+	if (trace->head >= trace->size)
+	{
+		trace->head = 0;
+		trace->wrapped = true;
+	}
+	trace->num_records++;
+}
+
+static bool write_bytes(int descriptor, const uint8_t* data, uint32_t length)
+{
+	while (length > 0)
+	{
+		int written = (int)WRITE_TRACE_FILE(descriptor, data, length);
+		if (written <= 0)
+		{
+			return false;
+		}
+		data += written;
+		length -= written;
+	}
+	return true;
+}
+
+static bool write_block(int descriptor, const uint8_t* block, uint32_t length)
+{
+	uint32_t used = 0;
+	while (used < length && block[used] != 0)
+	{
+		used += block[used];
+	}
+	return write_bytes(descriptor, block, used);
+}
+
+//Writes the records oldest first. Once the ring has wrapped, the oldest intact block is the one after the head.
+//The file is opened by create_trace and only written here, with neither stdio nor allocation, so the crash handler
+//can call this too.
+bool flush_trace(TRACE* trace)
+{
+	if (trace->descriptor < 0 || !EMPTY_TRACE_FILE(trace->descriptor))
+	{
+		return false;
+	}
+	bool success = write_bytes(trace->descriptor, (const uint8_t*)TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC) - 1);
+	uint32_t head_block = trace->head - trace->head % TRACE_BLOCK_SIZE;
+	if (trace->wrapped)
+	{
+		for (uint32_t block = head_block + TRACE_BLOCK_SIZE; block < trace->size; block += TRACE_BLOCK_SIZE)
+		{
+			success &= write_block(trace->descriptor, trace->buffer + block, TRACE_BLOCK_SIZE);
+		}
+	}
+	for (uint32_t block = 0; block < head_block; block += TRACE_BLOCK_SIZE)
+	{
+		success &= write_block(trace->descriptor, trace->buffer + block, TRACE_BLOCK_SIZE);
+	}
+	success &= write_block(trace->descriptor, trace->buffer + head_block, trace->head - head_block);
+	return success;
+}
+
+void install_trace_crash_handler(TRACE* trace)
+{
+	crash_trace = trace;
+	signal(SIGSEGV, handle_crash);
+	signal(SIGABRT, handle_crash);
+	signal(SIGFPE, handle_crash);
+	signal(SIGILL, handle_crash);
+}
+
+//Only write and lseek run here, both async-signal-safe, so a crash inside stdio or malloc still leaves a trace
+static void handle_crash(int signal_number)
+{
+	if (crash_trace)
+	{
+		flush_trace(crash_trace);
+		crash_trace = NULL;
+	}
+	signal(signal_number, SIG_DFL);
+	raise(signal_number);
+}
\ No newline at end of file
@@ -0,0 +1,145 @@
+﻿#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "struct_workload.h"
+#include "opcodes.h"
+
+static uint8_t parse_settings(const char* text, WORKLOAD_SETTING* settings, int first_base);
+
+//Parses "<rom> <frames> <columns...> [options]" in place, with num_columns tool-specific columns after the frame
+//count returned in columns. Frame counts are decimal and everything else hexadecimal:
+//  keys=<frame>:<mask>,...   keypad mask held from that frame on, bit k for key k
+//  poke=<address>:<byte>,... RAM written after loading, e.g. 1FF:01 to pick a test in a menu
+//  ram=<address>:<length>,...  RAM a tool looks at after the run
+//  ticks=<n>                  instructions per frame, DEFAULT_WORKLOAD_TICKS by default
+//  wrap, large               y_wrap_enabled and large_sprites_enabled
+//Everything after # is a comment. Returns false for lines without a workload.
+bool parse_workload(char* line, WORKLOAD* workload, char** columns, uint8_t num_columns)
+{
+	char* comment = strchr(line, '#');
+	if (comment)
+	{
+		*comment = '\0';
+	}
+	char* rom = strtok(line, " \t\r\n");
+	char* frames = strtok(NULL, " \t\r\n");
+	if (!rom || !frames || strlen(rom) >= MAX_WORKLOAD_LINE)
+	{
+		return false;
+	}
+	for (uint8_t i = 0; i < num_columns; i++)
+	{
+		columns[i] = strtok(NULL, " \t\r\n");
+		if (!columns[i])
+		{
+			return false;
+		}
+	}
+	memset(workload, 0, sizeof(WORKLOAD));
+	strcpy(workload->rom, rom);
+	const char* base = rom;
+	for (const char* p = rom; *p; p++)
+	{
+		if (*p == '/' || *p == '\\')
+		{
+			base = p + 1;
+		}
+	}
+	strcpy(workload->name, base);
+	char* extension = strrchr(workload->name, '.');
+	if (extension)
+	{
+		*extension = '\0';
+	}
+	workload->frames = (uint16_t)atoi(frames);
+	workload->ticks = DEFAULT_WORKLOAD_TICKS;
+	for (char* option = strtok(NULL, " \t\r\n"); option; option = strtok(NULL, " \t\r\n"))
+	{
+		if (strncmp(option, "keys=", 5) == 0)
+		{
+			workload->num_keys = parse_settings(option + 5, workload->keys, 10);
+		}
+		else if (strncmp(option, "poke=", 5) == 0)
+		{
+			workload->num_pokes = parse_settings(option + 5, workload->pokes, 16);
+		}
+		else if (strncmp(option, "ram=", 4) == 0)
+		{
+			workload->num_ram = parse_settings(option + 4, workload->ram, 16);
+		}
+		else if (strncmp(option, "ticks=", 6) == 0)
+		{
+			workload->ticks = (uint16_t)atoi(option + 6);
+		}
+		else if (strcmp(option, "wrap") == 0)
+		{
+			workload->y_wrap = true;
+		}
+		else if (strcmp(option, "large") == 0)
+		{
+			workload->large_sprites = true;
+		}
+	}
+	return true;
+}
+
+//The second value of a setting is always hexadecimal
+static uint8_t parse_settings(const char* text, WORKLOAD_SETTING* settings, int first_base)
+{
+	uint8_t count = 0;
+	while (*text && count < MAX_WORKLOAD_SETTINGS)
+	{
+		char* end;
+		settings[count].first = (uint16_t)strtoul(text, &end, first_base);
+		if (*end != ':')
+		{
+			break;
+		}
+		settings[count++].second = (uint16_t)strtoul(end + 1, &end, 16);
+		text = *end == ',' ? end + 1 : end;
+	}
+	return count;
+}
+
+//A headless machine with the workload's quirks, program and pokes, ready for play_workload
+MACHINE* create_workload_machine(const WORKLOAD* workload, const uint8_t* program, uint16_t size, bool fusion_enabled)
+{
+	MACHINE* machine = create_headless_machine();
+	machine->y_wrap_enabled = workload->y_wrap;
+	machine->large_sprites_enabled = workload->large_sprites;
+	machine->fusion_enabled = fusion_enabled;
+	load_program_data(machine, workload->name, program, size);
+	for (uint8_t i = 0; i < workload->num_pokes; i++)
+	{
+		*RAM_AT(machine, workload->pokes[i].first) = (uint8_t)workload->pokes[i].second;
+		mirror_ram_writes(machine, workload->pokes[i].first, 1);
+	}
+	return machine;
+}
+
+//Steps the machine the way the frontend does, a fixed number of instructions per frame and then the timers, with
+//the scripted keys pressed at the start of their frames
+void play_workload(MACHINE* machine, const WORKLOAD* workload)
+{
+	uint8_t next_key = 0;
+	for (uint16_t frame = 0; frame < workload->frames; frame++)
+	{
+		while (next_key < workload->num_keys && workload->keys[next_key].first <= frame)
+		{
+			press_keypad(machine, workload->keys[next_key++].second);
+		}
+		for (uint16_t tick = 0; tick < workload->ticks; tick++)
+		{
+			machine->step(machine);
+		}
+		machine->d_counter -= machine->d_counter > 0;
+		machine->s_counter -= machine->s_counter > 0;
+	}
+}
+
+double get_seconds()
+{
+	struct timespec now;
+	timespec_get(&now, TIME_UTC);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
\ No newline at end of file
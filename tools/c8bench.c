@@ -0,0 +1,105 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "machine.h"
+#include "struct_machine.h"
+#include "opcodes.h"
+#include "fusion.h"
+#include "phosphor.h"
+
+//Interpreter benchmark. Usage: c8bench [rom] [ticks]
+//Times each fused idiom in a synthetic loop with fusion on and off, then the given ROM if any, then the phosphor filter.
+
+#define DEFAULT_BENCH_TICKS 20000000
+#define PHOSPHOR_BENCH_FRAMES 100000
+
+typedef struct IDIOM_PROGRAM
+{
+	FUSION_KIND kind;
+	uint8_t code[8];
+	uint8_t size;
+	uint8_t d_counter;
+}IDIOM_PROGRAM;
+
+static const IDIOM_PROGRAM idiom_programs[] =
+{
+	{ FUSION_SET_PAIR, { 0x61, 0x05, 0x62, 0x07, 0x12, 0x00 }, 6, 0 },
+	{ FUSION_POINT_AND_DRAW, { 0xA3, 0x00, 0xD0, 0x15, 0x12, 0x00 }, 6, 0 },
+	{ FUSION_TIMER_WAIT, { 0xF0, 0x07, 0x30, 0x00, 0x12, 0x00, 0x12, 0x00 }, 8, 0xFF },
+	{ FUSION_COUNTED_LOOP, { 0x70, 0x01, 0x30, 0x00, 0x12, 0x00, 0x12, 0x00 }, 8, 0 }
+};
+
+static double get_seconds()
+{
+	struct timespec now;
+	timespec_get(&now, TIME_UTC);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+//Each tick is one opcode timer event, which is one instruction on average in both modes
+static double time_ticks(MACHINE* machine, bool fusion_enabled, uint64_t ticks, uint8_t d_counter)
+{
+	reset_machine(machine);
+	machine->d_counter = d_counter;
+	machine->fusion_enabled = fusion_enabled;
+	update_step_function(machine);
+	double start = get_seconds();
+	for (uint64_t i = 0; i < ticks; i++)
+	{
+		machine->step(machine);
+	}
+	return (get_seconds() - start) * 1e9 / ticks;
+}
+
+static void report(const char* name, MACHINE* machine, uint64_t ticks, uint8_t d_counter)
+{
+	double plain = time_ticks(machine, false, ticks, d_counter);
+	double fused = time_ticks(machine, true, ticks, d_counter);
+	printf("%-20s %8.2f ns %8.2f ns %7.2fx\n", name, plain, fused, plain / fused);
+}
+
+//A screen of random pixels toggled every frame, which keeps every pixel either lit or decaying
+static void report_phosphor(uint8_t width, uint8_t height)
+{
+	static PHOSPHOR phosphor;
+	uint64_t pixel_row[PHOSPHOR_MAX_WIDTH / 64 * PHOSPHOR_MAX_HEIGHT];
+	for (size_t i = 0; i < sizeof(pixel_row) / sizeof(pixel_row[0]); i++)
+	{
+		pixel_row[i] = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ rand();
+	}
+	reset_phosphor(&phosphor, width, height);
+	phosphor.decay_shift = DEFAULT_PHOSPHOR_DECAY_SHIFT;
+	phosphor.enabled = true;
+	double start = get_seconds();
+	for (uint32_t i = 0; i < PHOSPHOR_BENCH_FRAMES; i++)
+	{
+		pixel_row[i % (sizeof(pixel_row) / sizeof(pixel_row[0]))] ^= i;
+		update_phosphor(&phosphor, pixel_row);
+	}
+	printf("Phosphor %ux%u: %.2f us per frame\n", width, height, (get_seconds() - start) * 1e6 / PHOSPHOR_BENCH_FRAMES);
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t ticks = argc > 2 ? strtoull(argv[2], NULL, 0) : DEFAULT_BENCH_TICKS;
+	MACHINE* machine = create_headless_machine();
+	printf("Headless footprint: %zu bytes per MACHINE\n\n", sizeof(MACHINE));
+	printf("%-20s %11s %11s %8s\n", "workload", "plain/op", "fused/op", "speedup");
+	for (size_t i = 0; i < sizeof(idiom_programs) / sizeof(idiom_programs[0]); i++)
+	{
+		const IDIOM_PROGRAM* idiom = &idiom_programs[i];
+		load_program_data(machine, fusion_kind_to_string(idiom->kind), idiom->code, idiom->size);
+		report(fusion_kind_to_string(idiom->kind), machine, ticks, idiom->d_counter);
+	}
+	if (argc > 1)
+	{
+		load_program(machine, argv[1]);
+		report("ROM", machine, ticks, 0);
+	}
+	printf("\n");
+	report_phosphor(64, 32);
+	report_phosphor(128, 64);
+	delete_machine(machine);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,259 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "machine.h"
+#include "struct_machine.h"
+#include "struct_workload.h"
+#include "pool.h"
+
+//Conformance runner. Usage: c8conform [manifest] [--update]
+//Runs every test ROM listed in the manifest headless for a fixed number of frames, with fusion on and off, and
+//compares a hash of the screen, registers and chosen RAM against the golden value. --update records the current
+//results as golden. A case without a golden hash fails until it is recorded, and so does a run in which no case
+//passed, so a manifest without goldens or ROMs cannot pass by checking nothing. Expected screens are kept as
+//<name>.expected.pbm next to the manifest; a failing case writes <name>.actual.pbm beside it. ctest runs the default
+//manifest from the source directory.
+//
+//Manifest lines: <rom> <frames> <hash or -> [options], with the options of parse_workload in src/workload.c:
+//  keys=<frame>:<mask>,...  keypad mask held from that frame on, frame in decimal, mask in hex with bit k for key k
+//  poke=<address>:<byte>,... RAM written after loading, both in hex, e.g. 1FF:01 to pick a test in a menu
+//  ram=<address>:<length>,... RAM included in the hash, both in hex
+//  ticks=<n>                 instructions per frame, 12 by default
+//  wrap, large              y_wrap_enabled and large_sprites_enabled
+//Everything after # is a comment.
+
+#define DEFAULT_MANIFEST "resources/conformance.txt"
+#define MAX_CASES 256
+
+typedef struct CASE
+{
+	char line[MAX_WORKLOAD_LINE]; //as read, rewritten by --update
+	WORKLOAD workload;
+	bool recorded;
+	uint64_t golden;
+	bool is_test; //the line holds a case rather than a comment
+	bool missing; //ROM could not be read
+	uint64_t hashes[2]; //fusion off, fusion on
+	uint64_t pixel_row[2][NUM_PIXEL_ROWS];
+}CASE;
+
+typedef struct SUITE
+{
+	CASE* cases;
+	uint16_t num_cases;
+}SUITE;
+
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t size)
+{
+	const uint8_t* bytes = data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+	}
+	return hash;
+}
+
+static void parse_case(CASE* test)
+{
+	char copy[MAX_WORKLOAD_LINE];
+	strcpy(copy, test->line);
+	char* golden;
+	if (!parse_workload(copy, &test->workload, &golden, 1))
+	{
+		return;
+	}
+	test->is_test = true;
+	test->recorded = strcmp(golden, "-") != 0;
+	test->golden = strtoull(golden, NULL, 16);
+}
+
+static uint64_t run_case(const WORKLOAD* workload, const uint8_t* program, uint16_t size, bool fusion_enabled, uint64_t* pixel_row)
+{
+	MACHINE* machine = create_workload_machine(workload, program, size, fusion_enabled);
+	play_workload(machine, workload);
+	uint64_t hash = hash_bytes(0xCBF29CE484222325ull, machine->pixel_row, sizeof(machine->pixel_row));
+	hash = hash_bytes(hash, machine->v_reg, sizeof(machine->v_reg));
+	hash = hash_bytes(hash, &machine->i_reg, sizeof(machine->i_reg));
+	hash = hash_bytes(hash, &machine->fault, sizeof(machine->fault));
+	for (uint8_t i = 0; i < workload->num_ram; i++)
+	{
+		for (uint16_t j = 0; j < workload->ram[i].second; j++)
+		{
+			hash = hash_bytes(hash, RAM_AT(machine, workload->ram[i].first + j), 1);
+		}
+	}
+	memcpy(pixel_row, machine->pixel_row, sizeof(machine->pixel_row));
+	delete_machine(machine);
+	return hash;
+}
+
+static void run_suite_case(void* context, uint16_t index)
+{
+	CASE* test = &((SUITE*)context)->cases[index];
+	if (!test->is_test)
+	{
+		return;
+	}
+	uint8_t program[RAM_SIZE];
+	FILE* file = fopen(test->workload.rom, "rb");
+	if (!file)
+	{
+		test->missing = true;
+		return;
+	}
+	uint16_t size = (uint16_t)fread(program, 1, RAM_SIZE - PROGRAM_BASE_ADDRESS, file);
+	fclose(file);
+	for (uint8_t fusion = 0; fusion < 2; fusion++)
+	{
+		test->hashes[fusion] = run_case(&test->workload, program, size, fusion, test->pixel_row[fusion]);
+	}
+}
+
+static bool write_pbm(const char* file_name, const uint64_t* pixel_row)
+{
+	FILE* file = fopen(file_name, "w");
+	if (!file)
+	{
+		return false;
+	}
+	fprintf(file, "P1\n%d %d\n", NUM_PIXEL_COLS, NUM_PIXEL_ROWS);
+	for (uint8_t y = 0; y < NUM_PIXEL_ROWS; y++)
+	{
+		for (uint8_t x = 0; x < NUM_PIXEL_COLS; x++)
+		{
+			fputc((pixel_row[y] >> (NUM_PIXEL_COLS - 1 - x)) & 1 ? '1' : '0', file);
+		}
+		fputc('\n', file);
+	}
+	fclose(file);
+	return true;
+}
+
+static void rewrite_hash(CASE* test)
+{
+	char* rom = test->line + strspn(test->line, " \t");
+	char* frames = rom + strcspn(rom, " \t");
+	frames += strspn(frames, " \t");
+	char* golden = frames + strcspn(frames, " \t");
+	golden += strspn(golden, " \t");
+	char* rest = golden + strcspn(golden, " \t\r\n");
+	char updated[MAX_WORKLOAD_LINE];
+	snprintf(updated, sizeof(updated), "%.*s%016llX%s", (int)(golden - test->line), test->line, (unsigned long long)test->hashes[0], rest);
+	strcpy(test->line, updated);
+}
+
+int main(int argc, char** argv)
+{
+	const char* manifest = DEFAULT_MANIFEST;
+	bool update = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--update") == 0)
+		{
+			update = true;
+		}
+		else
+		{
+			manifest = argv[i];
+		}
+	}
+	FILE* file = fopen(manifest, "r");
+	if (!file)
+	{
+		fprintf(stderr, "Could not read %s\n", manifest);
+		return 1;
+	}
+	SUITE suite = { calloc(MAX_CASES, sizeof(CASE)), 0 };
+	if (!suite.cases)
+	{
+		fclose(file);
+		return 1;
+	}
+	while (suite.num_cases < MAX_CASES && fgets(suite.cases[suite.num_cases].line, MAX_WORKLOAD_LINE, file))
+	{
+		parse_case(&suite.cases[suite.num_cases++]);
+	}
+	fclose(file);
+	char directory[MAX_WORKLOAD_LINE];
+	strcpy(directory, manifest);
+	char* slash = strrchr(directory, '/');
+	strcpy(slash ? slash + 1 : directory, "");
+
+	double start = get_seconds();
+	POOL* pool = create_pool(get_core_count() - 1);
+	run_pool(pool, run_suite_case, &suite, suite.num_cases);
+	delete_pool(pool);
+
+	uint16_t passed = 0;
+	uint16_t failed = 0;
+	uint16_t skipped = 0;
+	for (uint16_t i = 0; i < suite.num_cases; i++)
+	{
+		CASE* test = &suite.cases[i];
+		char image[sizeof(directory) + sizeof(test->workload.name) + sizeof(".expected.pbm")];
+		if (!test->is_test)
+		{
+			continue;
+		}
+		if (test->missing)
+		{
+			printf("SKIP  %s (missing %s)\n", test->workload.name, test->workload.rom);
+			skipped++;
+			continue;
+		}
+		if (test->hashes[0] != test->hashes[1])
+		{
+			printf("FAIL  %s: fused run %016llX differs from plain run %016llX\n", test->workload.name, (unsigned long long)test->hashes[1],
+				(unsigned long long)test->hashes[0]);
+			snprintf(image, sizeof(image), "%s%s.actual.pbm", directory, test->workload.name);
+			write_pbm(image, test->pixel_row[1]);
+			failed++;
+			continue;
+		}
+		if (update)
+		{
+			rewrite_hash(test);
+			snprintf(image, sizeof(image), "%s%s.expected.pbm", directory, test->workload.name);
+			write_pbm(image, test->pixel_row[0]);
+			printf("SET   %s %016llX\n", test->workload.name, (unsigned long long)test->hashes[0]);
+			passed++;
+		}
+		else if (!test->recorded)
+		{
+			printf("NEW   %s %016llX, no golden hash, record it with --update\n", test->workload.name, (unsigned long long)test->hashes[0]);
+			failed++;
+		}
+		else if (test->hashes[0] != test->golden)
+		{
+			snprintf(image, sizeof(image), "%s%s.actual.pbm", directory, test->workload.name);
+			write_pbm(image, test->pixel_row[0]);
+			printf("FAIL  %s: %016llX, expected %016llX, screen written to %s\n", test->workload.name, (unsigned long long)test->hashes[0],
+				(unsigned long long)test->golden, image);
+			failed++;
+		}
+		else
+		{
+			printf("PASS  %s\n", test->workload.name);
+			passed++;
+		}
+	}
+	if (update)
+	{
+		file = fopen(manifest, "w");
+		for (uint16_t i = 0; file && i < suite.num_cases; i++)
+		{
+			fputs(suite.cases[i].line, file);
+		}
+		if (file)
+		{
+			fclose(file);
+		}
+	}
+	printf("%hu passed, %hu failed, %hu skipped in %.3f s\n", passed, failed, skipped, get_seconds() - start);
+	if (passed == 0)
+	{
+		printf("No case was checked\n");
+	}
+	free(suite.cases);
+	return failed > 0 || passed == 0;
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+﻿#include <stdio.h>
+#include <string.h>
+#include "struct_analysis.h"
+
+//Static disassembler. Usage: c8dis <rom> [--cfg] prints an annotated listing, or the control-flow graph in dot format
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s <rom> [--cfg]\n", argv[0]);
+		return 1;
+	}
+	FILE* file = fopen(argv[1], "rb");
+	if (!file)
+	{
+		fprintf(stderr, "Could not open %s\n", argv[1]);
+		return 1;
+	}
+	static uint8_t RAM[RAM_SIZE];
+	uint16_t program_size = fread(RAM + PROGRAM_BASE_ADDRESS, BYTE_SIZE, RAM_SIZE - PROGRAM_BASE_ADDRESS, file);
+	fclose(file);
+	ANALYSIS* analysis = analyze_program(RAM, PROGRAM_BASE_ADDRESS, program_size);
+	if (argc > 2 && strcmp(argv[2], "--cfg") == 0)
+	{
+		export_cfg(analysis, stdout);
+	}
+	else
+	{
+		export_listing(analysis, RAM, stdout);
+	}
+	delete_analysis(analysis);
+	return 0;
+}
\ No newline at end of file
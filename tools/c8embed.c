@@ -0,0 +1,59 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+
+//Turns asset files into C source for builds with C8_EMBEDDED_ASSETS. Usage: c8embed <output.c> <file>...
+//Each file is embedded under the path given on the command line, which is the name open_asset looks up, e.g.
+//c8embed assets.c "resources/sound.wav" "resources/UbuntuMono[wght].ttf"
+
+#define BYTES_PER_LINE 16
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "Usage: c8embed <output.c> <file>...\n");
+		return 1;
+	}
+	FILE* out = fopen(argv[1], "w");
+	if (!out)
+	{
+		fprintf(stderr, "Could not write %s\n", argv[1]);
+		return 1;
+	}
+	long* sizes = calloc(argc, sizeof(long));
+	if (!sizes)
+	{
+		fclose(out);
+		return 1;
+	}
+	fprintf(out, "//Generated by c8embed, do not edit\n#include \"assets.h\"\n\n");
+	for (int i = 2; i < argc; i++)
+	{
+		FILE* file = fopen(argv[i], "rb");
+		if (!file)
+		{
+			fprintf(stderr, "Could not read %s\n", argv[i]);
+			fclose(out);
+			free(sizes);
+			return 1;
+		}
+		fprintf(out, "static const uint8_t asset_%d[] =\n{", i - 2);
+		int byte;
+		while ((byte = fgetc(file)) != EOF)
+		{
+			fprintf(out, "%s0x%02X,", sizes[i] % BYTES_PER_LINE == 0 ? "\n\t" : " ", byte);
+			sizes[i]++;
+		}
+		fprintf(out, "\n};\n\n");
+		fclose(file);
+	}
+	fprintf(out, "const ASSET embedded_assets[] =\n{\n");
+	for (int i = 2; i < argc; i++)
+	{
+		fprintf(out, "\t{ \"%s\", asset_%d, %ld },\n", argv[i], i - 2, sizes[i]);
+	}
+	fprintf(out, "};\n\nconst uint16_t num_embedded_assets = %d;\n", argc - 2);
+	fclose(out);
+	free(sizes);
+	return 0;
+}
\ No newline at end of file
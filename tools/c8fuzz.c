@@ -0,0 +1,153 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "fuzz.h"
+#include "machine.h"
+#include "opcodes.h"
+
+//Coverage-guided fuzzer for ROMs and the interpreter. Usage:
+//  c8fuzz <rom> [--seconds N] [--frames N] [--rom-mutations] [--out <directory>]
+//  c8fuzz <rom> --replay <crash file>
+//Each new crash is printed and its input saved as <directory>/crash-<n>.c8fuzz, readable by --replay of the same build with the same --frames.
+
+#define DEFAULT_FUZZ_SECONDS 60
+#define FUZZ_FILE_MAGIC "C8FUZZ1"
+#define EXECUTIONS_PER_CHECK 1024 //between clock reads
+
+static double get_seconds()
+{
+	struct timespec now;
+	timespec_get(&now, TIME_UTC);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static uint16_t read_rom(const char* file_name, uint8_t* data, uint16_t capacity)
+{
+	FILE* file = fopen(file_name, "rb");
+	if (!file)
+	{
+		return 0;
+	}
+	uint16_t size = (uint16_t)fread(data, 1, capacity, file);
+	fclose(file);
+	return size;
+}
+
+static bool save_crash(const char* directory, uint16_t index, const FUZZ_CRASH* crash, char* file_name, size_t length)
+{
+	snprintf(file_name, length, "%s/crash-%hu.c8fuzz", directory, index);
+	FILE* file = fopen(file_name, "wb");
+	if (!file)
+	{
+		return false;
+	}
+	bool success = fwrite(FUZZ_FILE_MAGIC, 1, sizeof(FUZZ_FILE_MAGIC), file) == sizeof(FUZZ_FILE_MAGIC);
+	success &= fwrite(&crash->input, sizeof(FUZZ_INPUT), 1, file) == 1;
+	fclose(file);
+	return success;
+}
+
+static int replay(FUZZER* fuzzer, const char* file_name)
+{
+	FILE* file = fopen(file_name, "rb");
+	char magic[sizeof(FUZZ_FILE_MAGIC)];
+	static FUZZ_INPUT input;
+	bool valid = file && fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, FUZZ_FILE_MAGIC, sizeof(magic)) == 0
+		&& fread(&input, sizeof(input), 1, file) == 1;
+	if (file)
+	{
+		fclose(file);
+	}
+	if (!valid)
+	{
+		fprintf(stderr, "%s is not a crash file\n", file_name);
+		return 1;
+	}
+	uint16_t pc_reg;
+	uint8_t fault = replay_fuzz_input(fuzzer, &input, &pc_reg);
+	printf("%s at %03hX, seed %08X, %hhu ROM patches\n", fault_to_string(fault), pc_reg, input.seed, input.num_patches);
+	for (uint8_t i = 0; i < input.num_patches; i++)
+	{
+		printf("  [%03hX] = %02hhX\n", input.patch_address[i], input.patch_value[i]);
+	}
+	return fault == FAULT_NONE ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: c8fuzz <rom> [--seconds N] [--frames N] [--rom-mutations] [--out <directory>] [--replay <crash file>]\n");
+		return 1;
+	}
+	FUZZ_OPTIONS options = { DEFAULT_FUZZ_FRAMES, DEFAULT_FUZZ_TICKS_PER_FRAME, false, (uint32_t)time(NULL) };
+	double seconds = DEFAULT_FUZZ_SECONDS;
+	const char* directory = ".";
+	const char* replay_file = NULL;
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+		{
+			seconds = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			options.frames = (uint16_t)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--rom-mutations") == 0)
+		{
+			options.mutate_rom = true;
+		}
+		else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+		{
+			directory = argv[++i];
+		}
+		else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+		{
+			replay_file = argv[++i];
+		}
+	}
+	uint8_t program[4096];
+	uint16_t size = read_rom(argv[1], program, sizeof(program) - 0x200);
+	if (size == 0)
+	{
+		fprintf(stderr, "Could not read %s\n", argv[1]);
+		return 1;
+	}
+	FUZZER* fuzzer = create_fuzzer(program, size, &options);
+	if (replay_file)
+	{
+		int result = replay(fuzzer, replay_file);
+		delete_fuzzer(fuzzer);
+		return result;
+	}
+	double start = get_seconds();
+	double next_report = start + 1;
+	double now = start;
+	while (now - start < seconds)
+	{
+		for (uint16_t i = 0; i < EXECUTIONS_PER_CHECK; i++)
+		{
+			const FUZZ_CRASH* crash = fuzz_once(fuzzer);
+			if (crash)
+			{
+				char file_name[512];
+				uint16_t index = get_fuzz_stats(fuzzer).num_crashes;
+				bool saved = save_crash(directory, index, crash, file_name, sizeof(file_name));
+				printf("Crash %hu: %s at %03hX (opcode %04hX)%s%s\n", index, fault_to_string(crash->fault), crash->pc_reg, crash->opcode,
+					saved ? ", saved to " : ", not saved", saved ? file_name : "");
+			}
+		}
+		now = get_seconds();
+		if (now >= next_report)
+		{
+			FUZZ_STATS stats = get_fuzz_stats(fuzzer);
+			printf("%6.0fs  %10llu execs  %8.0f execs/s  %6u edges  %5hu corpus  %3hu crashes\n", now - start,
+				(unsigned long long)stats.executions, stats.executions / (now - start), stats.edges, stats.corpus_size, stats.num_crashes);
+			next_report += 1;
+		}
+	}
+	delete_fuzzer(fuzzer);
+	return 0;
+}
\ No newline at end of file
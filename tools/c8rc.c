@@ -0,0 +1,386 @@
+﻿#include <stdio.h>
+#include <string.h>
+#include "disassembler.h"
+#include "struct_analysis.h"
+
+//Static recompiler. Usage: c8rc <rom> <output.c> [name]
+//Every basic block becomes a C function over MACHINE. Build the output together with the emulator sources and
+//C8_RECOMPILED defined to get a binary that runs the ROM without the interpreter. Blocks link statically known
+//successors and return sites through machine->next_block. Entry points that are not block starts, such as BNNN
+//targets and self-modified code, fall back to the interpreter through the dispatcher.
+
+static const ANALYSIS* analysis;
+
+static uint16_t read_word(const uint8_t* RAM, uint16_t address)
+{
+	return (RAM[address] << 8) | RAM[(address + 1) & (RAM_SIZE - 1)];
+}
+
+static bool is_compiled(const BASIC_BLOCK* block)
+{
+	for (uint16_t address = block->start; address < block->end; address++)
+	{
+		if (analysis->flags[address & (RAM_SIZE - 1)] & ADDRESS_SELF_MODIFIED)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//Writes the name of the compiled block starting at address, or NULL if there is none
+static const char* block_name(uint16_t address)
+{
+	static char names[2][16];
+	static uint8_t current = 0;
+	uint16_t index = analysis->block_index[address & (RAM_SIZE - 1)];
+	current ^= 1;
+	if (index == NO_BLOCK || !is_compiled(&analysis->blocks[index]))
+	{
+		return "NULL";
+	}
+	snprintf(names[current], sizeof(names[current]), "block_%03hX", address);
+	return names[current];
+}
+
+static void emit_goto(FILE* out, const char* indent, uint16_t target, uint16_t count)
+{
+	fprintf(out, "%smachine->pc_reg = 0x%03hX;\n%smachine->next_block = %s;\n%sreturn %hu;\n", indent, target, indent, block_name(target), indent, count);
+}
+
+static void emit_skip(FILE* out, uint16_t address, uint16_t count, const char* condition)
+{
+	fprintf(out, "\tif (%s)\n\t{\n", condition);
+	emit_goto(out, "\t\t", address + 2 * MEM_STEP, count);
+	fprintf(out, "\t}\n");
+	emit_goto(out, "\t", address + MEM_STEP, count);
+}
+
+static void emit_code_write_check(FILE* out, uint16_t address, uint16_t count, uint8_t length)
+{
+	fprintf(out, "\tif (writes_code(machine->i_reg, %hhu))\n\t{\n\t\tmachine->pc_reg = 0x%03hX;\n\t\tset_recompiled_program(machine, NULL);\n\t\treturn %hu;\n\t}\n",
+		length, (uint16_t)(address + MEM_STEP), count);
+}
+
+//Strict machines fault on the opcodes the interpreter ignores, which ends the block with the pc on the opcode
+static void emit_unknown(FILE* out, uint16_t address, uint16_t count)
+{
+	fprintf(out, "\tif (machine->strict_enabled)\n\t{\n\t\traise_fault(machine, FAULT_UNKNOWN_OPCODE, 0x%03hX);\n\t\treturn %hu;\n\t}\n", address, count);
+}
+
+//pc_reg is only kept up to date at block exits, so a fault raised by a write is moved onto the writing instruction
+static void emit_fault_check(FILE* out, uint16_t address, uint16_t count)
+{
+	fprintf(out, "\tif (machine->fault != FAULT_NONE)\n\t{\n\t\tmachine->pc_reg = 0x%03hX;\n\t\treturn %hu;\n\t}\n", address, count);
+}
+
+//Returns true if the instruction ends the block
+static bool emit_instruction(FILE* out, uint16_t address, uint16_t opcode, uint16_t count)
+{
+	char condition[64];
+	uint8_t x = GET_X(opcode);
+	uint8_t y = GET_Y(opcode);
+	uint16_t nnn = GET_NNN(opcode);
+	uint8_t nn = GET_NN(opcode);
+	uint8_t n = GET_N(opcode);
+	switch (GET_TYPE(opcode))
+	{
+	case 0x0:
+		if (nn == 0xE0)
+		{
+			fprintf(out, "\tmemset(machine->pixel_row, 0, sizeof(machine->pixel_row));\n\tmachine->dirty.rows = ALL_DIRTY_ROWS;\n");
+		}
+		else if (nn == 0xEE)
+		{
+			fprintf(out, "\trecompiled_return(machine, 0x%03hX);\n\treturn %hu;\n", address, count);
+			return true;
+		}
+		else
+		{
+			emit_unknown(out, address, count);
+		}
+		return false;
+	case 0x1:
+		emit_goto(out, "\t", nnn, count);
+		return true;
+	case 0x2:
+		fprintf(out, "\trecompiled_call(machine, 0x%03hX, 0x%03hX, %s, ", address, nnn, block_name(nnn));
+		fprintf(out, "%s);\n\treturn %hu;\n", block_name(address + MEM_STEP), count);
+		return true;
+	case 0x3:
+		snprintf(condition, sizeof(condition), "v[0x%hhX] == 0x%02hhX", x, nn);
+		emit_skip(out, address, count, condition);
+		return true;
+	case 0x4:
+		snprintf(condition, sizeof(condition), "v[0x%hhX] != 0x%02hhX", x, nn);
+		emit_skip(out, address, count, condition);
+		return true;
+	case 0x5:
+		snprintf(condition, sizeof(condition), x == y ? "true" : "v[0x%hhX] == v[0x%hhX]", x, y);
+		emit_skip(out, address, count, condition);
+		return true;
+	case 0x9:
+		snprintf(condition, sizeof(condition), x == y ? "false" : "v[0x%hhX] != v[0x%hhX]", x, y);
+		emit_skip(out, address, count, condition);
+		return true;
+	case 0x6:
+		fprintf(out, "\tv[0x%hhX] = 0x%02hhX;\n", x, nn);
+		return false;
+	case 0x7:
+		fprintf(out, "\tv[0x%hhX] += 0x%02hhX;\n", x, nn);
+		return false;
+	case 0x8:
+		//Comparing a register with itself is folded, which keeps the output free of self-comparison warnings
+		snprintf(condition, sizeof(condition), x == y ? "true" : "v[0x%hhX] <= v[0x%hhX]", n == 0x5 ? y : x, n == 0x5 ? x : y);
+		switch (n)
+		{
+		case 0x0:
+			fprintf(out, "\tv[0x%hhX] = v[0x%hhX];\n", x, y);
+			break;
+		case 0x1:
+			fprintf(out, "\tv[0x%hhX] |= v[0x%hhX];\n", x, y);
+			break;
+		case 0x2:
+			fprintf(out, "\tv[0x%hhX] &= v[0x%hhX];\n", x, y);
+			break;
+		case 0x3:
+			fprintf(out, "\tv[0x%hhX] ^= v[0x%hhX];\n", x, y);
+			break;
+		case 0x4:
+			fprintf(out, "\tflag = 0xFF < v[0x%hhX] + v[0x%hhX];\n\tv[0x%hhX] += v[0x%hhX];\n\tv[0xF] = flag;\n", x, y, x, y);
+			break;
+		case 0x5:
+			fprintf(out, "\tflag = %s;\n\tv[0x%hhX] -= v[0x%hhX];\n\tv[0xF] = flag;\n", condition, x, y);
+			break;
+		case 0x6:
+			fprintf(out, "\tflag = v[0x%hhX] & 1;\n\tv[0x%hhX] >>= 1;\n\tv[0xF] = flag;\n", x, x);
+			break;
+		case 0x7:
+			fprintf(out, "\tflag = %s;\n\tv[0x%hhX] = v[0x%hhX] - v[0x%hhX];\n\tv[0xF] = flag;\n", condition, x, y, x);
+			break;
+		case 0xE:
+			fprintf(out, "\tflag = v[0x%hhX] >> 7;\n\tv[0x%hhX] <<= 1;\n\tv[0xF] = flag;\n", x, x);
+			break;
+		default:
+			emit_unknown(out, address, count);
+			break;
+		}
+		return false;
+	case 0xA:
+		fprintf(out, "\tmachine->i_reg = 0x%03hX;\n", nnn);
+		return false;
+	case 0xB:
+		fprintf(out, "\tmachine->pc_reg = v[0] + 0x%03hX;\n\tmachine->next_block = NULL;\n\treturn %hu;\n", nnn, count);
+		return true;
+	case 0xC:
+		fprintf(out, "\texecute_opcode(machine, 0x%04hX);\n", opcode);
+		return false;
+	case 0xD:
+		fprintf(out, "\top_draw_sprite(machine, 0x%04hX);\n", opcode);
+		return false;
+	case 0xE:
+		if (nn == 0x9E)
+		{
+			snprintf(condition, sizeof(condition), "machine->key_pressed[v[0x%hhX]]", x);
+			emit_skip(out, address, count, condition);
+			return true;
+		}
+		else if (nn == 0xA1)
+		{
+			snprintf(condition, sizeof(condition), "!machine->key_pressed[v[0x%hhX]]", x);
+			emit_skip(out, address, count, condition);
+			return true;
+		}
+		emit_unknown(out, address, count);
+		return false;
+	case 0xF:
+		switch (nn)
+		{
+		case 0x07:
+			fprintf(out, "\tv[0x%hhX] = machine->d_counter;\n", x);
+			break;
+		case 0x0A:
+			fprintf(out, "\tmachine->pc_reg = 0x%03hX;\n\tstep_opcode(machine);\n\tmachine->next_block = NULL;\n\treturn %hu;\n", address, count);
+			return true;
+		case 0x15:
+			fprintf(out, "\tmachine->d_counter = v[0x%hhX];\n", x);
+			break;
+		case 0x18:
+			fprintf(out, "\tmachine->s_counter = v[0x%hhX];\n", x);
+			break;
+		case 0x1E:
+			fprintf(out, "\tmachine->i_reg += v[0x%hhX];\n", x);
+			break;
+		case 0x29:
+			fprintf(out, "\tmachine->i_reg = FONT_MEMORY_BASE_ADDRESS + v[0x%hhX] * 5;\n", x);
+			break;
+		case 0x33:
+			fprintf(out, "\tRAM_AT(machine, machine->i_reg)[0] = v[0x%hhX] / 100;\n\tRAM_AT(machine, machine->i_reg)[1] = (v[0x%hhX] / 10) %% 10;\n", x, x);
+			fprintf(out, "\tRAM_AT(machine, machine->i_reg)[2] = v[0x%hhX] %% 10;\n\tmirror_ram_writes(machine, machine->i_reg, 3);\n", x);
+			emit_fault_check(out, address, count);
+			emit_code_write_check(out, address, count, 3);
+			break;
+		case 0x55:
+			fprintf(out, "\tmemcpy(RAM_AT(machine, machine->i_reg), v, %hhu);\n\tmirror_ram_writes(machine, machine->i_reg, %hhu);\n", x + 1, x + 1);
+			emit_fault_check(out, address, count);
+			emit_code_write_check(out, address, count, x + 1);
+			break;
+		case 0x65:
+			fprintf(out, "\tCOUNT_OUT_OF_BOUNDS(machine, machine->i_reg, %hhu);\n\tmemcpy(v, RAM_AT(machine, machine->i_reg), %hhu);\n", x + 1, x + 1);
+			break;
+		default:
+			emit_unknown(out, address, count);
+			break;
+		}
+		return false;
+	}
+	return false;
+}
+
+//Which locals the block needs, so that the generated code compiles without unused variable warnings: v for any
+//instruction that reads or writes the registers, flag only for the arithmetic that sets VF
+static void scan_block(const uint8_t* RAM, const BASIC_BLOCK* block, bool* uses_registers, bool* sets_flag)
+{
+	*uses_registers = false;
+	*sets_flag = false;
+	for (uint16_t address = block->start; address < block->end; address += MEM_STEP)
+	{
+		uint16_t opcode = read_word(RAM, address);
+		uint8_t nn = GET_NN(opcode);
+		uint8_t n = GET_N(opcode);
+		switch (GET_TYPE(opcode))
+		{
+		case 0x3:
+		case 0x4:
+		case 0x6:
+		case 0x7:
+		case 0xB:
+			*uses_registers = true;
+			break;
+		case 0x5:
+		case 0x9:
+			*uses_registers |= GET_X(opcode) != GET_Y(opcode);
+			break;
+		case 0x8:
+			*uses_registers |= n <= 0x7 || n == 0xE;
+			*sets_flag |= (n >= 0x4 && n <= 0x7) || n == 0xE;
+			break;
+		case 0xE:
+			*uses_registers |= nn == 0x9E || nn == 0xA1;
+			break;
+		case 0xF:
+			*uses_registers |= nn == 0x07 || nn == 0x15 || nn == 0x18 || nn == 0x1E || nn == 0x29 || nn == 0x33 || nn == 0x55 || nn == 0x65;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static void emit_block(FILE* out, const uint8_t* RAM, const BASIC_BLOCK* block)
+{
+	char asm_text[32];
+	uint16_t count = 0;
+	bool uses_registers;
+	bool sets_flag;
+	scan_block(RAM, block, &uses_registers, &sets_flag);
+	fprintf(out, "static uint16_t block_%03hX(MACHINE* machine)\n{\n", block->start);
+	if (uses_registers)
+	{
+		fprintf(out, "\tuint8_t* v = machine->v_reg;\n");
+	}
+	if (sets_flag)
+	{
+		fprintf(out, "\tbool flag;\n");
+	}
+	for (uint16_t address = block->start; address < block->end; address += MEM_STEP)
+	{
+		uint16_t opcode = read_word(RAM, address);
+		opcode_to_string(asm_text, opcode);
+		fprintf(out, "\t//%03hX: %s\n", address, asm_text);
+		if (emit_instruction(out, address, opcode, ++count))
+		{
+			fprintf(out, "}\n\n");
+			return;
+		}
+	}
+	emit_goto(out, "\t", block->end, count);
+	fprintf(out, "}\n\n");
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "Usage: %s <rom> <output.c> [name]\n", argv[0]);
+		return 1;
+	}
+	FILE* file = fopen(argv[1], "rb");
+	if (!file)
+	{
+		fprintf(stderr, "Could not open %s\n", argv[1]);
+		return 1;
+	}
+	static uint8_t RAM[RAM_SIZE];
+	uint16_t program_size = fread(RAM + PROGRAM_BASE_ADDRESS, BYTE_SIZE, RAM_SIZE - PROGRAM_BASE_ADDRESS, file);
+	fclose(file);
+	FILE* out = fopen(argv[2], "w");
+	if (!out)
+	{
+		fprintf(stderr, "Could not create %s\n", argv[2]);
+		return 1;
+	}
+	ANALYSIS* program_analysis = analyze_program(RAM, PROGRAM_BASE_ADDRESS, program_size);
+	analysis = program_analysis;
+	fprintf(out, "//Generated by c8rc from %s, do not edit\n#include \"recompiler.h\"\n\n", argv[1]);
+	fprintf(out, "static const uint8_t rom[%hu] =\n{", program_size + 1);
+	for (uint16_t i = 0; i < program_size; i++)
+	{
+		fprintf(out, "%s0x%02hhX,", i % 16 == 0 ? "\n\t" : " ", RAM[PROGRAM_BASE_ADDRESS + i]);
+	}
+	fprintf(out, "\n};\n\nstatic const uint8_t code_map[%d] =\n{", RAM_SIZE / 8);
+	for (uint16_t i = 0; i < RAM_SIZE / 8; i++)
+	{
+		uint8_t bits = 0;
+		for (uint8_t j = 0; j < 8; j++)
+		{
+			bits |= ((analysis->flags[i * 8 + j] & (ADDRESS_CODE | ADDRESS_OPERAND)) != 0) << j;
+		}
+		fprintf(out, "%s0x%02hhX,", i % 16 == 0 ? "\n\t" : " ", bits);
+	}
+	fprintf(out, "\n};\n\n");
+	fprintf(out, "static bool writes_code(uint16_t address, uint8_t length)\n{\n"
+		"\tfor (uint8_t i = 0; i < length; i++)\n\t{\n"
+		"\t\tuint16_t byte = (address + i) & (RAM_SIZE - 1);\n"
+		"\t\tif (code_map[byte >> 3] & (1 << (byte & 7)))\n\t\t{\n\t\t\treturn true;\n\t\t}\n\t}\n"
+		"\treturn false;\n}\n\n");
+	for (uint16_t i = 0; i < analysis->num_blocks; i++)
+	{
+		if (is_compiled(&analysis->blocks[i]))
+		{
+			fprintf(out, "static uint16_t block_%03hX(MACHINE* machine);\n", analysis->blocks[i].start);
+		}
+	}
+	fprintf(out, "\n");
+	for (uint16_t i = 0; i < analysis->num_blocks; i++)
+	{
+		if (is_compiled(&analysis->blocks[i]))
+		{
+			emit_block(out, RAM, &analysis->blocks[i]);
+		}
+	}
+	fprintf(out, "static uint16_t run_block(MACHINE* machine)\n{\n\tswitch (machine->pc_reg)\n\t{\n");
+	for (uint16_t i = 0; i < analysis->num_blocks; i++)
+	{
+		if (is_compiled(&analysis->blocks[i]))
+		{
+			fprintf(out, "\tcase 0x%03hX:\n\t\treturn block_%03hX(machine);\n", analysis->blocks[i].start, analysis->blocks[i].start);
+		}
+	}
+	fprintf(out, "\t}\n\tstep_opcode(machine);\n\tmachine->next_block = NULL;\n\treturn 1;\n}\n\n");
+	fprintf(out, "const RECOMPILED_PROGRAM recompiled_program =\n{\n\t.name = \"%s\",\n\t.rom = rom,\n\t.size = %hu,\n\t.run_block = run_block\n};\n",
+		argc > 3 ? argv[3] : argv[1], program_size);
+	fclose(out);
+	delete_analysis(program_analysis);
+	return 0;
+}
\ No newline at end of file
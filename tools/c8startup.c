@@ -0,0 +1,53 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//Launches c8 --first-frame repeatedly and reports the wall time of each launch, process start and exit included.
+//Usage: c8startup <path to c8> [runs] [rom]
+
+#define DEFAULT_RUNS 10
+#define MAX_RUNS 1000
+
+static int compare_times(const void* a, const void* b)
+{
+	double x = *(const double*)a;
+	double y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: c8startup <path to c8> [runs] [rom]\n");
+		return 1;
+	}
+	int runs = argc > 2 ? atoi(argv[2]) : DEFAULT_RUNS;
+	if (runs < 1 || runs > MAX_RUNS)
+	{
+		runs = DEFAULT_RUNS;
+	}
+	char command[1024];
+	snprintf(command, sizeof(command), "\"%s\" --first-frame%s%s%s", argv[1], argc > 3 ? " \"" : "", argc > 3 ? argv[3] : "", argc > 3 ? "\"" : "");
+	static double times[MAX_RUNS];
+	double total = 0;
+	for (int i = 0; i < runs; i++)
+	{
+		struct timespec start;
+		struct timespec end;
+		timespec_get(&start, TIME_UTC);
+		int status = system(command);
+		timespec_get(&end, TIME_UTC);
+		if (status != 0)
+		{
+			fprintf(stderr, "%s failed with status %d\n", command, status);
+			return 1;
+		}
+		times[i] = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+		total += times[i];
+	}
+	qsort(times, runs, sizeof(double), compare_times);
+	printf("%d launches: min %.2f ms, median %.2f ms, mean %.2f ms, max %.2f ms\n", runs, times[0], times[runs / 2], total / runs, times[runs - 1]);
+	return 0;
+}
\ No newline at end of file
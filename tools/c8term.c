@@ -0,0 +1,40 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "machine.h"
+#include "terminal.h"
+
+//Runs a ROM in the terminal, for machines without a display. Usage: c8term <rom> [--frames N]
+//Keys as on the keyboard layout of c8 (1234, qwer, asdf, zxcv), Escape quits. --frames stops after N frames,
+//which makes a quick smoke test over SSH.
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: c8term <rom> [--frames N]\n");
+		return 1;
+	}
+	uint32_t max_frames = 0;
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			max_frames = (uint32_t)strtoul(argv[++i], NULL, 0);
+		}
+	}
+	FILE* file = fopen(argv[1], "rb");
+	if (!file)
+	{
+		fprintf(stderr, "Could not read %s\n", argv[1]);
+		return 1;
+	}
+	fclose(file);
+	MACHINE* machine = create_headless_machine();
+	load_program(machine, argv[1]);
+	TERMINAL* terminal = create_terminal(stdout);
+	run_terminal(machine, terminal, max_frames);
+	delete_terminal(terminal);
+	delete_machine(machine);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "disassembler.h"
+#include "struct_trace.h"
+
+//Offline decoder for traces written by flush_trace. Usage: c8trace <trace file> [number of most recent records]
+
+static uint16_t get_word(const uint8_t* p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static void print_record(const uint8_t* record)
+{
+	char asm_text[32] = "";
+	uint16_t pc = get_word(record + 1);
+	uint16_t opcode = get_word(record + 3);
+	uint16_t v_mask = get_word(record + 5);
+	uint8_t special_mask = record[7];
+	const uint8_t* p = record + 8;
+	opcode_to_string(asm_text, opcode);
+	printf("%03hX  %04hX  %-20s", pc, opcode, asm_text);
+	for (uint8_t i = 0; i < NUM_V_REGS; i++)
+	{
+		if (v_mask & (1 << i))
+		{
+			printf(" V%hhX=%02hhX", i, *p++);
+		}
+	}
+	if (special_mask & TRACE_I_CHANGED)
+	{
+		printf(" I=%04hX", get_word(p));
+		p += 2;
+	}
+	if (special_mask & TRACE_S_CHANGED)
+	{
+		printf(" S=%04hX", get_word(p));
+		p += 2;
+	}
+	if (special_mask & TRACE_DT_CHANGED)
+	{
+		printf(" DT=%02hhX", *p++);
+	}
+	if (special_mask & TRACE_ST_CHANGED)
+	{
+		printf(" ST=%02hhX", *p++);
+	}
+	printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s <trace file> [count]\n", argv[0]);
+		return 1;
+	}
+	FILE* file = fopen(argv[1], "rb");
+	if (!file)
+	{
+		fprintf(stderr, "Could not open %s\n", argv[1]);
+		return 1;
+	}
+	fseek(file, 0, SEEK_END);
+	long file_size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	uint8_t* data = malloc(file_size);
+	size_t magic_length = strlen(TRACE_FILE_MAGIC);
+	if (!data || fread(data, 1, file_size, file) != (size_t)file_size || file_size < (long)magic_length || memcmp(data, TRACE_FILE_MAGIC, magic_length) != 0)
+	{
+		fprintf(stderr, "%s is not a trace file\n", argv[1]);
+		fclose(file);
+		free(data);
+		return 1;
+	}
+	fclose(file);
+	uint64_t num_records = 0;
+	for (long offset = magic_length; offset < file_size && data[offset] != 0; offset += data[offset])
+	{
+		num_records++;
+	}
+	uint64_t skip = 0;
+	if (argc > 2)
+	{
+		uint64_t count = strtoull(argv[2], NULL, 0);
+		skip = count < num_records ? num_records - count : 0;
+	}
+	uint64_t index = 0;
+	for (long offset = magic_length; offset < file_size && data[offset] != 0; offset += data[offset])
+	{
+		if (index++ >= skip)
+		{
+			print_record(data + offset);
+		}
+	}
+	free(data);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "machine.h"
+#include "struct_machine.h"
+#include "struct_workload.h"
+
+//Training workload for profile-guided builds. Usage: c8train [manifest] [--rounds N]
+//Plays the built-in game and every ROM in the manifest headless with its scripted keypad input, with fusion on and
+//off, the way the frontend steps them: a fixed number of instructions per frame, then the timers. Instrumented
+//builds record the profile from this run, and the timing line it prints is what the pgo target compares. ROMs
+//missing from the manifest are skipped, so the built-in game alone still gives a usable profile.
+//
+//Manifest lines: <rom> <frames> [options], with the options of parse_workload in src/workload.c:
+//  keys=<frame>:<mask>,...  keypad mask held from that frame on, frame in decimal, mask in hex with bit k for key k
+//  poke=<address>:<byte>,... RAM written after loading, both in hex
+//  ticks=<n>                 instructions per frame, 12 by default
+//  wrap, large              y_wrap_enabled and large_sprites_enabled
+//Everything after # is a comment.
+
+#define DEFAULT_MANIFEST "resources/pgo_workload.txt"
+#define DEFAULT_TRAIN_ROUNDS 100
+
+//Ball, paddle and score: a bouncing sprite with collision counting, a paddle moved by keys 4 and 6, a BCD score
+//drawn from the font and a delay timer wait in a subroutine, which covers the opcodes and idioms games spend
+//their time in. The sprites live at 0x2F0.
+static const uint8_t builtin_game[] =
+{
+	0x00, 0xE0, 0x6A, 0x00, 0x6B, 0x20, 0x6C, 0x10, 0x6D, 0x01, 0x6E, 0x01, 0x65, 0x18, 0x63, 0x1E, //0x200
+	0x64, 0x04, 0x66, 0x06, 0xA2, 0xF0, 0xD5, 0x31, 0xA2, 0xF1, 0xDB, 0xC1, 0xA2, 0xF1, 0xDB, 0xC1, //0x210
+	0x8B, 0xD4, 0x8C, 0xE4, 0x4B, 0x3F, 0x6D, 0xFF, 0x4B, 0x00, 0x6D, 0x01, 0x4C, 0x1F, 0x6E, 0xFF, //0x220
+	0x4C, 0x00, 0x6E, 0x01, 0xDB, 0xC1, 0x4F, 0x01, 0x7A, 0x01, 0xA2, 0xF0, 0xD5, 0x31, 0xE4, 0xA1, //0x230
+	0x75, 0xFF, 0xE6, 0xA1, 0x75, 0x01, 0xD5, 0x31, 0xA3, 0x00, 0xFA, 0x33, 0xF2, 0x65, 0xF0, 0x29, //0x240
+	0x67, 0x00, 0xD7, 0x75, 0xD7, 0x75, 0x22, 0x70, 0x12, 0x1C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, //0x250
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, //0x260
+	0x69, 0x02, 0xF9, 0x15, 0xF9, 0x07, 0x39, 0x00, 0x12, 0x74, 0xC8, 0x07, 0x00, 0xEE, 0x00, 0x00, //0x270
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, //0x280
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, //0x290
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, //0x2A0
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, //0x2B0
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, //0x2C0
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, //0x2D0
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, //0x2E0
+	0xF0, 0x80 //0x2F0
+};
+
+//Returns the number of instructions stepped, and folds the final screen into checksum
+static uint64_t run_workload(const WORKLOAD* workload, const uint8_t* program, uint16_t size, bool fusion_enabled, uint64_t* checksum)
+{
+	MACHINE* machine = create_workload_machine(workload, program, size, fusion_enabled);
+	play_workload(machine, workload);
+	for (uint8_t y = 0; y < NUM_PIXEL_ROWS; y++)
+	{
+		*checksum = (*checksum ^ machine->pixel_row[y]) * 0x100000001B3ull;
+	}
+	delete_machine(machine);
+	return (uint64_t)workload->frames * workload->ticks;
+}
+
+static uint64_t run_both(const WORKLOAD* workload, const uint8_t* program, uint16_t size, uint64_t* checksum)
+{
+	return run_workload(workload, program, size, false, checksum) + run_workload(workload, program, size, true, checksum);
+}
+
+int main(int argc, char** argv)
+{
+	const char* manifest = DEFAULT_MANIFEST;
+	int rounds = DEFAULT_TRAIN_ROUNDS;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc)
+		{
+			rounds = atoi(argv[++i]);
+		}
+		else
+		{
+			manifest = argv[i];
+		}
+	}
+	WORKLOAD game = { .rom = "built-in game", .name = "built-in game", .frames = 3600, .ticks = DEFAULT_WORKLOAD_TICKS,
+		.keys = { { 0, 0x0010 }, { 90, 0 }, { 150, 0x0040 }, { 300, 0x0050 }, { 420, 0 }, { 900, 0x0010 }, { 1500, 0x0040 }, { 2400, 0 } }, .num_keys = 8 };
+	uint64_t checksum = 0xCBF29CE484222325ull;
+	uint64_t instructions = 0;
+	uint16_t played = 0;
+	uint16_t skipped = 0;
+	double start = get_seconds();
+	for (int round = 0; round < rounds; round++)
+	{
+		instructions += run_both(&game, builtin_game, sizeof(builtin_game), &checksum);
+		FILE* file = fopen(manifest, "r");
+		char line[MAX_WORKLOAD_LINE];
+		while (file && fgets(line, sizeof(line), file))
+		{
+			WORKLOAD workload;
+			if (!parse_workload(line, &workload, NULL, 0))
+			{
+				continue;
+			}
+			uint8_t program[RAM_SIZE];
+			FILE* rom_file = fopen(workload.rom, "rb");
+			if (!rom_file)
+			{
+				if (round == 0)
+				{
+					printf("SKIP  %s (missing)\n", workload.rom);
+					skipped++;
+				}
+				continue;
+			}
+			uint16_t size = (uint16_t)fread(program, 1, RAM_SIZE - PROGRAM_BASE_ADDRESS, rom_file);
+			fclose(rom_file);
+			instructions += run_both(&workload, program, size, &checksum);
+			played += round == 0;
+		}
+		if (file)
+		{
+			fclose(file);
+		}
+	}
+	double seconds = get_seconds() - start;
+	printf("%hu ROMs and the built-in game, %hu skipped, checksum %016llX\n", played, skipped, (unsigned long long)checksum);
+	printf("%llu instructions in %.3f s, %.2f ns per instruction\n", (unsigned long long)instructions, seconds,
+		instructions ? seconds * 1e9 / instructions : 0.0);
+	return 0;
+}
\ No newline at end of file
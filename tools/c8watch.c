@@ -0,0 +1,74 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "struct_export.h"
+
+//Reads a machine exported with c8 --export <name> without touching its window.
+//Usage: c8watch <name> [--keys <hex mask> | --release]
+//Prints the newest frame and registers. --keys takes over the keypad and holds the keys in the mask, bit i for key i;
+//--release gives the keypad back to the keyboard.
+
+#define MAX_READ_ATTEMPTS 100
+
+static void print_frame(const EXPORT_FRAME* frame)
+{
+	printf("Frame %llu  PC=%03hX  I=%03hX  S=%hu  DT=%02hhX  ST=%02hhX  opcode=%04hX%s\n", (unsigned long long)frame->frame,
+		frame->pc_reg, frame->i_reg, frame->s_reg, frame->d_counter, frame->s_counter, frame->current_opcode,
+		frame->waiting_for_input ? "  waiting for input" : "");
+	for (uint8_t i = 0; i < NUM_V_REGS; i++)
+	{
+		printf("V%hhX=%02hhX%s", i, frame->v_reg[i], i + 1 < NUM_V_REGS ? " " : "\n");
+	}
+	for (uint8_t y = 0; y < NUM_PIXEL_ROWS; y++)
+	{
+		char line[NUM_PIXEL_COLS + 1];
+		for (uint8_t x = 0; x < NUM_PIXEL_COLS; x++)
+		{
+			line[x] = (frame->pixel_row[y] >> (NUM_PIXEL_COLS - 1 - x)) & 1 ? '#' : '.';
+		}
+		line[NUM_PIXEL_COLS] = '\0';
+		printf("%s\n", line);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: c8watch <name> [--keys <hex mask> | --release]\n");
+		return 1;
+	}
+	EXPORT* shared = open_export(argv[1]);
+	if (!shared)
+	{
+		fprintf(stderr, "No machine is exported as %s\n", argv[1]);
+		return 1;
+	}
+	if (argc > 3 && strcmp(argv[2], "--keys") == 0)
+	{
+		inject_keypad(shared, true, (uint16_t)strtoul(argv[3], NULL, 16));
+	}
+	else if (argc > 2 && strcmp(argv[2], "--release") == 0)
+	{
+		inject_keypad(shared, false, 0);
+	}
+	int result = 1;
+	for (int attempt = 0; attempt < MAX_READ_ATTEMPTS; attempt++)
+	{
+		uint32_t sequence;
+		const EXPORT_FRAME* frame = begin_frame_read(shared, &sequence);
+		EXPORT_FRAME copy = *frame;
+		if (end_frame_read(frame, sequence))
+		{
+			print_frame(&copy);
+			result = 0;
+			break;
+		}
+	}
+	if (result)
+	{
+		fprintf(stderr, "No complete frame published yet\n");
+	}
+	delete_export(shared);
+	return result;
+}
\ No newline at end of file